@@ -0,0 +1,283 @@
+//
+// Created by mike on 13.12.18.
+//
+
+#ifndef DED_PROG_LANG_ARENA_H
+#define DED_PROG_LANG_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "exception.h"
+
+/*
+ * Region allocator of a compilation session. Memory is cut from big chunks
+ * by moving a pointer and is never returned piece by piece: everything is
+ * released at once when the session ends, so objects placed here must not
+ * need their destructors.
+ */
+class Arena {
+ private:
+  static const size_t MIN_CHUNK_SIZE = 1 << 16;
+
+  struct Chunk {
+    Chunk* prev;
+    size_t size;
+  };
+
+  Chunk* last_chunk_{nullptr};
+  char* cur_ptr_{nullptr};
+  char* cur_end_{nullptr};
+
+  size_t allocated_bytes_{0};
+  size_t allocated_objects_{0};
+  size_t reserved_bytes_{0};
+  size_t chunk_cnt_{0};
+
+  void addChunk(size_t min_size) {
+    size_t chunk_size = MIN_CHUNK_SIZE;
+
+    if (last_chunk_ != nullptr) {
+      chunk_size = last_chunk_->size * 2;
+    }
+    while (chunk_size < min_size + sizeof(Chunk)) {
+      chunk_size *= 2;
+    }
+
+    Chunk* chunk = static_cast<Chunk*>(malloc(chunk_size));
+    if (chunk == nullptr) {
+      throw std::bad_alloc();
+    }
+    chunk->prev = last_chunk_;
+    chunk->size = chunk_size;
+    last_chunk_ = chunk;
+    cur_ptr_ = reinterpret_cast<char*>(chunk) + sizeof(Chunk);
+    cur_end_ = reinterpret_cast<char*>(chunk) + chunk_size;
+    reserved_bytes_ += chunk_size;
+    ++chunk_cnt_;
+  }
+
+ public:
+  Arena() {}
+
+  Arena(const Arena& another) = delete;
+  Arena& operator=(const Arena& another) = delete;
+
+  void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+    size_t shift = (align - reinterpret_cast<size_t>(cur_ptr_) % align) % align;
+
+    if (cur_ptr_ == nullptr || static_cast<size_t>(cur_end_ - cur_ptr_) < shift + bytes) {
+      addChunk(bytes + align);
+      shift = (align - reinterpret_cast<size_t>(cur_ptr_) % align) % align;
+    }
+
+    void* result = cur_ptr_ + shift;
+    cur_ptr_ += shift + bytes;
+    allocated_bytes_ += bytes;
+    return result;
+  }
+
+  template<class T, class... Args>
+  T* make(Args&&... args) {
+    ++allocated_objects_;
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  const char* copyString(const char* data, size_t size) {
+    char* result = static_cast<char*>(allocate(size + 1, 1));
+
+    memcpy(result, data, size);
+    result[size] = '\0';
+    ++allocated_objects_;
+    return result;
+  }
+
+  void release() {
+    while (last_chunk_ != nullptr) {
+      Chunk* prev = last_chunk_->prev;
+
+      free(last_chunk_);
+      last_chunk_ = prev;
+    }
+    cur_ptr_ = nullptr;
+    cur_end_ = nullptr;
+  }
+
+  size_t getAllocatedBytes() const {
+    return allocated_bytes_;
+  }
+
+  size_t getAllocatedObjects() const {
+    return allocated_objects_;
+  }
+
+  size_t getReservedBytes() const {
+    return reserved_bytes_;
+  }
+
+  size_t getChunkCnt() const {
+    return chunk_cnt_;
+  }
+
+  void printStats(std::ostream& os) const {
+    os << "# arena: " << allocated_bytes_ << " bytes in " << allocated_objects_ << " objects, "
+       << reserved_bytes_ << " bytes reserved in " << chunk_cnt_ << " chunks\n";
+  }
+
+  ~Arena() {
+    release();
+  }
+};
+
+/*
+ * Lets standard containers take their buffers from an arena. Freeing is a
+ * no-op, the memory goes away together with the arena.
+ */
+template<class T>
+class ArenaAllocator {
+ private:
+  Arena* arena_;
+
+  template<class U>
+  friend class ArenaAllocator;
+
+ public:
+  typedef T value_type;
+
+  ArenaAllocator(Arena* arena): arena_(arena) {}
+
+  template<class U>
+  ArenaAllocator(const ArenaAllocator<U>& another): arena_(another.arena_) {}
+
+  T* allocate(size_t item_cnt) {
+    return static_cast<T*>(arena_->allocate(item_cnt * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* /* address */, size_t /* item_cnt */) {}
+
+  Arena* getArena() const {
+    return arena_;
+  }
+
+  template<class U>
+  bool operator==(const ArenaAllocator<U>& another) const {
+    return arena_ == another.arena_;
+  }
+
+  template<class U>
+  bool operator!=(const ArenaAllocator<U>& another) const {
+    return arena_ != another.arena_;
+  }
+};
+
+/*
+ * Non-owning view of a zero terminated string, usually one that lives in an
+ * arena: token text and symbol names.
+ */
+class StringRef {
+ private:
+  const char* data_{""};
+  size_t size_{0};
+
+ public:
+  StringRef() {}
+
+  StringRef(const char* data): data_(data), size_(strlen(data)) {}
+
+  StringRef(const char* data, size_t size): data_(data), size_(size) {}
+
+  StringRef(const std::string& str): data_(str.c_str()), size_(str.size()) {}
+
+  StringRef(const std::string& str, Arena& arena):
+    data_(arena.copyString(str.c_str(), str.size())), size_(str.size()) {}
+
+  const char* c_str() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  char operator[](size_t pos) const {
+    return data_[pos];
+  }
+
+  const char* begin() const {
+    return data_;
+  }
+
+  const char* end() const {
+    return data_ + size_;
+  }
+
+  std::string str() const {
+    return std::string(data_, size_);
+  }
+
+  bool operator==(const StringRef& another) const {
+    return size_ == another.size_ && memcmp(data_, another.data_, size_) == 0;
+  }
+
+  bool operator!=(const StringRef& another) const {
+    return !(*this == another);
+  }
+
+  bool operator==(const std::string& another) const {
+    return *this == StringRef(another.c_str(), another.size());
+  }
+
+  bool operator!=(const std::string& another) const {
+    return !(*this == another);
+  }
+
+  bool operator==(const char* another) const {
+    return *this == StringRef(another);
+  }
+
+  bool operator!=(const char* another) const {
+    return !(*this == another);
+  }
+
+  bool operator<(const StringRef& another) const {
+    int cmp_result = memcmp(data_, another.data_, std::min(size_, another.size_));
+
+    return cmp_result < 0 || (cmp_result == 0 && size_ < another.size_);
+  }
+};
+
+std::string operator+(const std::string& str, const StringRef& ref) {
+  return str + ref.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const StringRef& ref) {
+  os.write(ref.c_str(), ref.size());
+  return os;
+}
+
+namespace std {
+template<>
+struct hash<StringRef> {
+  size_t operator()(const StringRef& ref) const {
+    size_t result = 14695981039346656037ULL;
+
+    for (char ch: ref) {
+      result = (result ^ static_cast<unsigned char>(ch)) * 1099511628211ULL;
+    }
+    return result;
+  }
+};
+}
+
+#endif //DED_PROG_LANG_ARENA_H
@@ -0,0 +1,335 @@
+//
+// Created by mike on 02.01.19.
+//
+
+#ifndef DED_PROG_LANG_ASM_OPTIMIZER_H
+#define DED_PROG_LANG_ASM_OPTIMIZER_H
+
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common_classes.h"
+#include "exception.h"
+
+/*
+ * Works on the assembler of the whole program, after the back end and
+ * before the assembler, so it sees the jumps either back end produces.
+ * The program is cut into basic blocks at labels and after jumps, ret
+ * and end, and then
+ *   - jumps and calls to a block that only jumps on go to the final target,
+ *   - blocks no path from the start reaches are dropped,
+ *   - a block nothing falls into is placed right after the jmp to it,
+ *     since that jump is always taken and now falls through,
+ *   - jmp to the next block is removed and je or jne over a lone jmp is
+ *     turned around.
+ * Blocks that fall through into each other move together; the end the
+ * assembler puts after the program is made explicit, so that the last one
+ * can move as well.
+ */
+class AsmOptimizer {
+ private:
+  static const size_t MAX_TOKEN_SIZE = 255;
+
+  struct AsmCommand {
+    std::string name;
+    std::vector<std::string> args;
+  };
+
+  struct AsmBlock {
+    std::vector<std::string> labels;
+    std::vector<AsmCommand> commands;
+  };
+
+  std::vector<AsmBlock> blocks_;
+  size_t threaded_cnt_{0};
+  size_t removed_cnt_{0};
+  size_t moved_cnt_{0};
+  size_t dead_cnt_{0};
+
+  static size_t getArgCnt(const std::string& name) {
+    if (name == "move") {
+      return 2;
+    }
+#define COMMAND(cmd_id, cmd_name, arg_cnt, arg_mask, cmd_source) \
+    if (name == cmd_name) {\
+      return arg_cnt;\
+    }
+#include "commands.h"
+#undef COMMAND
+    throw IncorrectArgumentException("incorrect command " + name, __PRETTY_FUNCTION__);
+  }
+
+  static bool isConditionalJump(const std::string& name) {
+    return isJump(name) && name != "jmp" && name != "call";
+  }
+
+  static bool fallsThrough(const AsmBlock& block) {
+    if (block.commands.empty()) {
+      return true;
+    }
+
+    const std::string& name = block.commands.back().name;
+    return name != "jmp" && name != "ret" && name != "end";
+  }
+
+  static bool endsBlock(const std::string& name) {
+    return isConditionalJump(name) || name == "jmp" || name == "ret" || name == "end";
+  }
+
+  static bool hasLabel(const AsmBlock& block, const std::string& label) {
+    for (const std::string& block_label: block.labels) {
+      if (block_label == label) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::map<std::string, size_t> findLabels() const {
+    std::map<std::string, size_t> labels;
+
+    for (size_t block_id = 0; block_id < blocks_.size(); ++block_id) {
+      for (const std::string& label: blocks_[block_id].labels) {
+        labels[label] = block_id;
+      }
+    }
+    return labels;
+  }
+
+  void threadJumps() {
+    std::map<std::string, size_t> labels = findLabels();
+
+    for (AsmBlock& block: blocks_) {
+      for (AsmCommand& command: block.commands) {
+        if (!isJump(command.name)) {
+          continue;
+        }
+
+        std::string target = command.args[0];
+        std::set<std::string> seen{target};
+        for (auto found = labels.find(target); found != labels.end(); found = labels.find(target)) {
+          const AsmBlock& target_block = blocks_[found->second];
+
+          if (target_block.commands.empty() || target_block.commands[0].name != "jmp" ||
+              !seen.insert(target_block.commands[0].args[0]).second) {
+            break;
+          }
+          target = target_block.commands[0].args[0];
+        }
+        if (target != command.args[0]) {
+          command.args[0] = target;
+          ++threaded_cnt_;
+        }
+      }
+    }
+  }
+
+  void removeDeadBlocks() {
+    std::map<std::string, size_t> labels = findLabels();
+    std::vector<bool> reached(blocks_.size(), false);
+    std::vector<size_t> stack{0};
+
+    while (!stack.empty() && !blocks_.empty()) {
+      size_t block_id = stack.back();
+      stack.pop_back();
+      if (reached[block_id]) {
+        continue;
+      }
+      reached[block_id] = true;
+
+      for (const AsmCommand& command: blocks_[block_id].commands) {
+        auto found = (isJump(command.name) ? labels.find(command.args[0]) : labels.end());
+        if (found != labels.end()) {
+          stack.push_back(found->second);
+        }
+      }
+      if (fallsThrough(blocks_[block_id]) && block_id + 1 < blocks_.size()) {
+        stack.push_back(block_id + 1);
+      }
+    }
+
+    std::vector<AsmBlock> alive;
+    for (size_t block_id = 0; block_id < blocks_.size(); ++block_id) {
+      if (reached[block_id]) {
+        alive.push_back(blocks_[block_id]);
+      } else {
+        ++dead_cnt_;
+      }
+    }
+    blocks_.swap(alive);
+  }
+
+  /*
+   * Chains are runs of blocks that fall through into each other. After a
+   * chain that ends with a jmp to the start of a chain not placed yet goes
+   * that chain; the first one stays first, since the program starts there.
+   */
+  void layoutChains() {
+    std::vector<size_t> chain_starts;
+    std::map<std::string, size_t> chain_labels;
+
+    for (size_t block_id = 0; block_id < blocks_.size(); ++block_id) {
+      if (block_id == 0 || !fallsThrough(blocks_[block_id - 1])) {
+        for (const std::string& label: blocks_[block_id].labels) {
+          chain_labels[label] = chain_starts.size();
+        }
+        chain_starts.push_back(block_id);
+      }
+    }
+    chain_starts.push_back(blocks_.size());
+
+    size_t chain_cnt = chain_starts.size() - 1;
+    std::vector<bool> placed(chain_cnt, false);
+    std::vector<AsmBlock> layout;
+    for (size_t first_chain = 0; first_chain < chain_cnt; ++first_chain) {
+      for (size_t chain = first_chain; !placed[chain]; ) {
+        placed[chain] = true;
+        layout.insert(layout.end(), blocks_.begin() + chain_starts[chain],
+                      blocks_.begin() + chain_starts[chain + 1]);
+
+        const AsmBlock& tail = layout.back();
+        if (tail.commands.empty() || tail.commands.back().name != "jmp") {
+          break;
+        }
+        auto found = chain_labels.find(tail.commands.back().args[0]);
+        if (found == chain_labels.end() || found->second == 0) {
+          break;
+        }
+        if (!placed[found->second] && found->second != chain + 1) {
+          ++moved_cnt_;
+        }
+        chain = found->second;
+      }
+    }
+    blocks_.swap(layout);
+  }
+
+  void removeJumpsToNext() {
+    for (size_t block_id = 0; block_id + 1 < blocks_.size(); ++block_id) {
+      std::vector<AsmCommand>& commands = blocks_[block_id].commands;
+
+      if (!commands.empty() && commands.back().name == "jmp" &&
+          hasLabel(blocks_[block_id + 1], commands.back().args[0])) {
+        commands.pop_back();
+        ++removed_cnt_;
+      }
+    }
+  }
+
+  /*
+   * je L; jmp M; :L becomes jne M; :L when nothing else reaches the jmp.
+   * Only equality is turned around: the opposite of an ordered comparison
+   * differs from its negation for NaN.
+   */
+  void invertBranches() {
+    std::set<std::string> targets;
+    for (const AsmBlock& block: blocks_) {
+      for (const AsmCommand& command: block.commands) {
+        if (isJump(command.name)) {
+          targets.insert(command.args[0]);
+        }
+      }
+    }
+
+    for (size_t block_id = 0; block_id + 2 < blocks_.size(); ++block_id) {
+      std::vector<AsmCommand>& commands = blocks_[block_id].commands;
+      const AsmBlock& next = blocks_[block_id + 1];
+
+      if (commands.empty() || (commands.back().name != "je" && commands.back().name != "jne") ||
+          next.commands.size() != 1 || next.commands[0].name != "jmp" ||
+          !hasLabel(blocks_[block_id + 2], commands.back().args[0])) {
+        continue;
+      }
+
+      bool is_target = false;
+      for (const std::string& label: next.labels) {
+        is_target = is_target || targets.count(label) != 0;
+      }
+      if (is_target) {
+        continue;
+      }
+      commands.back().name = (commands.back().name == "je" ? "jne" : "je");
+      commands.back().args[0] = next.commands[0].args[0];
+      blocks_.erase(blocks_.begin() + block_id + 1);
+      ++removed_cnt_;
+    }
+  }
+
+ public:
+  void read(FILE* asm_file) {
+    char token[MAX_TOKEN_SIZE + 1] = "";
+
+    blocks_.assign(1, AsmBlock());
+    while (fscanf(asm_file, "%255s", token) == 1) {
+      std::string name = token;
+
+      if (name[0] == ':') {
+        if (!blocks_.back().commands.empty()) {
+          blocks_.emplace_back();
+        }
+        blocks_.back().labels.push_back(name.substr(1));
+        continue;
+      }
+
+      AsmCommand command{name, {}};
+      for (size_t arg_id = 0; arg_id < getArgCnt(name); ++arg_id) {
+        if (fscanf(asm_file, "%255s", token) != 1) {
+          throw IncorrectArgumentException("no argument for " + name, __PRETTY_FUNCTION__);
+        }
+        command.args.push_back(token);
+      }
+      blocks_.back().commands.push_back(command);
+      if (endsBlock(name)) {
+        blocks_.emplace_back();
+      }
+    }
+    if (blocks_.back().labels.empty() && blocks_.back().commands.empty()) {
+      blocks_.pop_back();
+    }
+    if (!blocks_.empty() && fallsThrough(blocks_.back())) {
+      blocks_.back().commands.push_back({"end", {}});
+    }
+  }
+
+  void optimize() {
+    threaded_cnt_ = 0;
+    removed_cnt_ = 0;
+    moved_cnt_ = 0;
+    dead_cnt_ = 0;
+
+    threadJumps();
+    removeDeadBlocks();
+    layoutChains();
+    removeJumpsToNext();
+    invertBranches();
+  }
+
+  void write(FILE* asm_file) const {
+    for (size_t block_id = 0; block_id < blocks_.size(); ++block_id) {
+      if (block_id > 0 && !fallsThrough(blocks_[block_id - 1])) {
+        fprintf(asm_file, "\n");
+      }
+      for (const std::string& label: blocks_[block_id].labels) {
+        fprintf(asm_file, ":%s\n", label.c_str());
+      }
+      for (const AsmCommand& command: blocks_[block_id].commands) {
+        fprintf(asm_file, "  %s", command.name.c_str());
+        for (const std::string& arg: command.args) {
+          fprintf(asm_file, " %s", arg.c_str());
+        }
+        fprintf(asm_file, "\n");
+      }
+    }
+  }
+
+  std::string getReport() const {
+    return "assembler: threaded " + std::to_string(threaded_cnt_) + " jumps, removed " +
+      std::to_string(removed_cnt_) + ", moved " + std::to_string(moved_cnt_) + " blocks after their jumps, dropped " +
+      std::to_string(dead_cnt_) + " unreachable blocks";
+  }
+};
+
+#endif //DED_PROG_LANG_ASM_OPTIMIZER_H
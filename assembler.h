@@ -11,6 +11,7 @@
 #include <map>
 #include <string>
 #include <cstring>
+#include <cstdlib>
 #include <unordered_map>
 #include <ctype.h>
 
@@ -33,16 +34,17 @@ bool isIntNumber(char arg[ARG_SIZE]) {
   return is_number;
 }
 
+/*
+ * Numbers may be negative and may use an exponent, as printed by %g.
+ */
 bool isFloatNumber(char arg[ARG_SIZE]) {
-  size_t len = strlen(arg);
-  bool is_number = true;
-  size_t dot_cnt = 0;
+  char* end = nullptr;
 
-  for (size_t char_id = 0; char_id < len; ++char_id) {
-    is_number &= (isDigit(arg[char_id]) || arg[char_id] == '.');
-    dot_cnt += (arg[char_id] == '.');
+  if (!isDigit(arg[0]) && arg[0] != '-' && arg[0] != '.') {
+    return false;
   }
-  return is_number && dot_cnt <= 1;
+  strtod(arg, &end);
+  return end != arg && *end == '\0';
 }
 
 int regNum(char arg[ARG_SIZE]) {
@@ -182,7 +184,11 @@ void removeSpaceChars(std::string& str) {
   str = result;
 }
 
-void assembly(FILE* asm_file = stdin, FILE* binary_file = stdout) {
+/*
+ * Fills labels, when given, with the address of every label.
+ */
+void assembly(FILE* asm_file = stdin, FILE* binary_file = stdout,
+              std::unordered_map<std::string, int>* labels = nullptr) {
   std::vector<Command<double>> commands;
 
   std::unordered_map<std::string, int> jump_to;
@@ -246,6 +252,9 @@ void assembly(FILE* asm_file = stdin, FILE* binary_file = stdout) {
     }
     encodeCommand(command, binary_file);
   }
+  if (labels != nullptr) {
+    *labels = jump_to;
+  }
 }
 
 
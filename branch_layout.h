@@ -0,0 +1,81 @@
+//
+// Created by mike on 01.01.19.
+//
+
+#ifndef DED_PROG_LANG_BRANCH_LAYOUT_H
+#define DED_PROG_LANG_BRANCH_LAYOUT_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_profile.h"
+#include "tree_visitor.h"
+
+/*
+ * Lays out ifs with an else by the profile. The then branch ends with a
+ * jump over the else branch, while the else branch falls through to what
+ * follows the if, so the branch that ran more often goes to the else: the
+ * condition is negated, which costs nothing since branches on a not only
+ * turn their jump around, and the branches trade places. Does nothing
+ * without a profile.
+ */
+class BranchLayoutPass : public Pass {
+ private:
+  class HotThenFinder : public TreeVisitor {
+   private:
+    const TreeProfile& profile_;
+    std::vector<Node*> ifs_;
+
+    bool preVisit(Node* node, int /* func_id */) {
+      if (node->type == LOGIC && node->value == IF && node->sons.size() == 3) {
+        const BranchCounts* counts = profile_.findBranch(node);
+
+        if (counts != nullptr && counts->then_cnt > counts->else_cnt) {
+          ifs_.push_back(node);
+        }
+      }
+      return true;
+    }
+
+   public:
+    HotThenFinder(const Tree& tree, const TreeProfile& profile): TreeVisitor(tree), profile_(profile) {}
+
+    const std::vector<Node*>& getIfs() const {
+      return ifs_;
+    }
+  };
+
+  TreeProfile* profile_;
+  size_t swapped_cnt_{0};
+
+ public:
+  explicit BranchLayoutPass(TreeProfile* profile): profile_(profile) {}
+
+  size_t run(Tree& tree) {
+    swapped_cnt_ = 0;
+    if (profile_ == nullptr) {
+      return 0;
+    }
+
+    HotThenFinder finder(tree, *profile_);
+    finder.walk(tree.getRoot());
+    for (Node* if_node: finder.getIfs()) {
+      Node*& condition = if_node->sons[0]->sons[0];
+
+      condition = tree.newNode(OPERATOR, BOOL_NOT, {condition});
+      std::swap(if_node->sons[1]->sons, if_node->sons[2]->sons);
+      profile_->swapBranches(if_node);
+      ++swapped_cnt_;
+    }
+    return swapped_cnt_;
+  }
+
+  std::string getReport() const {
+    return "put the hot branch of " + std::to_string(swapped_cnt_) + " ifs into the else";
+  }
+};
+
+#endif //DED_PROG_LANG_BRANCH_LAYOUT_H
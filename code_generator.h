@@ -0,0 +1,799 @@
+//
+// Created by mike on 22.12.18.
+//
+
+#ifndef DED_PROG_LANG_CODE_GENERATOR_H
+#define DED_PROG_LANG_CODE_GENERATOR_H
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common_classes.h"
+#include "exception.h"
+#include "flat_tree.h"
+#include "tree.h"
+
+/*
+ * Six digits after the point are enough for the numbers people write;
+ * folded constants that need more are printed exactly.
+ */
+std::string numberText(double value) {
+  char text[64];
+
+  snprintf(text, sizeof(text), "%.6lf", value);
+  if (strtod(text, nullptr) != value) {
+    snprintf(text, sizeof(text), "%.17g", value);
+  }
+  return text;
+}
+
+/*
+ * The command of a plain (not assigning) operator, nullptr for the others.
+ */
+const char* operatorCommand(int oper_type) {
+  switch (oper_type) {
+    case PLUS:
+      return "add";
+    case MINUS:
+      return "sub";
+    case MULTIPLY:
+      return "mul";
+    case DIVIDE:
+      return "div";
+    case POWER:
+      return "power";
+    case BOOL_EQUAL:
+      return "is_equal";
+    case BOOL_NOT_EQUAL:
+      return "is_nequal";
+    case BOOL_NOT:
+      return "not";
+    case BOOL_AND:
+      return "and";
+    case BOOL_OR:
+      return "or";
+    case BOOL_GREATER:
+      return "greater";
+    case BOOL_LOWER:
+      return "lower";
+    case BOOL_NOT_GREATER:
+      return "ngreater";
+    case BOOL_NOT_LOWER:
+      return "nlower";
+    default:
+      return nullptr;
+  }
+}
+
+/*
+ * Conditional jump taken when a comparison holds or, with when_true unset,
+ * when it does not; nullptr for operators that are not comparisons. An
+ * ordered comparison has no jump for when it does not hold: the opposite
+ * ordering is false as well for a NaN operand. Callers jump on the
+ * comparison over a jmp instead.
+ */
+const char* comparisonJump(int oper_type, bool when_true) {
+  switch (oper_type) {
+    case BOOL_EQUAL:
+      return when_true ? "je" : "jne";
+    case BOOL_NOT_EQUAL:
+      return when_true ? "jne" : "je";
+    case BOOL_LOWER:
+      return when_true ? "jl" : nullptr;
+    case BOOL_GREATER:
+      return when_true ? "jg" : nullptr;
+    case BOOL_NOT_LOWER:
+      return when_true ? "jge" : nullptr;
+    case BOOL_NOT_GREATER:
+      return when_true ? "jle" : nullptr;
+    default:
+      return nullptr;
+  }
+}
+
+/*
+ * Registers the generated code never touches otherwise: rax and rbx carry
+ * input and output, rcx is the frame base. r4 and r5 are rdx and rex.
+ * Callers leave the arguments on the operand stack and callees pop them
+ * straight into their registers or frame slots; the result stays on the
+ * operand stack. Neither goes through argument or result registers: every
+ * value would still be pushed once and popped once, and a callee that
+ * keeps it elsewhere would move it again. Registers below
+ * FIRST_SAVED_REGISTER are caller saved and are only given to functions
+ * without calls, so no caller keeps a value there over a call. The rest
+ * are callee saved: a function that takes one keeps the value of its
+ * caller in a slot after its frame until it returns.
+ */
+const int FIRST_SCRATCH_REGISTER = 4;
+const int FIRST_SAVED_REGISTER = 12;
+const int LAST_FREE_REGISTER = 15;
+
+/*
+ * A use of a variable inside a loop counts for LOOP_WEIGHT uses outside
+ * of it when registers are given out.
+ */
+const long long LOOP_WEIGHT = 8;
+const size_t MAX_LOOP_DEPTH = 5;
+
+/*
+ * Prints the stack machine assembler of a flat tree. Code generation keeps
+ * a stack of pending tasks instead of recursing: a task is a node to
+ * expand, a condition to branch on or a ready line of assembler.
+ */
+class CodeGenerator {
+ private:
+  enum BranchKind {
+    NO_BRANCH,
+    BRANCH_IF_FALSE,
+    BRANCH_IF_TRUE,
+  };
+
+  /*
+   * A branch task jumps to the label in text on the value of its node.
+   */
+  struct AsmTask {
+    uint32_t node_id;
+    int func_id;
+    std::string text;
+    BranchKind branch;
+  };
+
+  class AsmTaskList {
+   private:
+    std::vector<AsmTask> tasks_;
+
+   public:
+    void visit(uint32_t node_id, int func_id) {
+      tasks_.push_back({node_id, func_id, "", NO_BRANCH});
+    }
+
+    void branch(uint32_t node_id, int func_id, const std::string& label, bool when_true) {
+      tasks_.push_back({node_id, func_id, label, when_true ? BRANCH_IF_TRUE : BRANCH_IF_FALSE});
+    }
+
+    void visitSons(const FlatTree& tree, uint32_t node_id, int func_id, uint32_t first_son = 0) {
+      for (uint32_t son_pos = first_son; son_pos < tree.getSonCnt(node_id); ++son_pos) {
+        visit(tree.getSon(node_id, son_pos), func_id);
+      }
+    }
+
+    /*
+     * A call made as a statement leaves its result behind, which is
+     * dropped; functions that return no value return 0 for that.
+     */
+    void visitStatements(const FlatTree& tree, uint32_t node_id, int func_id) {
+      for (uint32_t son_pos = 0; son_pos < tree.getSonCnt(node_id); ++son_pos) {
+        uint32_t son_id = tree.getSon(node_id, son_pos);
+
+        visit(son_id, func_id);
+        if (tree.getType(son_id) == STANDART_FUNCTION && tree.getPayload(son_id) == CALL) {
+          emit("  pop rax\n");
+        }
+      }
+    }
+
+    void emit(const char* format, ...) {
+      char line[256];
+      va_list args;
+
+      va_start(args, format);
+      vsnprintf(line, sizeof(line), format, args);
+      va_end(args);
+      tasks_.push_back({FlatTree::NO_NODE, 0, line, NO_BRANCH});
+    }
+
+    void moveTo(std::vector<AsmTask>& stack) {
+      for (auto iter = tasks_.rbegin(); iter != tasks_.rend(); ++iter) {
+        stack.push_back(std::move(*iter));
+      }
+      tasks_.clear();
+    }
+  };
+
+  /*
+   * Registers of one function: the register of every frame slot or -1,
+   * the callee saved registers it takes, and whether it needs a frame at
+   * all. A function without one does not enter a frame of its own.
+   */
+  struct FuncRegisters {
+    std::vector<int> slots;
+    std::vector<int> saved;
+    bool is_leaf;
+    bool is_frameless;
+  };
+
+  const FlatTree& tree_;
+  bool use_registers_;
+  size_t cnt_if_{0};
+  size_t cnt_while_{0};
+  size_t cnt_bool_{0};
+  std::vector<FuncRegisters> registers_;
+  std::vector<bool> memoized_;
+
+  /*
+   * Keeps the most used frame slots of every function in free registers.
+   * A callee saved register costs four commands per call of the function.
+   */
+  void allocateRegisters(uint32_t func_node, int func_id) {
+    size_t frame_size = tree_.getFrameSize(func_id);
+    bool is_main = func_id == tree_.getMainId();
+    std::vector<long long> scores(frame_size, 0);
+    size_t call_cnt = 0;
+    std::vector<std::pair<uint32_t, size_t>> stack{{func_node, 0}};
+
+    while (!stack.empty()) {
+      uint32_t node_id = stack.back().first;
+      size_t depth = stack.back().second;
+      long long weight = 1;
+      stack.pop_back();
+
+      for (size_t level = 0; level < std::min(depth, MAX_LOOP_DEPTH); ++level) {
+        weight *= LOOP_WEIGHT;
+      }
+      if (tree_.getType(node_id) == PARAM || tree_.getType(node_id) == LOCAL_VARIABLE) {
+        scores[frameSlot(node_id, func_id)] += weight;
+      } else if (tree_.getType(node_id) == STANDART_FUNCTION && tree_.getPayload(node_id) == CALL) {
+        ++call_cnt;
+      }
+      if (tree_.getType(node_id) == LOGIC && tree_.getPayload(node_id) == WHILE) {
+        ++depth;
+      }
+      for (uint32_t son_pos = 0; son_pos < tree_.getSonCnt(node_id); ++son_pos) {
+        stack.push_back({tree_.getSon(node_id, son_pos), depth});
+      }
+    }
+
+    FuncRegisters& func = registers_[func_id];
+    func.slots.assign(frame_size, -1);
+    func.saved.clear();
+    func.is_leaf = call_cnt == 0;
+
+    std::vector<size_t> order;
+    for (size_t slot = 0; slot < frame_size; ++slot) {
+      if (scores[slot] > 0) {
+        order.push_back(slot);
+      }
+    }
+    std::stable_sort(order.begin(), order.end(), [&scores](size_t slot_a, size_t slot_b) {
+      return scores[slot_a] > scores[slot_b];
+    });
+
+    int reg = (func.is_leaf ? FIRST_SCRATCH_REGISTER : FIRST_SAVED_REGISTER);
+    for (size_t pos = 0; pos < order.size() && reg <= LAST_FREE_REGISTER; ++pos, ++reg) {
+      bool is_saved = reg >= FIRST_SAVED_REGISTER && !is_main;
+      if (is_saved && scores[order[pos]] <= 4) {
+        break;
+      }
+      func.slots[order[pos]] = reg;
+      if (is_saved) {
+        func.saved.push_back(reg);
+      }
+    }
+
+    func.is_frameless = func.is_leaf && func.saved.empty() && !is_main;
+    for (int slot_reg: func.slots) {
+      func.is_frameless = func.is_frameless && slot_reg != -1;
+    }
+  }
+
+  void allocateAllRegisters() {
+    uint32_t root = tree_.getRoot();
+    uint32_t funcs = tree_.getSon(root, 1);
+
+    registers_.assign(tree_.getFuncCnt(), {{}, {}, false, false});
+    if (!use_registers_) {
+      return;
+    }
+    for (uint32_t son_pos = 0; son_pos < tree_.getSonCnt(funcs); ++son_pos) {
+      uint32_t func_node = tree_.getSon(funcs, son_pos);
+      allocateRegisters(func_node, tree_.getPayload(func_node));
+    }
+    allocateRegisters(tree_.getSon(root, 2), tree_.getMainId());
+  }
+
+  size_t frameSlot(uint32_t var_id, int func_id) const {
+    size_t slot = tree_.getPayload(var_id);
+    return tree_.getType(var_id) == LOCAL_VARIABLE ? slot + tree_.getParamCnt(func_id) : slot;
+  }
+
+  int getRegister(int func_id, size_t slot) const {
+    if (func_id == -1 || registers_[func_id].slots.size() <= slot) {
+      return -1;
+    }
+    return registers_[func_id].slots[slot];
+  }
+
+  std::string slotAddress(int func_id, size_t slot) const {
+    if (getRegister(func_id, slot) != -1) {
+      return "r" + std::to_string(getRegister(func_id, slot));
+    }
+    return "[rcx+" + std::to_string(slot) + "]";
+  }
+
+  /*
+   * Frame with the slots for callee saved registers.
+   */
+  size_t getFrameSize(int func_id) const {
+    return tree_.getFrameSize(func_id) + registers_[func_id].saved.size();
+  }
+
+  /*
+   * Opens the frame, saves the callee saved registers and takes the
+   * arguments from the operand stack.
+   */
+  void emitPrologue(AsmTaskList& tasks, int func_id) const {
+    const std::vector<int>& saved = registers_[func_id].saved;
+
+    if (!registers_[func_id].is_frameless) {
+      tasks.emit("  enter %zu\n", getFrameSize(func_id));
+    }
+    for (size_t save_id = 0; save_id < saved.size(); ++save_id) {
+      tasks.emit("  push r%d\n", saved[save_id]);
+      tasks.emit("  pop [rcx+%zu]\n", tree_.getFrameSize(func_id) + save_id);
+    }
+    for (size_t param_id = tree_.getParamCnt(func_id); param_id > 0; --param_id) {
+      tasks.emit("  pop %s\n", slotAddress(func_id, param_id - 1).c_str());
+    }
+  }
+
+  /*
+   * Gives the registers and the frame back to the caller.
+   */
+  void emitLeave(AsmTaskList& tasks, int func_id) const {
+    const std::vector<int>& saved = registers_[func_id].saved;
+
+    for (size_t save_id = 0; save_id < saved.size(); ++save_id) {
+      tasks.emit("  push [rcx+%zu]\n", tree_.getFrameSize(func_id) + save_id);
+      tasks.emit("  pop r%d\n", saved[save_id]);
+    }
+    if (!registers_[func_id].is_frameless) {
+      tasks.emit("  leave\n");
+    }
+  }
+
+  bool isMemoized(int func_id) const {
+    return func_id >= 0 && static_cast<size_t>(func_id) < memoized_.size() && memoized_[func_id];
+  }
+
+  void emitReturn(AsmTaskList& tasks, int func_id) const {
+    if (isMemoized(func_id)) {
+      tasks.emit("  memo_put\n");
+    }
+    emitLeave(tasks, func_id);
+    tasks.emit("  ret\n");
+  }
+
+  /*
+   * A memoized function has to store its result, so it never leaves by a
+   * tail call.
+   */
+  bool isTailCall(uint32_t return_id, int func_id) const {
+    if (func_id == tree_.getMainId() || tree_.getSonCnt(return_id) != 1 || isMemoized(func_id)) {
+      return false;
+    }
+
+    uint32_t value_id = tree_.getSon(return_id, 0);
+    return tree_.getType(value_id) == STANDART_FUNCTION && tree_.getPayload(value_id) == CALL;
+  }
+
+  std::string variableAddress(uint32_t var_id, int func_id) const {
+    int slot = tree_.getPayload(var_id);
+
+    switch (tree_.getType(var_id)) {
+      case VARIABLE:
+        return "[" + std::to_string(slot) + "]";
+      case LOCAL_VARIABLE:
+        if (func_id == -1) {
+          return "[" + std::to_string(slot) + "]";
+        }
+        return slotAddress(func_id, frameSlot(var_id, func_id));
+      case PARAM:
+        return slotAddress(func_id, frameSlot(var_id, func_id));
+      default:
+        throw IncorrectArgumentException(std::string("not a variable node: ") +
+                                           std::to_string(tree_.getType(var_id)), __PRETTY_FUNCTION__);
+    }
+  }
+
+  void pushNodeVariable(uint32_t node_id, AsmTaskList& tasks, int func_id) const {
+    tasks.emit("  push %s\n", variableAddress(tree_.getSon(node_id, 0), func_id).c_str());
+  }
+
+  void popNodeVariable(uint32_t node_id, AsmTaskList& tasks, int func_id) const {
+    tasks.emit("  pop %s\n", variableAddress(tree_.getSon(node_id, 0), func_id).c_str());
+  }
+
+  bool isShortCircuit(uint32_t node_id) const {
+    return tree_.getType(node_id) == OPERATOR && tree_.getSonCnt(node_id) == 2 &&
+      (tree_.getPayload(node_id) == BOOL_AND || tree_.getPayload(node_id) == BOOL_OR);
+  }
+
+  /*
+   * x ^ n for a small constant n: copies of x are left under the power
+   * for every set bit below the top one, then the power is squared bit by
+   * bit and multiplied by a copy where the bit is set.
+   */
+  void expandPowerChain(uint32_t base_id, int exponent, AsmTaskList& tasks, int func_id) const {
+    int top_bit = 0;
+
+    while ((exponent >> (top_bit + 1)) != 0) {
+      ++top_bit;
+    }
+    tasks.visit(base_id, func_id);
+    for (int bit = 0; bit < top_bit; ++bit) {
+      if (((exponent >> bit) & 1) != 0) {
+        tasks.emit("  dup\n");
+      }
+    }
+    for (int bit = top_bit - 1; bit >= 0; --bit) {
+      tasks.emit("  dup\n");
+      tasks.emit("  mul\n");
+      if (((exponent >> bit) & 1) != 0) {
+        tasks.emit("  mul\n");
+      }
+    }
+  }
+
+  void expandOperator(uint32_t node_id, AsmTaskList& tasks, int func_id) {
+    int oper_type = tree_.getPayload(node_id);
+
+    if (isShortCircuit(node_id)) {
+      size_t bool_id = cnt_bool_++;
+
+      expandBranch(node_id, tasks, func_id, "bool_false_" + std::to_string(bool_id), false);
+      tasks.emit("  push 1\n");
+      tasks.emit("  jmp bool_end_%zu\n", bool_id);
+      tasks.emit("  :bool_false_%zu\n", bool_id);
+      tasks.emit("  push 0\n");
+      tasks.emit("  :bool_end_%zu\n", bool_id);
+      return;
+    }
+    if (oper_type == POWER && tree_.getType(tree_.getSon(node_id, 1)) == NUMBER &&
+        isChainExponent(tree_.getValue(tree_.getSon(node_id, 1)))) {
+      expandPowerChain(tree_.getSon(node_id, 0), static_cast<int>(tree_.getValue(tree_.getSon(node_id, 1))),
+                       tasks, func_id);
+      return;
+    }
+
+    switch (oper_type) {
+      case EQUAL:
+        tasks.visit(tree_.getSon(node_id, 1), func_id);
+        popNodeVariable(node_id, tasks, func_id);
+        return;
+      case PLUS_EQUAL:
+      case MINUS_EQUAL:
+      case MULTIPLY_EQUAL:
+      case DIVIDE_EQUAL:
+        pushNodeVariable(node_id, tasks, func_id);
+        tasks.visit(tree_.getSon(node_id, 1), func_id);
+        break;
+      default:
+        if (tree_.getSonCnt(node_id) == 1 && oper_type == MINUS) {
+          tasks.emit("  push 0\n");
+        }
+        tasks.visitSons(tree_, node_id, func_id);
+        break;
+    }
+
+    switch (oper_type) {
+      case PLUS_EQUAL:
+        tasks.emit("  add\n");
+        popNodeVariable(node_id, tasks, func_id);
+        break;
+      case MINUS_EQUAL:
+        tasks.emit("  sub\n");
+        popNodeVariable(node_id, tasks, func_id);
+        break;
+      case MULTIPLY_EQUAL:
+        tasks.emit("  mul\n");
+        popNodeVariable(node_id, tasks, func_id);
+        break;
+      case DIVIDE_EQUAL:
+        tasks.emit("  div\n");
+        popNodeVariable(node_id, tasks, func_id);
+        break;
+      default:
+        if (operatorCommand(oper_type) == nullptr) {
+          throw IncorrectArgumentException(std::string("no such operator ") + std::to_string(oper_type),
+                                           __PRETTY_FUNCTION__);
+        }
+        tasks.emit("  %s\n", operatorCommand(oper_type));
+        break;
+    }
+  }
+
+  /*
+   * A call in tail position leaves the frame of the caller before jumping
+   * to the callee, which opens its own frame in the same place and returns
+   * right to the caller of the caller: recursion in tail form runs in
+   * constant space.
+   */
+  void expandCall(uint32_t node_id, AsmTaskList& tasks, int func_id, bool is_tail = false) {
+    int call_func_id = tree_.getPayload(tree_.getSon(node_id, 0));
+    size_t param_cnt = tree_.getParamCnt(call_func_id);
+
+    if (param_cnt + 1 != tree_.getSonCnt(node_id)) {
+      throw IncorrectArgumentException(std::string("called function get ") +
+        std::to_string(param_cnt) + " params but not " +
+        std::to_string(tree_.getSonCnt(node_id) - 1), __PRETTY_FUNCTION__);
+    }
+    tasks.visitSons(tree_, node_id, func_id, 1);
+    if (is_tail) {
+      emitLeave(tasks, func_id);
+      tasks.emit("  jmp func_%d\n", call_func_id);
+    } else {
+      tasks.emit("  call func_%d\n", call_func_id);
+    }
+  }
+
+  void expandStandartFunction(uint32_t node_id, AsmTaskList& tasks, int func_id) {
+    int std_func_type = tree_.getPayload(node_id);
+
+    if (std_func_type != CALL && std_func_type != INPUT) {
+      tasks.visitSons(tree_, node_id, func_id);
+    }
+
+    switch (std_func_type) {
+      case INPUT:
+        tasks.emit("  in rax\n");
+        tasks.emit("  push rax\n");
+        popNodeVariable(node_id, tasks, func_id);
+        break;
+      case OUTPUT:
+        tasks.emit("  pop rbx\n");
+        tasks.emit("  out rbx\n");
+        break;
+      case SIN:
+        tasks.emit("  sin\n");
+        break;
+      case COS:
+        tasks.emit("  cos\n");
+        break;
+      case SQ_ROOT:
+        tasks.emit("  sqrt\n");
+        break;
+      case CALL:
+        expandCall(node_id, tasks, func_id);
+        break;
+      default:
+        throw IncorrectArgumentException(std::string("no such standart function ") +
+                                           std::to_string(std_func_type), __PRETTY_FUNCTION__);
+    }
+  }
+
+  /*
+   * Jumps to label when the condition is true or, with when_true unset,
+   * when it is false. Comparisons jump right on their operands, over a jmp
+   * to label when an ordered one is false, and a not only turns the jump
+   * around. && and || test their right operand only when the left one does
+   * not decide the result.
+   */
+  void expandBranch(uint32_t cond_id, AsmTaskList& tasks, int func_id, const std::string& label, bool when_true) {
+    while (tree_.getType(cond_id) == OPERATOR && tree_.getPayload(cond_id) == BOOL_NOT &&
+           tree_.getSonCnt(cond_id) == 1) {
+      cond_id = tree_.getSon(cond_id, 0);
+      when_true = !when_true;
+    }
+
+    if (isShortCircuit(cond_id)) {
+      bool is_and = tree_.getPayload(cond_id) == BOOL_AND;
+
+      if (is_and != when_true) {
+        tasks.branch(tree_.getSon(cond_id, 0), func_id, label, when_true);
+        tasks.branch(tree_.getSon(cond_id, 1), func_id, label, when_true);
+        return;
+      }
+      std::string skip_label = "bool_skip_" + std::to_string(cnt_bool_++);
+      tasks.branch(tree_.getSon(cond_id, 0), func_id, skip_label, !when_true);
+      tasks.branch(tree_.getSon(cond_id, 1), func_id, label, when_true);
+      tasks.emit("  :%s\n", skip_label.c_str());
+      return;
+    }
+
+    if (tree_.getType(cond_id) == OPERATOR && tree_.getSonCnt(cond_id) == 2 &&
+        comparisonJump(tree_.getPayload(cond_id), true) != nullptr) {
+      const char* jump = comparisonJump(tree_.getPayload(cond_id), when_true);
+
+      tasks.visitSons(tree_, cond_id, func_id);
+      if (jump != nullptr) {
+        tasks.emit("  %s %s\n", jump, label.c_str());
+        return;
+      }
+      size_t bool_id = cnt_bool_++;
+      tasks.emit("  %s bool_skip_%zu\n", comparisonJump(tree_.getPayload(cond_id), true), bool_id);
+      tasks.emit("  jmp %s\n", label.c_str());
+      tasks.emit("  :bool_skip_%zu\n", bool_id);
+      return;
+    }
+    tasks.visit(cond_id, func_id);
+    tasks.emit("  push 0\n");
+    tasks.emit("  %s %s\n", when_true ? "jne" : "je", label.c_str());
+  }
+
+  /*
+   * Loops are rotated: the condition is tested at the bottom, so every
+   * iteration takes one branch, and the first test is reached by a jump.
+   * Ifs and whiles are numbered in the order of a walk over the tree;
+   * TreeProfile relies on that and on the labels that only mark where a
+   * condition, a then branch or a loop starts.
+   */
+  void expandLogic(uint32_t node_id, AsmTaskList& tasks, int func_id) {
+    int logic_type = tree_.getPayload(node_id);
+    uint32_t cond_id = (tree_.getSonCnt(node_id) > 0 ? tree_.getSon(tree_.getSon(node_id, 0), 0) : 0);
+
+    switch (logic_type) {
+      case IF:
+        tasks.emit("  :if_cond_%zu\n", cnt_if_);
+        expandBranch(cond_id, tasks, func_id, "if_end_" + std::to_string(cnt_if_), false);
+        tasks.emit("  :if_then_%zu\n", cnt_if_);
+        tasks.visit(tree_.getSon(node_id, 1), func_id);
+        if (tree_.getSonCnt(node_id) > 2) {
+          tasks.emit("  jmp if_block_end_%zu\n", cnt_if_);
+        }
+        tasks.emit("  :if_end_%zu\n", cnt_if_);
+        if (tree_.getSonCnt(node_id) > 2) {
+          tasks.visit(tree_.getSon(node_id, 2), func_id);
+        }
+        tasks.emit("  :if_block_end_%zu\n", cnt_if_);
+        ++cnt_if_;
+        break;
+      case WHILE:
+        tasks.emit("  :while_entry_%zu\n", cnt_while_);
+        tasks.emit("  jmp while_cond_%zu\n", cnt_while_);
+        tasks.emit("  :while_begin_%zu\n", cnt_while_);
+        tasks.visit(tree_.getSon(node_id, 1), func_id);
+        tasks.emit("  :while_cond_%zu\n", cnt_while_);
+        expandBranch(cond_id, tasks, func_id, "while_begin_" + std::to_string(cnt_while_), true);
+        ++cnt_while_;
+        break;
+      case CONDITION:
+        tasks.visitSons(tree_, node_id, func_id);
+        break;
+      case ELSE:
+      case CONDITION_MET:
+        tasks.visitStatements(tree_, node_id, func_id);
+        break;
+      default:
+        throw IncorrectArgumentException(std::string("no such separate logic block was provided: ")
+                                           + std::to_string(logic_type), __PRETTY_FUNCTION__);
+    }
+  }
+
+  void expandNode(uint32_t node_id, AsmTaskList& tasks, int func_id) {
+    switch (tree_.getType(node_id)) {
+      case VAR_INIT:
+        for (uint32_t son_pos = 0; son_pos < tree_.getSonCnt(node_id); ++son_pos) {
+          tasks.visit(tree_.getSon(node_id, son_pos), func_id);
+          if (func_id != -1) {
+            tasks.emit("  pop %s\n", slotAddress(func_id, son_pos + tree_.getParamCnt(func_id)).c_str());
+          } else {
+            tasks.emit("  pop [%u]\n", son_pos);
+          }
+        }
+        break;
+      case USER_FUNCTION:
+      {
+        int user_func_id = tree_.getPayload(node_id);
+
+        std::cout << "print user function " << user_func_id << " from" << func_id << "\n";
+        tasks.emit(":func_%d\n", user_func_id);
+        if (isMemoized(user_func_id)) {
+          tasks.emit("  memo_get %d %zu\n", user_func_id, tree_.getParamCnt(user_func_id));
+        }
+        emitPrologue(tasks, user_func_id);
+        tasks.visitStatements(tree_, node_id, user_func_id);
+        tasks.emit("  push 0\n");
+        emitReturn(tasks, user_func_id);
+        break;
+      }
+      case NUMBER:
+        tasks.emit("  push %s\n", numberText(tree_.getValue(node_id)).c_str());
+        break;
+      case VARIABLE:
+      case LOCAL_VARIABLE:
+      case PARAM:
+        tasks.emit("  push %s\n", variableAddress(node_id, func_id).c_str());
+        break;
+      case OPERATOR:
+        expandOperator(node_id, tasks, func_id);
+        break;
+      case STANDART_FUNCTION:
+        expandStandartFunction(node_id, tasks, func_id);
+        break;
+      case MAIN:
+        tasks.emit("\n:func_main\n");
+        tasks.emit("  enter %zu\n", getFrameSize(tree_.getMainId()));
+        tasks.visitStatements(tree_, node_id, tree_.getMainId());
+        tasks.emit("  end\n");
+        break;
+      case FUNCS:
+        std::cout << "user func count " << tree_.getSonCnt(node_id) << "\n";
+        tasks.visitSons(tree_, node_id, func_id);
+        break;
+      case RETURN:
+        if (isTailCall(node_id, func_id)) {
+          expandCall(tree_.getSon(node_id, 0), tasks, func_id, true);
+          break;
+        }
+        if (tree_.getSonCnt(node_id) == 1) {
+          tasks.visit(tree_.getSon(node_id, 0), func_id);
+        }
+        if (func_id != tree_.getMainId()) {
+          if (tree_.getSonCnt(node_id) == 0) {
+            tasks.emit("  push 0\n");
+          }
+          emitReturn(tasks, func_id);
+        } else {
+          tasks.emit("  end\n");
+        }
+        break;
+      case ROOT:
+        tasks.emit("  enter %zu\n", tree_.getGlobalCnt());
+        tasks.visit(tree_.getSon(node_id, 0), func_id);
+        tasks.emit("jmp func_main\n");
+        tasks.visit(tree_.getSon(node_id, 1), func_id);
+        tasks.visit(tree_.getSon(node_id, 2), func_id);
+        break;
+      case LOGIC:
+        expandLogic(node_id, tasks, func_id);
+        break;
+      default:
+        throw IncorrectArgumentException(std::string("no such node type:") +
+                                           std::to_string(tree_.getType(node_id)), __PRETTY_FUNCTION__);
+    }
+  }
+
+ public:
+  /*
+   * With use_registers the most used locals and parameters live in the
+   * free registers.
+   */
+  explicit CodeGenerator(const FlatTree& tree, bool use_registers = false):
+    tree_(tree), use_registers_(use_registers) {}
+
+  /*
+   * Functions marked here look their arguments up in the table of the
+   * processor on entry and store their result there on return.
+   */
+  void setMemoized(const std::vector<bool>& memoized) {
+    memoized_ = memoized;
+  }
+
+  void printAssembler(FILE* asm_file) {
+    std::cout << "print asm\n";
+    if (tree_.empty()) {
+      return;
+    }
+
+    std::vector<AsmTask> stack;
+    AsmTaskList tasks;
+
+    allocateAllRegisters();
+    tasks.visit(tree_.getRoot(), -1);
+    tasks.moveTo(stack);
+
+    while (!stack.empty()) {
+      AsmTask task = std::move(stack.back());
+      stack.pop_back();
+
+      if (task.node_id == FlatTree::NO_NODE) {
+        fputs(task.text.c_str(), asm_file);
+        continue;
+      }
+      if (task.branch != NO_BRANCH) {
+        expandBranch(task.node_id, tasks, task.func_id, task.text, task.branch == BRANCH_IF_TRUE);
+      } else {
+        expandNode(task.node_id, tasks, task.func_id);
+      }
+      tasks.moveTo(stack);
+    }
+  }
+};
+
+#endif //DED_PROG_LANG_CODE_GENERATOR_H
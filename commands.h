@@ -12,7 +12,7 @@
   instruction_pointer_ = cur_command.args[0].first;
 
 #define POP_INSTR() \
-  instruction_pointer_ = instruction_stack_.extract();
+  instruction_pointer_ = call_stack_.extract().return_address;
 
 #define INC_INSTR() \
   ++instruction_pointer_;
@@ -59,6 +59,7 @@ COMMAND(7, "sqrt", 0, 0,\
 COMMAND(8, "dup", 0, 0,\
   POP(arg_top);\
   PUSH_ITEM(arg_top);\
+  PUSH_ITEM(arg_top);\
 )
 COMMAND(9, "in", 1, 6,\
   if (cur_command.args[0].second == 2) {\
@@ -84,7 +85,7 @@ COMMAND(12, "jmp", 1, 1,\
   return;\
 )
 COMMAND(13, "call", 1, 1,\
-  instruction_stack_.push(instruction_pointer_);\
+  call_stack_.push({instruction_pointer_, registers_[FRAME_REGISTER]});\
   JUMP_TO_LABEL();\
   return;\
 )
@@ -206,4 +207,42 @@ COMMAND(29, "or", 0, 0,\
   } else {\
     PUSH_ITEM(0);\
   }\
+)
+COMMAND(30, "enter", 1, 1,\
+  registers_[FRAME_REGISTER] = frame_end_;\
+  frame_end_ += cur_command.args[0].first;\
+)
+COMMAND(31, "leave", 0, 0,\
+  frame_end_ = registers_[FRAME_REGISTER];\
+  registers_[FRAME_REGISTER] = call_stack_.top().frame_base;\
+)
+COMMAND(32, "jg", 1, 1,\
+  POP_ARGS_AB();\
+\
+  if (arg_a > arg_b) {\
+    JUMP_TO_LABEL();\
+    return;\
+  }\
+)
+COMMAND(33, "jge", 1, 1,\
+  POP_ARGS_AB();\
+\
+  if (arg_a >= arg_b) {\
+    JUMP_TO_LABEL();\
+    return;\
+  }\
+)
+COMMAND(34, "power", 0, 0,\
+  POP_ARGS_AB();\
+  PUSH_ITEM(raiseToPower(arg_a, arg_b));\
+)
+COMMAND(35, "memo_get", 2, 1,\
+  if (memoGet(cur_command.args[0].first, cur_command.args[1].first)) {\
+    POP_INSTR();\
+    INC_INSTR();\
+    return;\
+  }\
+)
+COMMAND(36, "memo_put", 0, 0,\
+  memoPut();\
 )
\ No newline at end of file
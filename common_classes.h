@@ -5,10 +5,16 @@
 #ifndef DED_PROG_LANG_COMMON_CLASSES_H
 #define DED_PROG_LANG_COMMON_CLASSES_H
 
+#include <cmath>
 #include <iostream>
 #include <vector>
 #include <string>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 
 class SmartFile {
  private:
@@ -46,6 +52,90 @@ class SmartFile {
   }
 };
 
+/*
+ * Read-only memory mapping of a whole file. getData() is nullptr when the
+ * file could not be opened or is empty.
+ */
+class MappedFile {
+ private:
+  void* data_{nullptr};
+  size_t size_{0};
+
+ public:
+  MappedFile() {}
+
+  MappedFile(const char* filename) {
+    map(filename);
+  }
+
+  MappedFile(const MappedFile& another) = delete;
+  MappedFile& operator=(const MappedFile& another) = delete;
+
+  bool map(const char* filename) {
+    release();
+
+    int fd = open(filename, O_RDONLY);
+    struct stat file_stat;
+
+    if (fd == -1) {
+      return false;
+    }
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+      void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (data != MAP_FAILED) {
+        data_ = data;
+        size_ = file_stat.st_size;
+      }
+    }
+    close(fd);
+    return data_ != nullptr;
+  }
+
+  const char* getData() const {
+    return static_cast<const char*>(data_);
+  }
+
+  size_t getSize() const {
+    return size_;
+  }
+
+  void release() {
+    if (data_ != nullptr) {
+      munmap(data_, size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  ~MappedFile() {
+    release();
+  }
+};
+
+/*
+ * Reads the rest of the file into buf and appends a terminating zero, so
+ * parsers may look at *buf_ptr_ right after the last byte.
+ */
+size_t readWholeFile(FILE* file, std::vector<char>& buf) {
+  const size_t CHUNK_SIZE = 1 << 16;
+  size_t size = 0;
+
+  buf.clear();
+  while (true) {
+    buf.resize(size + CHUNK_SIZE);
+    size_t read_cnt = fread(buf.data() + size, sizeof(char), CHUNK_SIZE, file);
+
+    size += read_cnt;
+    if (read_cnt < CHUNK_SIZE) {
+      break;
+    }
+  }
+  buf.resize(size + 1);
+  buf[size] = '\0';
+  return size;
+}
+
 template<class T>
 struct Command {
   size_t cmd_id;
@@ -56,7 +146,49 @@ struct Command {
 
 bool isJump(const std::string& cmd_name) {
   return cmd_name == "jmp" || cmd_name == "call" || cmd_name == "je" || cmd_name == "jne" ||
-    cmd_name == "jl" || cmd_name == "jle";
+    cmd_name == "jl" || cmd_name == "jle" || cmd_name == "jg" || cmd_name == "jge";
+}
+
+/*
+ * base ^ exponent. A natural exponent is done by squaring from its top
+ * bit down, multiplying by base for every set bit; the rest goes to pow.
+ */
+template<class T>
+T raiseToPower(T base, T exponent) {
+  const T MAX_EXACT_INTEGER = 9007199254740992.0;
+
+  if (!(exponent >= 0) || exponent > MAX_EXACT_INTEGER || std::floor(exponent) != exponent) {
+    return std::pow(base, exponent);
+  }
+
+  unsigned long long power = static_cast<unsigned long long>(exponent);
+  int bit = 63;
+  T result = base;
+
+  if (power == 0) {
+    return 1;
+  }
+  while (((power >> bit) & 1) == 0) {
+    --bit;
+  }
+  for (--bit; bit >= 0; --bit) {
+    result *= result;
+    if (((power >> bit) & 1) != 0) {
+      result *= base;
+    }
+  }
+  return result;
+}
+
+/*
+ * x ^ n with a constant n from 1 up to this is compiled into the
+ * multiplications raiseToPower would do; longer chains take more commands
+ * than push and power.
+ */
+const int MAX_CHAIN_EXPONENT = 4;
+
+bool isChainExponent(double exponent) {
+  return exponent >= 1 && exponent <= MAX_CHAIN_EXPONENT && std::floor(exponent) == exponent;
 }
 
 
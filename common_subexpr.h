@@ -0,0 +1,350 @@
+//
+// Created by mike on 26.12.18.
+//
+
+#ifndef DED_PROG_LANG_COMMON_SUBEXPR_H
+#define DED_PROG_LANG_COMMON_SUBEXPR_H
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_analysis.h"
+
+/*
+ * Common subexpression elimination over extended basic blocks. Statements
+ * of a block are numbered in order of execution, the blocks of an if start
+ * with everything known before them (its condition included), and the body
+ * of a while starts with what the loop does not change. An expression is
+ * available until a variable it reads is written; a call may write every
+ * global. Expressions met more than once are computed into a temporary
+ * right before the statement of their first occurrence and every
+ * occurrence reads the temporary.
+ */
+class CommonSubexprPass : public Pass {
+ private:
+  struct ExprGroup {
+    Node* expr;
+    Node* block;
+    Node* statement;
+    int func_id;
+    std::vector<Node**> slots;
+  };
+
+  struct AvailableExpr {
+    size_t group_id;
+    std::set<VarKey> reads;
+  };
+
+  typedef std::vector<AvailableExpr> ExprTable;
+
+  /*
+   * What a statement may write: the variables it assigns and, when it has
+   * calls, every global.
+   */
+  struct StatementWrites {
+    std::set<VarKey> assigned;
+    bool has_calls;
+  };
+
+  struct BlockTask {
+    Node* block;
+    int func_id;
+    ExprTable table;
+  };
+
+  const Tree* tree_{nullptr};
+  std::vector<ExprGroup> groups_;
+  std::vector<BlockTask> tasks_;
+  std::unordered_map<const Node*, StatementWrites> writes_;
+  size_t replaced_cnt_{0};
+  size_t temp_cnt_{0};
+
+  static bool isBlock(const Node* node) {
+    return node->type == LOGIC && (node->value == CONDITION_MET || node->value == ELSE);
+  }
+
+  static bool isCandidate(const Node* node) {
+    if (node->type == OPERATOR) {
+      return !isAssignOperator(node);
+    }
+    return node->type == STANDART_FUNCTION &&
+      (node->value == SIN || node->value == COS || node->value == SQ_ROOT);
+  }
+
+  std::set<VarKey> findReads(const Node* root, int func_id) const {
+    std::set<VarKey> reads;
+    std::vector<const Node*> stack{root};
+
+    while (!stack.empty()) {
+      const Node* node = stack.back();
+      stack.pop_back();
+
+      if (isVariableNode(node)) {
+        reads.insert(getVarKey(*tree_, node, func_id));
+      }
+      for (const Node* son: node->sons) {
+        stack.push_back(son);
+      }
+    }
+    return reads;
+  }
+
+  static bool readsGlobals(const std::set<VarKey>& reads) {
+    return !reads.empty() && reads.begin()->func_id == -1;
+  }
+
+  /*
+   * Finds the writes of every node of a function at once, sons before
+   * fathers, so that nested statements are not walked again for each
+   * block around them.
+   */
+  void findWrites(const Node* root, int func_id) {
+    std::vector<std::pair<const Node*, bool>> stack{{root, false}};
+
+    while (!stack.empty()) {
+      const Node* node = stack.back().first;
+      bool sons_done = stack.back().second;
+      stack.pop_back();
+
+      if (!sons_done) {
+        stack.push_back({node, true});
+        for (const Node* son: node->sons) {
+          if (son != nullptr) {
+            stack.push_back({son, false});
+          }
+        }
+        continue;
+      }
+
+      StatementWrites& writes = writes_[node];
+      writes.has_calls = node->type == STANDART_FUNCTION && node->value == CALL;
+      if (isAssignOperator(node) || (node->type == STANDART_FUNCTION && node->value == INPUT)) {
+        writes.assigned.insert(getVarKey(*tree_, node->sons[0], func_id));
+      }
+      for (const Node* son: node->sons) {
+        if (son != nullptr) {
+          const StatementWrites& son_writes = writes_.at(son);
+          writes.assigned.insert(son_writes.assigned.begin(), son_writes.assigned.end());
+          writes.has_calls = writes.has_calls || son_writes.has_calls;
+        }
+      }
+    }
+  }
+
+  /*
+   * Drops what a statement writes: assigned variables and, after a call,
+   * every expression that reads a global.
+   */
+  void killWrites(ExprTable& table, Node* statement) const {
+    const StatementWrites& writes = writes_.at(statement);
+
+    auto is_killed = [&](const AvailableExpr& available) {
+      if (writes.has_calls && readsGlobals(available.reads)) {
+        return true;
+      }
+      for (const VarKey& key: writes.assigned) {
+        if (available.reads.count(key) != 0) {
+          return true;
+        }
+      }
+      return false;
+    };
+    table.erase(std::remove_if(table.begin(), table.end(), is_killed), table.end());
+  }
+
+  /*
+   * Matches the expressions under root against the table; the largest
+   * match wins and its subexpressions are not looked at. In a statement
+   * with calls the evaluation order around the call matters, so nothing
+   * that reads globals or may trap is taken there. The right operand of
+   * && and || may not run at all, so what is first met there is only
+   * taken when it cannot trap.
+   */
+  void scanExpression(Node** root_slot, Node* block, Node* statement, int func_id,
+                      ExprTable& table, bool can_add) {
+    bool statement_has_calls = writes_.at(statement).has_calls;
+    std::vector<std::pair<Node**, bool>> stack{{root_slot, false}};
+
+    while (!stack.empty()) {
+      Node** slot = stack.back().first;
+      bool is_conditional = stack.back().second;
+      stack.pop_back();
+      Node* node = *slot;
+
+      if (isCandidate(node) && isPureExpression(node, true)) {
+        std::set<VarKey> reads = findReads(node, func_id);
+        bool usable = !statement_has_calls || (!readsGlobals(reads) && isPureExpression(node));
+
+        if (usable) {
+          auto same = std::find_if(table.begin(), table.end(), [&](const AvailableExpr& available) {
+            return isSameTree(groups_[available.group_id].expr, node);
+          });
+          if (same != table.end()) {
+            groups_[same->group_id].slots.push_back(slot);
+            continue;
+          }
+          if (can_add && (!is_conditional || isPureExpression(node))) {
+            table.push_back({groups_.size(), reads});
+            groups_.push_back({node, block, statement, func_id, {slot}});
+          }
+        }
+      }
+      bool is_short_circuit = node->type == OPERATOR && (node->value == BOOL_AND || node->value == BOOL_OR);
+      for (size_t son_id = node->sons.size(); son_id > 0; --son_id) {
+        stack.push_back({&node->sons[son_id - 1], is_conditional || (is_short_circuit && son_id == 2)});
+      }
+    }
+  }
+
+  void scanBlock(BlockTask& task) {
+    size_t first_statement = (isBlock(task.block) ? 0 : 1);
+    ExprTable& table = task.table;
+
+    for (size_t son_id = first_statement; son_id < task.block->sons.size(); ++son_id) {
+      Node* statement = task.block->sons[son_id];
+
+      if (statement->type == LOGIC && statement->value == IF) {
+        scanExpression(&statement->sons[0]->sons[0], task.block, statement, task.func_id, table, true);
+        for (size_t branch_id = 1; branch_id < statement->sons.size(); ++branch_id) {
+          tasks_.push_back({statement->sons[branch_id], task.func_id, table});
+        }
+        killWrites(table, statement);
+      } else if (statement->type == LOGIC && statement->value == WHILE) {
+        killWrites(table, statement);
+        scanExpression(&statement->sons[0]->sons[0], task.block, statement, task.func_id, table, false);
+        tasks_.push_back({statement->sons[1], task.func_id, table});
+      } else if (isBlock(statement)) {
+        tasks_.push_back({statement, task.func_id, table});
+        killWrites(table, statement);
+      } else {
+        for (size_t arg_id = 0; arg_id < statement->sons.size(); ++arg_id) {
+          bool is_target = arg_id == 0 && (isAssignOperator(statement) ||
+                                           (statement->type == STANDART_FUNCTION && statement->value == INPUT));
+          if (!is_target && statement->type != VAR_INIT) {
+            scanExpression(&statement->sons[arg_id], task.block, statement, task.func_id, table, true);
+          }
+        }
+        killWrites(table, statement);
+      }
+    }
+  }
+
+  /*
+   * The temporaries a group reads, by the groups that compute them.
+   */
+  std::vector<size_t> findTempReads(const ExprGroup& group,
+                                    const std::map<std::pair<int, int>, size_t>& temp_groups) const {
+    std::vector<size_t> result;
+    std::vector<const Node*> stack{group.expr};
+
+    while (!stack.empty()) {
+      const Node* node = stack.back();
+      stack.pop_back();
+
+      if (node->type == LOCAL_VARIABLE) {
+        auto found = temp_groups.find({group.func_id, static_cast<int>(node->value)});
+        if (found != temp_groups.end()) {
+          result.push_back(found->second);
+        }
+      }
+      stack.insert(stack.end(), node->sons.begin(), node->sons.end());
+    }
+    return result;
+  }
+
+  /*
+   * Every occurrence reads the temporary first, then the assignments go
+   * before their statements, each one after the assignments of the
+   * temporaries it reads: a group nested in another one may have been
+   * met first anywhere in the statement.
+   */
+  void rewriteGroups(Tree& tree) {
+    std::vector<Node*> assignments(groups_.size(), nullptr);
+    std::map<std::pair<int, int>, size_t> temp_groups;
+
+    for (size_t group_id = 0; group_id < groups_.size(); ++group_id) {
+      ExprGroup& group = groups_[group_id];
+      if (group.slots.size() < 2) {
+        continue;
+      }
+
+      int temp = tree.addTemporary("cse", group.func_id);
+      for (Node** slot: group.slots) {
+        *slot = tree.newNode(LOCAL_VARIABLE, temp);
+      }
+      assignments[group_id] = tree.newNode(OPERATOR, EQUAL, {tree.newNode(LOCAL_VARIABLE, temp), group.expr});
+      temp_groups[{group.func_id, temp}] = group_id;
+      replaced_cnt_ += group.slots.size() - 1;
+      ++temp_cnt_;
+    }
+
+    std::vector<bool> placed(groups_.size(), false);
+    for (size_t first_id = 0; first_id < groups_.size(); ++first_id) {
+      std::vector<std::pair<size_t, bool>> stack{{first_id, false}};
+
+      while (!stack.empty()) {
+        size_t group_id = stack.back().first;
+        bool reads_placed = stack.back().second;
+        stack.pop_back();
+        const ExprGroup& group = groups_[group_id];
+
+        if (assignments[group_id] == nullptr || placed[group_id]) {
+          continue;
+        }
+        if (!reads_placed) {
+          stack.push_back({group_id, true});
+          for (size_t read_id: findTempReads(group, temp_groups)) {
+            if (groups_[read_id].statement == group.statement && !placed[read_id]) {
+              stack.push_back({read_id, false});
+            }
+          }
+          continue;
+        }
+
+        NodeList& statements = group.block->sons;
+        statements.insert(std::find(statements.begin(), statements.end(), group.statement), assignments[group_id]);
+        placed[group_id] = true;
+      }
+    }
+  }
+
+ public:
+  size_t run(Tree& tree) {
+    tree_ = &tree;
+    groups_.clear();
+    tasks_.clear();
+    writes_.clear();
+    replaced_cnt_ = 0;
+    temp_cnt_ = 0;
+
+    for (int func_id = 0; func_id < static_cast<int>(tree.getFuncCnt()); ++func_id) {
+      Node* func_node = tree.getFuncNode(func_id);
+      if (func_node != nullptr && !func_node->sons.empty()) {
+        findWrites(func_node, func_id);
+        tasks_.push_back({func_node, func_id, {}});
+      }
+    }
+    for (size_t task_id = 0; task_id < tasks_.size(); ++task_id) {
+      BlockTask task = tasks_[task_id];
+      scanBlock(task);
+      tasks_[task_id].table.clear();
+    }
+
+    rewriteGroups(tree);
+    return replaced_cnt_;
+  }
+
+  std::string getReport() const {
+    return "reused " + std::to_string(replaced_cnt_) + " expressions through " +
+      std::to_string(temp_cnt_) + " temporaries";
+  }
+};
+
+#endif //DED_PROG_LANG_COMMON_SUBEXPR_H
@@ -0,0 +1,284 @@
+//
+// Created by mike on 24.12.18.
+//
+
+#ifndef DED_PROG_LANG_CONSTANT_FOLDING_H
+#define DED_PROG_LANG_CONSTANT_FOLDING_H
+
+#include <cmath>
+#include <map>
+
+#include "common_classes.h"
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_analysis.h"
+#include "tree_visitor.h"
+
+/*
+ * Folds operators and standart functions on constants, drops neutral
+ * operands (x - 0, x + -0, x * 1, x / 1) and x = x, decides if and while
+ * blocks on constant conditions, and replaces reads of variables that are
+ * initialised with a constant and never written again by that constant.
+ * Folding never hides a run time error: divisions by zero and non-finite
+ * results stay as they are. Nor does it change results: -x runs as 0 - x
+ * and is folded so, x + 0 and -(-x) are +0 for x = -0, x * 0 is NaN or -0
+ * for some x, and (x + c1) + c2 rounds differently from x + (c1 + c2), so
+ * none of them is rewritten.
+ */
+class ConstantFoldingPass : public Pass {
+ private:
+  static const size_t MAX_ROUND_CNT = 16;
+
+  class Folder : public TreeRewriter {
+   private:
+    Node* makeNumber(double value) {
+      return tree_.newNode(NUMBER, value);
+    }
+
+    static bool evalBinary(int oper_type, double arg_a, double arg_b, double& result) {
+      switch (oper_type) {
+        case PLUS:
+          result = arg_a + arg_b;
+          break;
+        case MINUS:
+          result = arg_a - arg_b;
+          break;
+        case MULTIPLY:
+          result = arg_a * arg_b;
+          break;
+        case DIVIDE:
+          if (arg_b == 0.0) {
+            return false;
+          }
+          result = arg_a / arg_b;
+          break;
+        case POWER:
+          result = raiseToPower(arg_a, arg_b);
+          break;
+        case BOOL_EQUAL:
+          result = arg_a == arg_b;
+          break;
+        case BOOL_NOT_EQUAL:
+          result = arg_a != arg_b;
+          break;
+        case BOOL_LOWER:
+          result = arg_a < arg_b;
+          break;
+        case BOOL_GREATER:
+          result = arg_a > arg_b;
+          break;
+        case BOOL_NOT_LOWER:
+          result = arg_a >= arg_b;
+          break;
+        case BOOL_NOT_GREATER:
+          result = arg_a <= arg_b;
+          break;
+        case BOOL_AND:
+          result = arg_a != 0.0 && arg_b != 0.0;
+          break;
+        case BOOL_OR:
+          result = arg_a != 0.0 || arg_b != 0.0;
+          break;
+        default:
+          return false;
+      }
+      return std::isfinite(result);
+    }
+
+    Node* foldUnary(Node* node) {
+      Node* arg = node->sons[0];
+
+      if (arg->type == NUMBER) {
+        return makeNumber(node->value == MINUS ? 0.0 - arg->value : arg->value == 0.0);
+      }
+      return node;
+    }
+
+    Node* foldBinary(Node* node) {
+      int oper_type = static_cast<int>(node->value);
+      Node* arg_a = node->sons[0];
+      Node* arg_b = node->sons[1];
+      double result = 0.0;
+
+      if (arg_a->type == NUMBER && arg_b->type == NUMBER) {
+        if (evalBinary(oper_type, arg_a->value, arg_b->value, result)) {
+          return makeNumber(result);
+        }
+        return node;
+      }
+
+      switch (oper_type) {
+        /* only -0 added and +0 subtracted keep the sign of a zero x */
+        case PLUS:
+          if (isNumber(arg_b, 0.0) && std::signbit(arg_b->value)) {
+            return arg_a;
+          }
+          if (isNumber(arg_a, 0.0) && std::signbit(arg_a->value)) {
+            return arg_b;
+          }
+          break;
+        case MINUS:
+          if (isNumber(arg_b, 0.0) && !std::signbit(arg_b->value)) {
+            return arg_a;
+          }
+          break;
+        case MULTIPLY:
+          if (isNumber(arg_b, 1.0)) {
+            return arg_a;
+          }
+          if (isNumber(arg_a, 1.0)) {
+            return arg_b;
+          }
+          break;
+        case DIVIDE:
+          if (isNumber(arg_b, 1.0)) {
+            return arg_a;
+          }
+          break;
+        /* the right operand of && and || is not evaluated when the left one decides */
+        case BOOL_AND:
+          if (isNumber(arg_a, 0.0) || (isNumber(arg_b, 0.0) && isPureExpression(arg_a))) {
+            return makeNumber(0.0);
+          }
+          break;
+        case BOOL_OR:
+          if ((arg_a->type == NUMBER && arg_a->value != 0.0) ||
+              (arg_b->type == NUMBER && arg_b->value != 0.0 && isPureExpression(arg_a))) {
+            return makeNumber(1.0);
+          }
+          break;
+        default:
+          break;
+      }
+      return node;
+    }
+
+    Node* foldStandartFunction(Node* node) {
+      if (node->sons.size() != 1 || node->sons[0]->type != NUMBER) {
+        return node;
+      }
+
+      double arg = node->sons[0]->value;
+      double result = 0.0;
+      switch (static_cast<int>(node->value)) {
+        case SIN:
+          result = sin(arg);
+          break;
+        case COS:
+          result = cos(arg);
+          break;
+        case SQ_ROOT:
+          result = sqrt(arg);
+          break;
+        default:
+          return node;
+      }
+      return std::isfinite(result) ? makeNumber(result) : node;
+    }
+
+    /*
+     * x = x does nothing.
+     */
+    Node* foldAssign(Node* node) {
+      Node* target = node->sons[0];
+      Node* value = node->sons[1];
+
+      if (node->value == EQUAL && value->type == target->type && value->value == target->value) {
+        return nullptr;
+      }
+      return node;
+    }
+
+   protected:
+    Node* rewrite(Node* node, int /* func_id */) {
+      switch (node->type) {
+        case OPERATOR:
+          if (isAssignOperator(node)) {
+            return foldAssign(node);
+          }
+          return node->sons.size() == 1 ? foldUnary(node) : foldBinary(node);
+        case STANDART_FUNCTION:
+          return foldStandartFunction(node);
+        case LOGIC:
+          return resolveConstantLogic(node);
+        default:
+          return node;
+      }
+    }
+
+   public:
+    explicit Folder(Tree& tree): TreeRewriter(tree) {}
+  };
+
+  class Propagator : public TreeRewriter {
+   private:
+    const std::map<VarKey, double>& constants_;
+
+   protected:
+    Node* rewrite(Node* node, int func_id) {
+      if (node->type != VARIABLE && node->type != LOCAL_VARIABLE) {
+        return node;
+      }
+
+      auto iter = constants_.find(getVarKey(tree_, node, func_id));
+      if (iter == constants_.end()) {
+        return node;
+      }
+      return tree_.newNode(NUMBER, iter->second);
+    }
+
+   public:
+    Propagator(Tree& tree, const std::map<VarKey, double>& constants):
+      TreeRewriter(tree), constants_(constants) {}
+  };
+
+  static void addConstants(const Node* var_init, int func_id, int first_slot,
+                           const std::set<VarKey>& assigned, std::map<VarKey, double>& constants) {
+    for (size_t var_id = 0; var_id < var_init->sons.size(); ++var_id) {
+      const Node* value = var_init->sons[var_id];
+      VarKey key{func_id, first_slot + static_cast<int>(var_id)};
+
+      if (value != nullptr && value->type == NUMBER && assigned.count(key) == 0) {
+        constants[key] = value->value;
+      }
+    }
+  }
+
+  static std::map<VarKey, double> findConstants(const Tree& tree) {
+    std::map<VarKey, double> constants;
+    AssignedVarsFinder finder(tree);
+
+    finder.walk(tree.getRoot());
+    addConstants(tree.getRoot()->sons[0], -1, 0, finder.getAssigned(), constants);
+    for (int func_id = 0; func_id < static_cast<int>(tree.getFuncCnt()); ++func_id) {
+      if (tree.getFuncNode(func_id) == nullptr || tree.getFuncNode(func_id)->sons.empty()) {
+        continue;
+      }
+      addConstants(tree.getFuncNode(func_id)->sons[0], func_id, tree.getParamCnt(func_id),
+                   finder.getAssigned(), constants);
+    }
+    return constants;
+  }
+
+ public:
+  size_t run(Tree& tree) {
+    size_t change_cnt = 0;
+
+    for (size_t round = 0; round < MAX_ROUND_CNT; ++round) {
+      Folder folder(tree);
+      tree.setRoot(folder.walk(tree.getRoot()));
+      change_cnt += folder.getRewriteCnt();
+
+      std::map<VarKey, double> constants = findConstants(tree);
+      Propagator propagator(tree, constants);
+      tree.setRoot(propagator.walk(tree.getRoot()));
+      change_cnt += propagator.getRewriteCnt();
+      if (propagator.getRewriteCnt() == 0) {
+        break;
+      }
+    }
+    return change_cnt;
+  }
+};
+
+#endif //DED_PROG_LANG_CONSTANT_FOLDING_H
@@ -0,0 +1,249 @@
+//
+// Created by mike on 24.12.18.
+//
+
+#ifndef DED_PROG_LANG_DEAD_CODE_H
+#define DED_PROG_LANG_DEAD_CODE_H
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_analysis.h"
+#include "tree_visitor.h"
+
+/*
+ * Removes code that cannot run or whose result is never used: statements
+ * after return, if and while blocks on constant conditions, empty ifs on
+ * pure conditions, stores with pure values to variables that are never
+ * read, variables that are no longer referenced (shrinking the frames) and
+ * functions that cannot be reached from main. Stores are dead only when
+ * the variable is not read anywhere but in values stored to itself; no
+ * flow analysis is done here.
+ */
+class DeadCodePass : public Pass {
+ private:
+  static const size_t MAX_ROUND_CNT = 16;
+
+  static bool isBlock(const Node* node) {
+    return (node->type == USER_FUNCTION && !node->sons.empty()) || node->type == MAIN ||
+      (node->type == LOGIC && (node->value == CONDITION_MET || node->value == ELSE));
+  }
+
+  static bool isEmptyBlock(const Node* node) {
+    return node == nullptr || (isBlock(node) && node->sons.empty());
+  }
+
+  /*
+   * Finds variables which are read and variables which are referenced at
+   * all. The target of an assignment or of scan is not a read.
+   */
+  class VarUseFinder : public TreeVisitor {
+   private:
+    std::set<VarKey> read_;
+    std::set<VarKey> referenced_;
+
+   protected:
+    bool preVisit(Node* node, int func_id) {
+      if (!isVariableNode(node)) {
+        return true;
+      }
+
+      VarKey key = getVarKey(tree_, node, func_id);
+      Node* father = getAncestor();
+      referenced_.insert(key);
+      if (father != nullptr && father->sons[0] == node &&
+          (isAssignOperator(father) || (father->type == STANDART_FUNCTION && father->value == INPUT))) {
+        return true;
+      }
+      if (!feedsItself(key, func_id)) {
+        read_.insert(key);
+      }
+      return true;
+    }
+
+    /*
+     * A read inside the pure value stored to the same variable, as in
+     * x = x + 1, keeps nothing else alive. A read passed to a call, print
+     * or anything else with effects is a read.
+     */
+    bool feedsItself(const VarKey& key, int func_id) const {
+      for (size_t up = 1; getAncestor(up) != nullptr; ++up) {
+        Node* ancestor = getAncestor(up);
+
+        if (isAssignOperator(ancestor)) {
+          return getVarKey(tree_, ancestor->sons[0], func_id) == key && isPureExpression(ancestor->sons[1]);
+        }
+        if (ancestor->type != OPERATOR && ancestor->type != STANDART_FUNCTION) {
+          return false;
+        }
+        if (ancestor->type == STANDART_FUNCTION &&
+            (ancestor->value == CALL || ancestor->value == INPUT || ancestor->value == OUTPUT)) {
+          return false;
+        }
+      }
+      return false;
+    }
+
+   public:
+    explicit VarUseFinder(const Tree& tree): TreeVisitor(tree) {}
+
+    const std::set<VarKey>& getRead() const {
+      return read_;
+    }
+
+    const std::set<VarKey>& getReferenced() const {
+      return referenced_;
+    }
+  };
+
+  class BlockCleaner : public TreeRewriter {
+   private:
+    const std::set<VarKey>& read_;
+
+    bool isDeadStatement(const Node* node, int func_id) const {
+      if (node->type == VAR_INIT && node->sons.empty()) {
+        return true;
+      }
+      return isAssignOperator(node) && read_.count(getVarKey(tree_, node->sons[0], func_id)) == 0 &&
+        isPureExpression(node->sons[1]);
+    }
+
+    void cleanBlock(Node* block, int func_id) {
+      size_t first_statement = (block->type == LOGIC ? 0 : 1);
+      size_t next_son = first_statement;
+
+      for (size_t son_id = first_statement; son_id < block->sons.size(); ++son_id) {
+        Node* son = block->sons[son_id];
+
+        if (isDeadStatement(son, func_id)) {
+          continue;
+        }
+        block->sons[next_son++] = son;
+        if (son->type == RETURN) {
+          break;
+        }
+      }
+      noteChanges(block->sons.size() - next_son);
+      block->sons.resize(next_son);
+    }
+
+   protected:
+    Node* rewrite(Node* node, int func_id) {
+      if (isBlock(node)) {
+        cleanBlock(node, getSonFuncId(tree_, node, func_id));
+        return node;
+      }
+      if (node->type != LOGIC) {
+        return node;
+      }
+
+      Node* result = resolveConstantLogic(node);
+      if (result != node) {
+        return result;
+      }
+      if (node->value == IF && isEmptyBlock(node->sons[1]) &&
+          (node->sons.size() < 3 || isEmptyBlock(node->sons[2])) && isPureExpression(node->sons[0]->sons[0])) {
+        return nullptr;
+      }
+      return node;
+    }
+
+   public:
+    BlockCleaner(Tree& tree, const std::set<VarKey>& read): TreeRewriter(tree), read_(read) {}
+  };
+
+  class VarRenumberer : public TreeRewriter {
+   private:
+    const std::vector<std::vector<int>>& new_slots_;
+
+   protected:
+    Node* rewrite(Node* node, int func_id) {
+      if (node->type == VARIABLE || (node->type == LOCAL_VARIABLE && func_id == -1)) {
+        node->value = new_slots_[0][static_cast<int>(node->value)];
+      } else if (node->type == LOCAL_VARIABLE) {
+        node->value = new_slots_[func_id + 1][static_cast<int>(node->value)];
+      }
+      return node;
+    }
+
+   public:
+    VarRenumberer(Tree& tree, const std::vector<std::vector<int>>& new_slots):
+      TreeRewriter(tree), new_slots_(new_slots) {}
+  };
+
+  static size_t removeFunctions(Tree& tree) {
+    CallGraphFinder finder(tree);
+    finder.walk(tree.getRoot());
+
+    std::vector<bool> reachable = finder.findReachable();
+    size_t removed_cnt = std::count(reachable.begin(), reachable.end(), false);
+    if (removed_cnt == 0) {
+      return 0;
+    }
+
+    std::vector<int> new_ids = tree.compactFunctions(reachable);
+    FuncRenumberer renumberer(tree, new_ids);
+    renumberer.walk(tree.getRoot());
+    return removed_cnt;
+  }
+
+  static bool isVarUsed(const Tree& tree, const std::set<VarKey>& referenced, int func_id, int var_id) {
+    int first_slot = (func_id == -1 ? 0 : tree.getParamCnt(func_id));
+    Node* init_value = tree.getVarInitNode(func_id)->sons[var_id];
+
+    return referenced.count({func_id, first_slot + var_id}) != 0 || !isPureExpression(init_value);
+  }
+
+  static size_t removeVariables(Tree& tree) {
+    VarUseFinder finder(tree);
+    finder.walk(tree.getRoot());
+
+    std::vector<std::vector<int>> new_slots;
+    size_t removed_cnt = 0;
+    for (int func_id = -1; func_id < static_cast<int>(tree.getFuncCnt()); ++func_id) {
+      if (func_id != -1 && (tree.getFuncNode(func_id) == nullptr || tree.getFuncNode(func_id)->sons.empty())) {
+        new_slots.emplace_back();
+        continue;
+      }
+      size_t var_cnt = tree.getVarInitNode(func_id)->sons.size();
+      std::vector<bool> used(var_cnt);
+
+      for (size_t var_id = 0; var_id < var_cnt; ++var_id) {
+        used[var_id] = isVarUsed(tree, finder.getReferenced(), func_id, var_id);
+        removed_cnt += !used[var_id];
+      }
+      new_slots.push_back(tree.compactVariables(func_id, used));
+    }
+
+    if (removed_cnt != 0) {
+      VarRenumberer renumberer(tree, new_slots);
+      renumberer.walk(tree.getRoot());
+    }
+    return removed_cnt;
+  }
+
+ public:
+  size_t run(Tree& tree) {
+    size_t change_cnt = 0;
+
+    for (size_t round = 0; round < MAX_ROUND_CNT; ++round) {
+      VarUseFinder finder(tree);
+      finder.walk(tree.getRoot());
+
+      BlockCleaner cleaner(tree, finder.getRead());
+      cleaner.walk(tree.getRoot());
+
+      size_t round_change_cnt = cleaner.getRewriteCnt() + removeFunctions(tree) + removeVariables(tree);
+      change_cnt += round_change_cnt;
+      if (round_change_cnt == 0) {
+        break;
+      }
+    }
+    return change_cnt;
+  }
+};
+
+#endif //DED_PROG_LANG_DEAD_CODE_H
@@ -48,6 +48,15 @@ struct IncorrectParsingException : public InterpreterException {
   }
 };
 
+struct IncorrectTreeFileException : public InterpreterException {
+  IncorrectTreeFileException(const std::string& message, const std::string& function_name = ""):
+    InterpreterException(message, function_name) {}
+
+  std::string getLabel() const {
+    return "IncorrectTreeFileException";
+  }
+};
+
 struct DivisionByZeroException : public InterpreterException {
   DivisionByZeroException(const std::string& message, const std::string& function_name = ""):
     InterpreterException(message, function_name) {}
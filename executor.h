@@ -7,7 +7,10 @@
 
 #define NDEBUG
 
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <cmath>
 
@@ -15,23 +18,43 @@
 #include "ram.h"
 #include "file_buffer.h"
 #include "common_classes.h"
+#include "profile.h"
 
 const size_t REGISTER_COUNT = 16;
-const size_t COMMAND_COUNT = 30;
+const size_t COMMAND_COUNT = 37;
 const size_t MAX_ARG_COUNT = 2;
+const size_t FRAME_REGISTER = 3;
+
+/*
+ * What call keeps for ret: the place to come back to and the frame of the
+ * caller. Frames lie one after another in RAM: enter opens one at the end
+ * of the last, leave gives it back and returns to the frame of the caller.
+ */
+template<class T>
+struct CallFrame {
+  size_t return_address;
+  T frame_base;
+};
 
 template<class T = double>
 class Processor {
  private:
-  T registers_[REGISTER_COUNT];
+  T registers_[REGISTER_COUNT]{};
   Stack<T> stack_;
-  Stack<size_t> instruction_stack_;
+  Stack<CallFrame<T>> call_stack_;
+  T frame_end_{0};
   RAM<T> ram_;
   FileBuffer fbuffer_;
 
   size_t instruction_pointer_{0};
 
   std::vector<Command<T>> commands;
+  std::vector<size_t> exec_counts_;
+
+  std::unordered_map<std::string, T> memo_table_;
+  std::vector<std::string> memo_keys_;
+  size_t memo_hit_cnt_{0};
+  size_t memo_miss_cnt_{0};
 
 
 
@@ -90,6 +113,45 @@ class Processor {
     return static_cast<int>(arg.first);
   }
 
+  /*
+   * memo_get looks the function and the arguments on top of the stack up
+   * by their bytes. A hit leaves the result in place of the arguments, a
+   * miss leaves the arguments and remembers the key for the memo_put that
+   * stores the value the function returns.
+   */
+  bool memoGet(T func_id, T arg_cnt) {
+    std::vector<T> key_values(static_cast<size_t>(arg_cnt) + 1);
+
+    key_values[0] = func_id;
+    for (size_t arg_id = key_values.size() - 1; arg_id > 0; --arg_id) {
+      key_values[arg_id] = stack_.extract();
+    }
+
+    std::string key(key_values.size() * sizeof(T), '\0');
+    memcpy(&key[0], key_values.data(), key.size());
+    auto found = memo_table_.find(key);
+    if (found != memo_table_.end()) {
+      ++memo_hit_cnt_;
+      stack_.push(found->second);
+      return true;
+    }
+
+    ++memo_miss_cnt_;
+    for (size_t arg_id = 1; arg_id < key_values.size(); ++arg_id) {
+      stack_.push(key_values[arg_id]);
+    }
+    memo_keys_.push_back(key);
+    return false;
+  }
+
+  void memoPut() {
+    if (memo_keys_.empty()) {
+      throw IncorrectArgumentException("memo_put without memo_get", __PRETTY_FUNCTION__);
+    }
+    memo_table_[memo_keys_.back()] = stack_.top();
+    memo_keys_.pop_back();
+  }
+
   void inCmd(T& value) {
     std::cout << "# enter a value, please\n";
     std::cin >> value;
@@ -130,18 +192,53 @@ class Processor {
     return instruction_pointer_ == commands.size();
   }
 
+  /*
+   * From now on every executed command is counted, so that writeProfile
+   * can tell how many times the program reached each label.
+   */
+  void enableProfile() {
+    exec_counts_.assign(commands.size(), 0);
+  }
+
   void executeAll() {
     while (!isDone()) {
+      if (!exec_counts_.empty()) {
+        ++exec_counts_[instruction_pointer_];
+      }
       executeCommand();
     }
     std::cout << "# processor: execution is finished\n";
+    if (memo_hit_cnt_ + memo_miss_cnt_ != 0) {
+      std::cout << "# processor: memo hits " << memo_hit_cnt_ << ", misses " << memo_miss_cnt_ << "\n";
+    }
+  }
+
+  void writeProfile(FILE* profile_file, const std::unordered_map<std::string, int>& labels) const {
+    ExecutionProfile profile;
+
+    for (const auto& label: labels) {
+      size_t address = static_cast<size_t>(label.second);
+      profile.setCount(label.first, address < exec_counts_.size() ? exec_counts_[address] : 0);
+    }
+    profile.write(profile_file);
   }
 };
 
-void execute(FILE* binary_file) {
+/*
+ * With a profile file the labels the assembler resolved name the counts
+ * written there.
+ */
+void execute(FILE* binary_file, FILE* profile_file = nullptr,
+             const std::unordered_map<std::string, int>* labels = nullptr) {
   Processor<> processor(binary_file);
 
+  if (profile_file != nullptr) {
+    processor.enableProfile();
+  }
   processor.executeAll();
+  if (profile_file != nullptr && labels != nullptr) {
+    processor.writeProfile(profile_file, *labels);
+  }
 }
 
 #endif //DED_PROG_LANG_EXECUTOR_H
@@ -5,19 +5,21 @@
 #ifndef DED_PROG_LANG_FILE_BUFFER_H
 #define DED_PROG_LANG_FILE_BUFFER_H
 
-const size_t BUF_SIZE = 1 << 16;
+#include <vector>
+
+#include "common_classes.h"
 
 class FileBuffer {
  private:
-  char buf_[BUF_SIZE];
+  std::vector<char> buf_;
   size_t buf_size_{0};
   char* buf_ptr_{nullptr};
 
  public:
 
   FileBuffer(FILE* binary_file) {
-    buf_size_ = fread((void*)buf_, sizeof(char), BUF_SIZE - 1, binary_file);
-    buf_ptr_ = buf_;
+    buf_size_ = readWholeFile(binary_file, buf_);
+    buf_ptr_ = buf_.data();
     std::cout << "file size: " << buf_size_ << " bytes\n";
   }
 
@@ -29,7 +31,7 @@ class FileBuffer {
   }
 
   bool done() const {
-    return buf_ptr_ == buf_ + buf_size_;
+    return buf_ptr_ == buf_.data() + buf_size_;
   }
 
 };
@@ -0,0 +1,498 @@
+//
+// Created by mike on 22.12.18.
+//
+
+#ifndef DED_PROG_LANG_FLAT_TREE_H
+#define DED_PROG_LANG_FLAT_TREE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+#include "exception.h"
+#include "tree.h"
+
+/*
+ * One node of the flat tree. Sons of a node occupy the contiguous range
+ * [first_son, first_son + son_cnt) of the node array. The payload is the
+ * operator, logic or function kind, the slot of a variable, the id of a
+ * function or, for numbers, an index into the number pool.
+ */
+struct FlatNode {
+  uint8_t type;
+  uint8_t reserved[3];
+  int32_t payload;
+  uint32_t first_son;
+  uint32_t son_cnt;
+};
+
+static_assert(sizeof(FlatNode) == 16, "FlatNode should stay 16 bytes");
+
+struct FlatFunc {
+  uint32_t name;
+  uint32_t first_param;
+  uint32_t param_cnt;
+  uint32_t first_var;
+  uint32_t var_cnt;
+};
+
+/*
+ * Header of the binary tree file. It is followed by the sections in the
+ * order numbers, nodes, funcs, symbols, strings; their sizes keep every
+ * section aligned, so a mapped file is used in place.
+ */
+struct FlatTreeHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t global_cnt;
+  uint32_t number_cnt;
+  uint32_t node_cnt;
+  uint32_t func_cnt;
+  uint32_t symbol_cnt;
+  uint32_t string_size;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(FlatTreeHeader) % sizeof(double) == 0, "sections after the header must stay aligned");
+
+/*
+ * Array that lives either in a vector of the tree or in a mapped file.
+ */
+template<class T>
+struct FlatSection {
+  const T* data{nullptr};
+  size_t size{0};
+
+  const T& operator[](size_t item_id) const {
+    return data[item_id];
+  }
+
+  void attach(const std::vector<T>& buf) {
+    data = buf.data();
+    size = buf.size();
+  }
+
+  const char* attach(const char* ptr, size_t item_cnt) {
+    data = reinterpret_cast<const T*>(ptr);
+    size = item_cnt;
+    return ptr + item_cnt * sizeof(T);
+  }
+};
+
+/*
+ * Read-only layout of a finished program: nodes in one array addressed by
+ * 32-bit indices in breadth first order, numbers in a pool and all names
+ * in a string table. Printing, code generation and the visualizer walk it
+ * instead of the pointer tree. The same arrays are the binary tree file,
+ * so a loaded tree points straight into the mapped file.
+ */
+class FlatTree {
+ private:
+  static const uint32_t FORMAT_VERSION = 1;
+
+  std::vector<FlatNode> node_buf_;
+  std::vector<double> number_buf_;
+  std::vector<char> string_buf_;
+  std::vector<uint32_t> symbol_buf_;
+  std::vector<FlatFunc> func_buf_;
+
+  FlatSection<FlatNode> nodes_;
+  FlatSection<double> numbers_;
+  FlatSection<char> strings_;
+  FlatSection<uint32_t> symbols_;
+  FlatSection<FlatFunc> funcs_;
+  uint32_t global_cnt_{0};
+
+  void attachBuffers() {
+    nodes_.attach(node_buf_);
+    numbers_.attach(number_buf_);
+    strings_.attach(string_buf_);
+    symbols_.attach(symbol_buf_);
+    funcs_.attach(func_buf_);
+  }
+
+  static void checkFormat(bool condition, const std::string& message) {
+    if (!condition) {
+      throw IncorrectTreeFileException(message, __PRETTY_FUNCTION__);
+    }
+  }
+
+  void checkNodes() const {
+    for (size_t node_id = 0; node_id < nodes_.size; ++node_id) {
+      const FlatNode& node = nodes_[node_id];
+
+      checkFormat(node.type <= PARAM, "node " + std::to_string(node_id) + " has unknown type");
+      if (node.son_cnt != 0) {
+        checkFormat(node.first_son > node_id && node.first_son <= nodes_.size &&
+                    node.son_cnt <= nodes_.size - node.first_son,
+                    "sons of node " + std::to_string(node_id) + " are out of range");
+      }
+      switch (node.type) {
+        case NUMBER:
+          checkFormat(node.payload >= 0 && static_cast<size_t>(node.payload) < numbers_.size,
+                      "number of node " + std::to_string(node_id) + " is out of range");
+          break;
+        case USER_FUNCTION:
+          checkFormat(node.payload >= 0 && static_cast<size_t>(node.payload) < funcs_.size,
+                      "function of node " + std::to_string(node_id) + " is out of range");
+          break;
+        case VARIABLE:
+          checkFormat(node.payload >= 0 && static_cast<uint32_t>(node.payload) < global_cnt_,
+                      "variable of node " + std::to_string(node_id) + " is out of range");
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  void checkSymbols() const {
+    checkFormat(symbols_.size == 0 || (strings_.size > 0 && strings_[strings_.size - 1] == '\0'),
+                "string table is not terminated");
+    checkFormat(global_cnt_ <= symbols_.size, "globals are out of the symbol table");
+    for (size_t symbol_id = 0; symbol_id < symbols_.size; ++symbol_id) {
+      checkFormat(symbols_[symbol_id] < strings_.size, "symbol " + std::to_string(symbol_id) + " is out of range");
+    }
+    for (size_t func_id = 0; func_id < funcs_.size; ++func_id) {
+      const FlatFunc& func = funcs_[func_id];
+
+      checkFormat(func.name < symbols_.size &&
+                  func.first_param <= symbols_.size && func.param_cnt <= symbols_.size - func.first_param &&
+                  func.first_var <= symbols_.size && func.var_cnt <= symbols_.size - func.first_var,
+                  "names of function " + std::to_string(func_id) + " are out of the symbol table");
+    }
+  }
+
+  uint32_t addNumber(double value, std::unordered_map<uint64_t, uint32_t>& number_ids) {
+    uint64_t bits = 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+    auto iter = number_ids.find(bits);
+    if (iter != number_ids.end()) {
+      return iter->second;
+    }
+    number_buf_.push_back(value);
+    number_ids[bits] = number_buf_.size() - 1;
+    return number_buf_.size() - 1;
+  }
+
+  FlatNode makeFlatNode(Node* node, std::unordered_map<uint64_t, uint32_t>& number_ids) {
+    FlatNode result{};
+
+    result.type = static_cast<uint8_t>(node->type);
+    if (node->type == NUMBER) {
+      result.payload = addNumber(node->value, number_ids);
+    } else {
+      result.payload = static_cast<int32_t>(node->value);
+    }
+    return result;
+  }
+
+  uint32_t addSymbol(const StringRef& name) {
+    symbol_buf_.push_back(string_buf_.size());
+    string_buf_.insert(string_buf_.end(), name.begin(), name.end());
+    string_buf_.push_back('\0');
+    return symbol_buf_.size() - 1;
+  }
+
+  uint32_t addSymbols(const std::vector<StringRef>& names) {
+    uint32_t first_symbol = symbol_buf_.size();
+
+    for (const StringRef& name: names) {
+      addSymbol(name);
+    }
+    return first_symbol;
+  }
+
+ public:
+  static const uint32_t NO_NODE = UINT32_MAX;
+
+  FlatTree() {}
+
+  FlatTree(const FlatTree& another) = delete;
+  FlatTree& operator=(const FlatTree& another) = delete;
+  FlatTree(FlatTree&& another) = default;
+  FlatTree& operator=(FlatTree&& another) = default;
+
+  explicit FlatTree(const Tree& tree) {
+    setGlobals(tree.getGlobalNames());
+    for (size_t func_id = 0; func_id < tree.getFuncCnt(); ++func_id) {
+      addFunction(tree.getFuncName(func_id), tree.getParamNames(func_id), tree.getVarNames(func_id));
+    }
+    layout(tree.getRoot());
+  }
+
+  /*
+   * Lays the pointer tree out breadth first, so that the sons of every node
+   * get neighbouring indices.
+   */
+  void layout(Node* root) {
+    std::unordered_map<uint64_t, uint32_t> number_ids;
+    std::vector<Node*> sources;
+
+    node_buf_.clear();
+    number_buf_.clear();
+    if (root == nullptr) {
+      attachBuffers();
+      return;
+    }
+    sources.push_back(root);
+    node_buf_.push_back(makeFlatNode(root, number_ids));
+
+    for (size_t node_id = 0; node_id < sources.size(); ++node_id) {
+      Node* node = sources[node_id];
+      uint32_t first_son = node_buf_.size();
+
+      for (Node* son: node->sons) {
+        if (son != nullptr) {
+          sources.push_back(son);
+          node_buf_.push_back(makeFlatNode(son, number_ids));
+        }
+      }
+      node_buf_[node_id].first_son = first_son;
+      node_buf_[node_id].son_cnt = node_buf_.size() - first_son;
+    }
+    attachBuffers();
+  }
+
+  void setGlobals(const std::vector<StringRef>& names) {
+    global_cnt_ = names.size();
+    addSymbols(names);
+    attachBuffers();
+  }
+
+  void addFunction(const StringRef& name, const std::vector<StringRef>& params,
+                   const std::vector<StringRef>& vars) {
+    FlatFunc func{};
+
+    func.name = addSymbol(name);
+    func.param_cnt = params.size();
+    func.first_param = addSymbols(params);
+    func.var_cnt = vars.size();
+    func.first_var = addSymbols(vars);
+    func_buf_.push_back(func);
+    attachBuffers();
+  }
+
+  /*
+   * Writes the binary tree file, the format load() maps back.
+   */
+  void writeBinary(FILE* tree_file) const {
+    FlatTreeHeader header{};
+
+    memcpy(header.magic, "LOLTREE", sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.global_cnt = global_cnt_;
+    header.number_cnt = numbers_.size;
+    header.node_cnt = nodes_.size;
+    header.func_cnt = funcs_.size;
+    header.symbol_cnt = symbols_.size;
+    header.string_size = strings_.size;
+
+    fwrite(&header, sizeof(header), 1, tree_file);
+    fwrite(numbers_.data, sizeof(double), numbers_.size, tree_file);
+    fwrite(nodes_.data, sizeof(FlatNode), nodes_.size, tree_file);
+    fwrite(funcs_.data, sizeof(FlatFunc), funcs_.size, tree_file);
+    fwrite(symbols_.data, sizeof(uint32_t), symbols_.size, tree_file);
+    fwrite(strings_.data, sizeof(char), strings_.size, tree_file);
+  }
+
+  /*
+   * Points the tree into a binary tree file kept in memory, usually a
+   * mapped one that must outlive the tree. Nothing is parsed or copied,
+   * the sections are only checked once, so later walks may trust them.
+   */
+  void load(const char* data, size_t size) {
+    FlatTreeHeader header{};
+
+    checkFormat(data != nullptr && size >= sizeof(header), "tree file is too short");
+    memcpy(&header, data, sizeof(header));
+    checkFormat(memcmp(header.magic, "LOLTREE", sizeof(header.magic)) == 0, "not a binary tree file");
+    checkFormat(header.version == FORMAT_VERSION, "unsupported tree file version " +
+                                                  std::to_string(header.version));
+    checkFormat(reinterpret_cast<size_t>(data) % alignof(double) == 0, "tree file is not aligned");
+
+    size_t expected_size = sizeof(header) + header.number_cnt * sizeof(double) +
+      static_cast<size_t>(header.node_cnt) * sizeof(FlatNode) +
+      static_cast<size_t>(header.func_cnt) * sizeof(FlatFunc) +
+      static_cast<size_t>(header.symbol_cnt) * sizeof(uint32_t) + header.string_size;
+    checkFormat(size == expected_size, "tree file size " + std::to_string(size) +
+                                       " does not match its header " + std::to_string(expected_size));
+
+    const char* ptr = data + sizeof(header);
+    ptr = numbers_.attach(ptr, header.number_cnt);
+    ptr = nodes_.attach(ptr, header.node_cnt);
+    ptr = funcs_.attach(ptr, header.func_cnt);
+    ptr = symbols_.attach(ptr, header.symbol_cnt);
+    strings_.attach(ptr, header.string_size);
+    global_cnt_ = header.global_cnt;
+
+    try {
+      checkSymbols();
+      checkNodes();
+    } catch (IncorrectTreeFileException& exc) {
+      *this = FlatTree();
+      throw;
+    }
+  }
+
+  bool empty() const {
+    return nodes_.size == 0;
+  }
+
+  uint32_t getRoot() const {
+    return empty() ? NO_NODE : 0;
+  }
+
+  size_t getNodeCnt() const {
+    return nodes_.size;
+  }
+
+  NodeType getType(uint32_t node_id) const {
+    return static_cast<NodeType>(nodes_[node_id].type);
+  }
+
+  int getPayload(uint32_t node_id) const {
+    return nodes_[node_id].payload;
+  }
+
+  double getValue(uint32_t node_id) const {
+    if (getType(node_id) == NUMBER) {
+      return numbers_[nodes_[node_id].payload];
+    }
+    return nodes_[node_id].payload;
+  }
+
+  uint32_t getSonCnt(uint32_t node_id) const {
+    return nodes_[node_id].son_cnt;
+  }
+
+  uint32_t getSon(uint32_t node_id, uint32_t son_pos) const {
+    return nodes_[node_id].first_son + son_pos;
+  }
+
+  uint32_t getLastSon(uint32_t node_id) const {
+    return nodes_[node_id].first_son + nodes_[node_id].son_cnt - 1;
+  }
+
+  const char* getSymbol(uint32_t symbol_id) const {
+    return strings_.data + symbols_[symbol_id];
+  }
+
+  size_t getGlobalCnt() const {
+    return global_cnt_;
+  }
+
+  const char* getGlobalName(size_t var_id) const {
+    return getSymbol(var_id);
+  }
+
+  size_t getFuncCnt() const {
+    return funcs_.size;
+  }
+
+  int getMainId() const {
+    return static_cast<int>(funcs_.size) - 1;
+  }
+
+  const char* getFuncName(int func_id) const {
+    return getSymbol(funcs_[func_id].name);
+  }
+
+  size_t getParamCnt(int func_id) const {
+    return funcs_[func_id].param_cnt;
+  }
+
+  size_t getVarCnt(int func_id) const {
+    return funcs_[func_id].var_cnt;
+  }
+
+  size_t getFrameSize(int func_id) const {
+    return getParamCnt(func_id) + getVarCnt(func_id);
+  }
+
+  const char* getParamName(int func_id, size_t param_id) const {
+    return getSymbol(funcs_[func_id].first_param + param_id);
+  }
+
+  const char* getVarName(int func_id, size_t var_id) const {
+    return getSymbol(funcs_[func_id].first_var + var_id);
+  }
+
+  void printLevel(const std::string& text, FILE* tree_file, size_t level) const {
+    for (size_t sep_id = 0; sep_id < level; ++sep_id) {
+      fprintf(tree_file, "  ");
+    }
+    fprintf(tree_file, "%s\n", text.c_str());
+  }
+
+  std::string prettyDouble(double value) const {
+    if (value == static_cast<int>(value)) {
+      return std::to_string(static_cast<int>(value));
+    }
+    return std::to_string(value);
+  }
+
+  std::string nodeHeader(uint32_t node_id) const {
+    return std::string("[ ") + std::to_string(getType(node_id)) + " " + prettyDouble(getValue(node_id));
+  }
+
+  struct PrintFrame {
+    uint32_t node_id;
+    uint32_t next_son;
+  };
+
+  void printNodes(FILE* tree_file) const {
+    if (empty()) {
+      return;
+    }
+    std::vector<PrintFrame> frames{{getRoot(), 0}};
+
+    while (!frames.empty()) {
+      PrintFrame& frame = frames.back();
+      uint32_t node_id = frame.node_id;
+      size_t level = frames.size() - 1;
+
+      if (getSonCnt(node_id) == 0) {
+        printLevel(nodeHeader(node_id) + "]", tree_file, level);
+        frames.pop_back();
+        continue;
+      }
+      if (frame.next_son == 0) {
+        printLevel(nodeHeader(node_id), tree_file, level);
+      }
+      if (frame.next_son == getSonCnt(node_id)) {
+        printLevel("]", tree_file, level);
+        frames.pop_back();
+        continue;
+      }
+      frames.push_back({getSon(node_id, frame.next_son++), 0});
+    }
+  }
+
+  void printTree(FILE* tree_file) const {
+    fprintf(tree_file, "VARS %zu\n", getGlobalCnt());
+    for (size_t var_id = 0; var_id < getGlobalCnt(); ++var_id) {
+      fprintf(tree_file, "%s\n", getGlobalName(var_id));
+    }
+
+    fprintf(tree_file, "FUNCS %zu\n", getFuncCnt());
+    for (size_t func_id = 0; func_id < getFuncCnt(); ++func_id) {
+      fprintf(tree_file, "%s:\nPARAMS %zu\n", getFuncName(func_id), getParamCnt(func_id));
+      for (size_t param_id = 0; param_id < getParamCnt(func_id); ++param_id) {
+        fprintf(tree_file, "%s\n", getParamName(func_id, param_id));
+      }
+      fprintf(tree_file, "NEWVAR %zu\n", getVarCnt(func_id));
+      for (size_t var_id = 0; var_id < getVarCnt(func_id); ++var_id) {
+        fprintf(tree_file, "%s\n", getVarName(func_id, var_id));
+      }
+    }
+    printNodes(tree_file);
+  }
+};
+
+#endif //DED_PROG_LANG_FLAT_TREE_H
@@ -0,0 +1,176 @@
+//
+// Created by mike on 03.01.19.
+//
+
+#ifndef DED_PROG_LANG_FUNCTION_MERGING_H
+#define DED_PROG_LANG_FUNCTION_MERGING_H
+
+#include <cmath>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_analysis.h"
+#include "tree_visitor.h"
+
+/*
+ * Merges functions with the same code into one. Parameters and locals are
+ * numbered by position, so functions that differ only in names have the
+ * same trees; calls of a function to itself are compared as such, not by
+ * id. Functions are grouped by a hash of their trees, calls of every
+ * function equal to one with a smaller id go to that one, and this repeats
+ * while it makes more callers equal. The functions no one calls then are
+ * dropped. Main is never merged.
+ */
+class FunctionMergingPass : public Pass {
+ private:
+  class CallRedirector : public TreeVisitor {
+   private:
+    const std::vector<int>& replacements_;
+
+    bool preVisit(Node* node, int /* func_id */) {
+      if (node->type == STANDART_FUNCTION && node->value == CALL) {
+        node->sons[0]->value = replacements_[static_cast<int>(node->sons[0]->value)];
+      }
+      return true;
+    }
+
+   public:
+    CallRedirector(const Tree& tree, const std::vector<int>& replacements):
+      TreeVisitor(tree), replacements_(replacements) {}
+  };
+
+  std::vector<std::pair<std::string, std::string>> merged_;
+
+  static double getComparedValue(const Node* node, int func_id) {
+    if (node->type == USER_FUNCTION && static_cast<int>(node->value) == func_id) {
+      return -1.0;
+    }
+    return node->value;
+  }
+
+  static size_t hashFunction(const Tree& tree, int func_id) {
+    std::hash<double> hash_value;
+    size_t result = tree.getParamCnt(func_id);
+    std::vector<const Node*> stack{tree.getFuncNode(func_id)};
+
+    while (!stack.empty()) {
+      const Node* node = stack.back();
+      stack.pop_back();
+
+      if (node == nullptr) {
+        result = result * 31 + 1;
+        continue;
+      }
+      result = (result * 31 + node->type) * 31 + hash_value(getComparedValue(node, func_id));
+      result = result * 31 + node->sons.size();
+      stack.insert(stack.end(), node->sons.begin(), node->sons.end());
+    }
+    return result;
+  }
+
+  /*
+   * Numbers are told apart by sign as well, 0 and -0 print differently.
+   */
+  static bool isSameFunction(const Tree& tree, int first_id, int second_id) {
+    if (tree.getParamCnt(first_id) != tree.getParamCnt(second_id)) {
+      return false;
+    }
+    std::vector<std::pair<const Node*, const Node*>> stack{
+      {tree.getFuncNode(first_id), tree.getFuncNode(second_id)}
+    };
+
+    while (!stack.empty()) {
+      const Node* node_a = stack.back().first;
+      const Node* node_b = stack.back().second;
+      stack.pop_back();
+
+      if (node_a == nullptr || node_b == nullptr) {
+        if (node_a != node_b) {
+          return false;
+        }
+        continue;
+      }
+      if (node_a->type != node_b->type || node_a->sons.size() != node_b->sons.size() ||
+          getComparedValue(node_a, first_id) != getComparedValue(node_b, second_id) ||
+          (node_a->type == NUMBER && std::signbit(node_a->value) != std::signbit(node_b->value))) {
+        return false;
+      }
+      for (size_t son_id = 0; son_id < node_a->sons.size(); ++son_id) {
+        stack.push_back({node_a->sons[son_id], node_b->sons[son_id]});
+      }
+    }
+    return true;
+  }
+
+  /*
+   * Points every function equal to an earlier one at it and returns how
+   * many were found.
+   */
+  size_t findEqualFunctions(const Tree& tree, std::vector<int>& replacements) {
+    std::map<size_t, std::vector<int>> groups;
+    size_t found_cnt = 0;
+
+    for (int func_id = 0; func_id < tree.getMainId(); ++func_id) {
+      if (replacements[func_id] != func_id || tree.getFuncNode(func_id) == nullptr) {
+        continue;
+      }
+
+      std::vector<int>& group = groups[hashFunction(tree, func_id)];
+      for (int kept_id: group) {
+        if (isSameFunction(tree, kept_id, func_id)) {
+          replacements[func_id] = kept_id;
+          merged_.push_back({tree.getFuncName(func_id).str(), tree.getFuncName(kept_id).str()});
+          ++found_cnt;
+          break;
+        }
+      }
+      if (replacements[func_id] == func_id) {
+        group.push_back(func_id);
+      }
+    }
+    return found_cnt;
+  }
+
+ public:
+  size_t run(Tree& tree) {
+    merged_.clear();
+
+    std::vector<int> replacements(tree.getFuncCnt());
+    for (int func_id = 0; func_id < static_cast<int>(replacements.size()); ++func_id) {
+      replacements[func_id] = func_id;
+    }
+
+    while (findEqualFunctions(tree, replacements) != 0) {
+      CallRedirector redirector(tree, replacements);
+      redirector.walk(tree.getRoot());
+    }
+    if (merged_.empty()) {
+      return 0;
+    }
+
+    std::vector<bool> kept(replacements.size());
+    for (size_t func_id = 0; func_id < replacements.size(); ++func_id) {
+      kept[func_id] = replacements[func_id] == static_cast<int>(func_id);
+    }
+    std::vector<int> new_ids = tree.compactFunctions(kept);
+    FuncRenumberer renumberer(tree, new_ids);
+    renumberer.walk(tree.getRoot());
+    return merged_.size();
+  }
+
+  std::string getReport() const {
+    std::string report = "merged " + std::to_string(merged_.size()) + " functions";
+
+    for (size_t merged_id = 0; merged_id < merged_.size(); ++merged_id) {
+      report += (merged_id == 0 ? ": " : ", ") + merged_[merged_id].first + " into " + merged_[merged_id].second;
+    }
+    return report;
+  }
+};
+
+#endif //DED_PROG_LANG_FUNCTION_MERGING_H
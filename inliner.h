@@ -0,0 +1,458 @@
+//
+// Created by mike on 29.12.18.
+//
+
+#ifndef DED_PROG_LANG_INLINER_H
+#define DED_PROG_LANG_INLINER_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_analysis.h"
+#include "tree_profile.h"
+#include "tree_visitor.h"
+
+/*
+ * Inlines calls of small functions that cannot call themselves and whose
+ * only return is their last statement. A callee that only returns an
+ * expression takes the place of the call, its parameters replaced by the
+ * arguments. Otherwise arguments and locals become temporaries of the
+ * caller, set together with the statements of the callee right before the
+ * statement with the call, and the call reads the returned value from one
+ * more temporary. That moves the callee before whatever the statement
+ * evaluates ahead of the call, so it is only done when all of that is pure
+ * and reads no globals the callee may write, never for calls in while
+ * conditions, initialisers of locals or under && and ||. Arguments that
+ * are numbers, variables the callee cannot change, or pure expressions
+ * used at most once in place of the call go right where their parameter is
+ * read. With a profile callees the run never called stay calls and hot
+ * ones may be twice as big.
+ */
+class InlinePass : public Pass {
+ private:
+  static const size_t MAX_CALLEE_SIZE = 48;
+  static const size_t MAX_HOT_CALLEE_SIZE = 96;
+  static const size_t MAX_GROWTH = 512;
+  static const size_t MAX_FRAME_SIZE = 128;
+
+  struct CalleeInfo {
+    bool can_inline;
+    bool only_returns;
+    bool writes_globals;
+    size_t size;
+    std::set<int> written_params;
+    std::vector<size_t> param_uses;
+  };
+
+  /*
+   * A call met while walking a statement in order of evaluation: the place
+   * it hangs in and whether moving the callee before the statement is
+   * safe.
+   */
+  struct CallSite {
+    Node** slot;
+    bool can_hoist;
+  };
+
+  struct WalkFrame {
+    Node** slot;
+    size_t next_son;
+  };
+
+  Tree* tree_{nullptr};
+  const TreeProfile* profile_;
+  std::vector<bool> recursive_;
+  std::vector<size_t> growth_;
+  std::map<std::pair<int, int>, size_t> sites_;
+  size_t inlined_cnt_{0};
+  size_t in_place_cnt_{0};
+
+  static bool isBlock(const Node* node) {
+    return node->type == LOGIC && (node->value == CONDITION_MET || node->value == ELSE);
+  }
+
+  static bool isCall(const Node* node) {
+    return node->type == STANDART_FUNCTION && node->value == CALL;
+  }
+
+  static bool readsGlobals(const Node* root) {
+    std::vector<const Node*> stack{root};
+
+    while (!stack.empty()) {
+      const Node* node = stack.back();
+      stack.pop_back();
+
+      if (node->type == VARIABLE) {
+        return true;
+      }
+      for (const Node* son: node->sons) {
+        stack.push_back(son);
+      }
+    }
+    return false;
+  }
+
+  size_t getMaxCalleeSize(int callee_id) const {
+    if (profile_ == nullptr) {
+      return MAX_CALLEE_SIZE;
+    }
+
+    std::string name = tree_->getFuncName(callee_id).str();
+    if (profile_->isColdFunction(name)) {
+      return 0;
+    }
+    if (profile_->isHotFunction(name)) {
+      return MAX_HOT_CALLEE_SIZE;
+    }
+    return MAX_CALLEE_SIZE;
+  }
+
+  CalleeInfo analyzeCallee(int callee_id) const {
+    CalleeInfo info{false, false, false, 0, {}, {}};
+    Node* func_node = tree_->getFuncNode(callee_id);
+
+    if (callee_id == tree_->getMainId() || recursive_[callee_id] || func_node == nullptr ||
+        func_node->sons.size() < 2) {
+      return info;
+    }
+    Node* last = func_node->sons.back();
+    if (last->type != RETURN || last->sons.size() != 1) {
+      return info;
+    }
+
+    info.size = countNodes(*tree_, func_node);
+    info.param_uses.assign(tree_->getParamCnt(callee_id), 0);
+    std::vector<const Node*> stack{func_node};
+    while (!stack.empty()) {
+      const Node* node = stack.back();
+      stack.pop_back();
+
+      if (node->type == RETURN && node != last) {
+        return info;
+      }
+      if (node->type == PARAM) {
+        ++info.param_uses[static_cast<int>(node->value)];
+      }
+      for (const Node* son: node->sons) {
+        stack.push_back(son);
+      }
+    }
+
+    AssignedVarsFinder assigned(*tree_);
+    assigned.walk(func_node, callee_id);
+    info.writes_globals = hasCalls(func_node);
+    for (const VarKey& key: assigned.getAssigned()) {
+      if (key.func_id == -1) {
+        info.writes_globals = true;
+      } else if (key.slot < tree_->getParamCnt(callee_id)) {
+        info.written_params.insert(key.slot);
+      }
+    }
+
+    info.can_inline = info.size <= getMaxCalleeSize(callee_id);
+    info.only_returns = func_node->sons.size() == 2 && func_node->sons[0]->sons.empty();
+    return info;
+  }
+
+  static bool canSubstitute(const CalleeInfo& info, int param_id, const Node* arg, bool in_place) {
+    if (info.written_params.count(param_id) != 0) {
+      return false;
+    }
+    if (arg->type == NUMBER || arg->type == LOCAL_VARIABLE || arg->type == PARAM) {
+      return true;
+    }
+    if (arg->type == VARIABLE) {
+      return !info.writes_globals;
+    }
+    return in_place && info.param_uses[param_id] <= 1 && isPureExpression(arg) &&
+      (!info.writes_globals || !readsGlobals(arg));
+  }
+
+  bool canInPlace(const CalleeInfo& info, const Node* call) const {
+    if (!info.only_returns) {
+      return false;
+    }
+    for (size_t arg_id = 1; arg_id < call->sons.size(); ++arg_id) {
+      if (!canSubstitute(info, static_cast<int>(arg_id) - 1, call->sons[arg_id], true)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*
+   * True when nothing evaluated before the call in the statement can tell
+   * that the callee ran earlier: the earlier sons of every ancestor and
+   * the earlier roots are pure, and read no globals if the callee may
+   * write them.
+   */
+  static bool isSafeToHoist(const std::vector<WalkFrame>& frames, const std::vector<Node**>& roots,
+                            size_t root_id, bool writes_globals) {
+    std::vector<const Node*> before;
+
+    for (size_t prev_root = 0; prev_root < root_id; ++prev_root) {
+      before.push_back(*roots[prev_root]);
+    }
+    for (size_t frame_id = 0; frame_id + 1 < frames.size(); ++frame_id) {
+      const Node* node = *frames[frame_id].slot;
+
+      if (node->type == OPERATOR && (node->value == BOOL_AND || node->value == BOOL_OR)) {
+        return false;
+      }
+      for (size_t son_id = 0; son_id + 1 < frames[frame_id].next_son; ++son_id) {
+        before.push_back(node->sons[son_id]);
+      }
+    }
+    for (const Node* node: before) {
+      if (!isPureExpression(node) || (writes_globals && readsGlobals(node))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*
+   * Calls of the expressions of a statement in order of evaluation: the
+   * arguments of a call are evaluated before it.
+   */
+  std::vector<CallSite> findCalls(const std::vector<Node**>& roots, bool can_hoist) const {
+    std::vector<CallSite> calls;
+
+    for (size_t root_id = 0; root_id < roots.size(); ++root_id) {
+      std::vector<WalkFrame> frames{{roots[root_id], 0}};
+
+      while (!frames.empty()) {
+        WalkFrame& frame = frames.back();
+        Node* node = *frame.slot;
+
+        if (frame.next_son < node->sons.size()) {
+          frames.push_back({&node->sons[frame.next_son++], 0});
+          continue;
+        }
+        if (isCall(node)) {
+          bool writes_globals = analyzeCallee(static_cast<int>(node->sons[0]->value)).writes_globals;
+          calls.push_back({frame.slot, can_hoist && isSafeToHoist(frames, roots, root_id, writes_globals)});
+        }
+        frames.pop_back();
+      }
+    }
+    return calls;
+  }
+
+  /*
+   * Copies a tree of the callee, putting the values of the parameters and
+   * the temporaries for the locals in their places.
+   */
+  Node* remap(const Node* root, const std::vector<Node*>& param_values, const std::vector<int>& local_temps) {
+    auto map_node = [&](const Node* node) -> Node* {
+      if (node->type == PARAM) {
+        return copyTree(*tree_, param_values[static_cast<int>(node->value)]);
+      }
+      if (node->type == LOCAL_VARIABLE) {
+        return tree_->newNode(LOCAL_VARIABLE, local_temps[static_cast<int>(node->value)]);
+      }
+      return tree_->newNode(node->type, node->value);
+    };
+
+    Node* root_copy = map_node(root);
+    std::vector<std::pair<const Node*, Node*>> stack{{root, root_copy}};
+    while (!stack.empty()) {
+      const Node* node = stack.back().first;
+      Node* node_copy = stack.back().second;
+      stack.pop_back();
+
+      if (node->type == PARAM || node->type == LOCAL_VARIABLE) {
+        continue;
+      }
+      for (const Node* son: node->sons) {
+        Node* son_copy = map_node(son);
+
+        node_copy->sons.push_back(son_copy);
+        stack.push_back({son, son_copy});
+      }
+    }
+    return root_copy;
+  }
+
+  Node* assignTemp(int temp, Node* value) {
+    return tree_->newNode(OPERATOR, EQUAL, {tree_->newNode(LOCAL_VARIABLE, temp), value});
+  }
+
+  /*
+   * Replaces the call by the body of the callee. Returns the statements
+   * to put before the statement with the call; the statement itself is
+   * set to nullptr when nothing of it is left.
+   */
+  std::vector<Node*> expandCall(Node** slot, bool is_statement, bool in_place, const CalleeInfo& info,
+                                int func_id) {
+    Node* call = *slot;
+    int callee_id = static_cast<int>(call->sons[0]->value);
+    Node* func_node = tree_->getFuncNode(callee_id);
+    std::vector<Node*> hoisted;
+    std::vector<Node*> param_values;
+    std::vector<int> local_temps;
+
+    for (size_t arg_id = 1; arg_id < call->sons.size(); ++arg_id) {
+      Node* arg = call->sons[arg_id];
+
+      if (canSubstitute(info, static_cast<int>(arg_id) - 1, arg, in_place)) {
+        param_values.push_back(arg);
+        continue;
+      }
+      int temp = tree_->addTemporary("inl", func_id);
+      hoisted.push_back(assignTemp(temp, arg));
+      param_values.push_back(tree_->newNode(LOCAL_VARIABLE, temp));
+    }
+    for (size_t var_id = 0; var_id < func_node->sons[0]->sons.size(); ++var_id) {
+      local_temps.push_back(tree_->addTemporary("inl", func_id));
+    }
+    for (size_t var_id = 0; var_id < local_temps.size(); ++var_id) {
+      hoisted.push_back(assignTemp(local_temps[var_id], remap(func_node->sons[0]->sons[var_id], param_values,
+                                                              local_temps)));
+    }
+    for (size_t son_id = 1; son_id + 1 < func_node->sons.size(); ++son_id) {
+      hoisted.push_back(remap(func_node->sons[son_id], param_values, local_temps));
+    }
+
+    Node* value = remap(func_node->sons.back()->sons[0], param_values, local_temps);
+    if (is_statement) {
+      *slot = (isCall(value) ? value : nullptr);
+      if (*slot == nullptr && !isPureExpression(value)) {
+        hoisted.push_back(assignTemp(tree_->addTemporary("inl", func_id), value));
+      }
+    } else if (in_place) {
+      *slot = value;
+    } else {
+      int temp = tree_->addTemporary("inl", func_id);
+      hoisted.push_back(assignTemp(temp, value));
+      *slot = tree_->newNode(LOCAL_VARIABLE, temp);
+    }
+
+    ++inlined_cnt_;
+    in_place_cnt_ += in_place;
+    ++sites_[{func_id, callee_id}];
+    return hoisted;
+  }
+
+  /*
+   * Inlines the first call of the statement that may be inlined. The
+   * initialisers of locals run on entry, so nothing can go before them and
+   * calls there are only replaced in place.
+   */
+  bool inlineFirst(Node* block, size_t pos, int func_id) {
+    Node* statement = block->sons[pos];
+    std::vector<Node**> roots;
+    bool can_hoist = true;
+
+    if (statement->type == VAR_INIT) {
+      for (Node*& son: statement->sons) {
+        roots.push_back(&son);
+      }
+      can_hoist = false;
+    } else if (statement->type == LOGIC && (statement->value == IF || statement->value == WHILE)) {
+      roots.push_back(&statement->sons[0]->sons[0]);
+      can_hoist = statement->value == IF;
+    } else if (isCall(statement)) {
+      roots.push_back(&block->sons[pos]);
+    } else if (!isBlock(statement)) {
+      bool skip_target = statement->type == OPERATOR && statement->value == EQUAL;
+      for (size_t son_id = (skip_target ? 1 : 0); son_id < statement->sons.size(); ++son_id) {
+        roots.push_back(&statement->sons[son_id]);
+      }
+    }
+
+    for (const CallSite& site: findCalls(roots, can_hoist)) {
+      int callee_id = static_cast<int>((*site.slot)->sons[0]->value);
+      CalleeInfo info = analyzeCallee(callee_id);
+      size_t new_slots = tree_->getParamCnt(callee_id) + tree_->getVarCnt(callee_id) + 1;
+
+      if (!info.can_inline || growth_[func_id] + info.size > MAX_GROWTH ||
+          tree_->getParamCnt(func_id) + tree_->getVarCnt(func_id) + new_slots > MAX_FRAME_SIZE) {
+        continue;
+      }
+
+      bool in_place = canInPlace(info, *site.slot);
+      if (!in_place && !site.can_hoist) {
+        continue;
+      }
+
+      bool is_statement = site.slot == &block->sons[pos];
+      std::vector<Node*> hoisted = expandCall(site.slot, is_statement, in_place, info, func_id);
+      growth_[func_id] += info.size;
+      if (block->sons[pos] == nullptr) {
+        block->sons.erase(block->sons.begin() + pos);
+      }
+      block->sons.insert(block->sons.begin() + pos, hoisted.begin(), hoisted.end());
+      return true;
+    }
+    return false;
+  }
+
+  void inlineFunction(Node* func_node, int func_id) {
+    std::vector<Node*> blocks{func_node};
+
+    while (!blocks.empty()) {
+      Node* block = blocks.back();
+      blocks.pop_back();
+
+      size_t pos = 0;
+      while (pos < block->sons.size()) {
+        if (inlineFirst(block, pos, func_id)) {
+          continue;
+        }
+
+        Node* statement = block->sons[pos++];
+        if (isBlock(statement)) {
+          blocks.push_back(statement);
+        } else if (statement->type == LOGIC && (statement->value == IF || statement->value == WHILE)) {
+          blocks.insert(blocks.end(), statement->sons.begin() + 1, statement->sons.end());
+        }
+      }
+    }
+  }
+
+ public:
+  explicit InlinePass(const TreeProfile* profile = nullptr): profile_(profile) {}
+
+  size_t run(Tree& tree) {
+    tree_ = &tree;
+    sites_.clear();
+    inlined_cnt_ = 0;
+    in_place_cnt_ = 0;
+    growth_.assign(tree.getFuncCnt(), 0);
+
+    CallGraphFinder call_graph(tree);
+    call_graph.walk(tree.getRoot());
+    recursive_.assign(tree.getFuncCnt(), false);
+    for (int func_id = 0; func_id < static_cast<int>(tree.getFuncCnt()); ++func_id) {
+      recursive_[func_id] = call_graph.isRecursive(func_id);
+    }
+
+    for (int func_id = 0; func_id < static_cast<int>(tree.getFuncCnt()); ++func_id) {
+      Node* func_node = tree.getFuncNode(func_id);
+      if (func_node != nullptr && !func_node->sons.empty()) {
+        inlineFunction(func_node, func_id);
+      }
+    }
+    return inlined_cnt_;
+  }
+
+  std::string getReport() const {
+    std::string report = "inlined " + std::to_string(inlined_cnt_) + " call sites, " +
+      std::to_string(in_place_cnt_) + " in place";
+
+    for (const auto& site: sites_) {
+      report += (site.first == sites_.begin()->first ? ": " : ", ");
+      report += tree_->getFuncName(site.first.second).str() + " into " + tree_->getFuncName(site.first.first).str() +
+        " x" + std::to_string(site.second);
+    }
+    return report;
+  }
+};
+
+#endif //DED_PROG_LANG_INLINER_H
@@ -0,0 +1,209 @@
+//
+// Created by mike on 27.12.18.
+//
+
+#ifndef DED_PROG_LANG_IR_H
+#define DED_PROG_LANG_IR_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "tree.h"
+
+/*
+ * Mid level representation: every function is a control flow graph of
+ * basic blocks in SSA form. Parameters and locals live only as SSA values,
+ * globals stay in memory and are read and written by explicit loads and
+ * stores, since any call may change them.
+ */
+enum IrOpcode {
+  IR_CONST,
+  IR_PARAM,
+  IR_LOAD_GLOBAL,
+  IR_STORE_GLOBAL,
+  IR_BINARY,
+  IR_UNARY,
+  IR_STD,
+  IR_CALL,
+  IR_IN,
+  IR_OUT,
+  IR_PHI,
+  IR_JUMP,
+  IR_BRANCH,
+  IR_RETURN,
+};
+
+/*
+ * One instruction, identified by its index in the function; the index is
+ * also the name of the value it defines. arg is the operator, standart
+ * function, global slot, parameter or callee id, depending on the opcode.
+ * Phi operands follow the order of the block predecessors.
+ */
+struct IrInstr {
+  IrOpcode opcode;
+  int arg;
+  double number;
+  int block;
+  std::vector<int> operands;
+  bool removed;
+};
+
+/*
+ * Phis come first and the terminator last. A branch goes to succs[0] when
+ * its condition is not zero and to succs[1] otherwise.
+ */
+struct IrBlock {
+  std::vector<int> instrs;
+  std::vector<int> preds;
+  std::vector<int> succs;
+};
+
+class IrFunction {
+ public:
+  enum { NO_BLOCK = -1 };
+
+  std::string name;
+  int func_id{0};
+  bool is_main{false};
+  size_t param_cnt{0};
+  std::vector<IrInstr> instrs;
+  std::vector<IrBlock> blocks;
+
+  static bool isTerminator(IrOpcode opcode) {
+    return opcode == IR_JUMP || opcode == IR_BRANCH || opcode == IR_RETURN;
+  }
+
+  bool hasValue(int instr_id) const {
+    IrOpcode opcode = instrs[instr_id].opcode;
+    return opcode != IR_STORE_GLOBAL && opcode != IR_OUT && !isTerminator(opcode);
+  }
+
+  int addBlock() {
+    blocks.emplace_back();
+    return static_cast<int>(blocks.size()) - 1;
+  }
+
+  int append(int block, IrOpcode opcode, int arg, const std::vector<int>& operands = {}, double number = 0.0) {
+    instrs.push_back({opcode, arg, number, block, operands, false});
+    blocks[block].instrs.push_back(static_cast<int>(instrs.size()) - 1);
+    return static_cast<int>(instrs.size()) - 1;
+  }
+
+  int addPhi(int block) {
+    std::vector<int>& block_instrs = blocks[block].instrs;
+    size_t phi_cnt = 0;
+
+    while (phi_cnt < block_instrs.size() && instrs[block_instrs[phi_cnt]].opcode == IR_PHI) {
+      ++phi_cnt;
+    }
+    instrs.push_back({IR_PHI, 0, 0.0, block, {}, false});
+    block_instrs.insert(block_instrs.begin() + phi_cnt, static_cast<int>(instrs.size()) - 1);
+    return static_cast<int>(instrs.size()) - 1;
+  }
+
+  void addEdge(int from, int to) {
+    blocks[from].succs.push_back(to);
+    blocks[to].preds.push_back(from);
+  }
+
+  /*
+   * Puts an empty block on every edge that leaves a block with several
+   * successors and enters a block with several predecessors, so that
+   * copies for phis always have a block of their own to go to.
+   */
+  size_t splitCriticalEdges() {
+    size_t split_cnt = 0;
+
+    for (int from = 0; from < static_cast<int>(blocks.size()); ++from) {
+      if (blocks[from].succs.size() < 2) {
+        continue;
+      }
+      for (size_t succ_pos = 0; succ_pos < blocks[from].succs.size(); ++succ_pos) {
+        int to = blocks[from].succs[succ_pos];
+        if (blocks[to].preds.size() < 2) {
+          continue;
+        }
+
+        int middle = addBlock();
+        append(middle, IR_JUMP, 0);
+        blocks[middle].preds.push_back(from);
+        blocks[middle].succs.push_back(to);
+        blocks[from].succs[succ_pos] = middle;
+        for (int& pred: blocks[to].preds) {
+          if (pred == from) {
+            pred = middle;
+            break;
+          }
+        }
+        ++split_cnt;
+      }
+    }
+    return split_cnt;
+  }
+
+  void print(FILE* file) const {
+    fprintf(file, "function %s, %zu params\n", name.c_str(), param_cnt);
+    for (size_t block = 0; block < blocks.size(); ++block) {
+      fprintf(file, "b%zu:", block);
+      if (!blocks[block].preds.empty()) {
+        fprintf(file, " ; preds");
+        for (int pred: blocks[block].preds) {
+          fprintf(file, " b%d", pred);
+        }
+      }
+      fprintf(file, "\n");
+      for (int instr_id: blocks[block].instrs) {
+        printInstr(file, instr_id);
+      }
+    }
+  }
+
+ private:
+  void printInstr(FILE* file, int instr_id) const {
+    const IrInstr& instr = instrs[instr_id];
+    static const char* names[] = {"const", "param", "load", "store", "binary", "unary", "std", "call", "in",
+                                  "out", "phi", "jump", "branch", "return"};
+
+    fprintf(file, "  ");
+    if (hasValue(instr_id)) {
+      fprintf(file, "v%d = ", instr_id);
+    }
+    fprintf(file, "%s", names[instr.opcode]);
+    switch (instr.opcode) {
+      case IR_CONST:
+        fprintf(file, " %lg", instr.number);
+        break;
+      case IR_PARAM:
+      case IR_LOAD_GLOBAL:
+      case IR_STORE_GLOBAL:
+      case IR_BINARY:
+      case IR_UNARY:
+      case IR_STD:
+      case IR_CALL:
+        fprintf(file, " #%d", instr.arg);
+        break;
+      default:
+        break;
+    }
+    for (int operand: instr.operands) {
+      fprintf(file, " v%d", operand);
+    }
+    for (int succ: blocks[instr.block].succs) {
+      if (isTerminator(instr.opcode)) {
+        fprintf(file, " b%d", succ);
+      }
+    }
+    fprintf(file, "\n");
+  }
+};
+
+/*
+ * Every function of a program; main is the last one, as in the tree.
+ */
+struct IrProgram {
+  size_t global_cnt;
+  std::vector<IrFunction> functions;
+};
+
+#endif //DED_PROG_LANG_IR_H
@@ -0,0 +1,248 @@
+//
+// Created by mike on 27.12.18.
+//
+
+#ifndef DED_PROG_LANG_IR_ANALYSIS_H
+#define DED_PROG_LANG_IR_ANALYSIS_H
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "ir.h"
+
+/*
+ * Reverse postorder of the blocks reachable from the entry.
+ */
+std::vector<int> getReversePostorder(const IrFunction& func) {
+  std::vector<int> order;
+  std::vector<bool> visited(func.blocks.size(), false);
+  std::vector<std::pair<int, size_t>> stack{{0, 0}};
+
+  if (func.blocks.empty()) {
+    return order;
+  }
+  visited[0] = true;
+  while (!stack.empty()) {
+    int block = stack.back().first;
+    size_t& next_succ = stack.back().second;
+
+    if (next_succ == func.blocks[block].succs.size()) {
+      order.push_back(block);
+      stack.pop_back();
+      continue;
+    }
+    int succ = func.blocks[block].succs[next_succ++];
+    if (!visited[succ]) {
+      visited[succ] = true;
+      stack.push_back({succ, 0});
+    }
+  }
+  return std::vector<int>(order.rbegin(), order.rend());
+}
+
+/*
+ * Immediate dominators by the iterative algorithm of Cooper, Harvey and
+ * Kennedy ("A Simple, Fast Dominance Algorithm").
+ */
+class IrDominators {
+ private:
+  std::vector<int> rpo_;
+  std::vector<int> rpo_pos_;
+  std::vector<int> idom_;
+  std::vector<std::vector<int>> children_;
+
+  int intersect(int block_a, int block_b) const {
+    while (block_a != block_b) {
+      while (rpo_pos_[block_a] > rpo_pos_[block_b]) {
+        block_a = idom_[block_a];
+      }
+      while (rpo_pos_[block_b] > rpo_pos_[block_a]) {
+        block_b = idom_[block_b];
+      }
+    }
+    return block_a;
+  }
+
+ public:
+  explicit IrDominators(const IrFunction& func):
+    rpo_(::getReversePostorder(func)), rpo_pos_(func.blocks.size(), -1),
+    idom_(func.blocks.size(), IrFunction::NO_BLOCK), children_(func.blocks.size()) {
+    if (rpo_.empty()) {
+      return;
+    }
+    for (size_t pos = 0; pos < rpo_.size(); ++pos) {
+      rpo_pos_[rpo_[pos]] = static_cast<int>(pos);
+    }
+
+    idom_[rpo_[0]] = rpo_[0];
+    for (bool changed = true; changed; ) {
+      changed = false;
+      for (size_t pos = 1; pos < rpo_.size(); ++pos) {
+        int block = rpo_[pos];
+        int new_idom = IrFunction::NO_BLOCK;
+
+        for (int pred: func.blocks[block].preds) {
+          if (idom_[pred] == IrFunction::NO_BLOCK) {
+            continue;
+          }
+          new_idom = (new_idom == IrFunction::NO_BLOCK ? pred : intersect(pred, new_idom));
+        }
+        if (idom_[block] != new_idom) {
+          idom_[block] = new_idom;
+          changed = true;
+        }
+      }
+    }
+    for (size_t pos = 1; pos < rpo_.size(); ++pos) {
+      children_[idom_[rpo_[pos]]].push_back(rpo_[pos]);
+    }
+  }
+
+  const std::vector<int>& getReversePostorder() const {
+    return rpo_;
+  }
+
+  int getIdom(int block) const {
+    return idom_[block];
+  }
+
+  const std::vector<int>& getChildren(int block) const {
+    return children_[block];
+  }
+
+  bool dominates(int block_a, int block_b) const {
+    while (block_b != block_a && block_b != rpo_[0]) {
+      block_b = idom_[block_b];
+    }
+    return block_a == block_b;
+  }
+
+  /*
+   * Blocks in preorder of the dominator tree: every value is defined
+   * before the blocks where it is used are listed.
+   */
+  std::vector<int> getPreorder() const {
+    std::vector<int> order;
+    std::vector<int> stack;
+
+    if (!rpo_.empty()) {
+      stack.push_back(rpo_[0]);
+    }
+    while (!stack.empty()) {
+      int block = stack.back();
+      stack.pop_back();
+
+      order.push_back(block);
+      for (auto child = children_[block].rbegin(); child != children_[block].rend(); ++child) {
+        stack.push_back(*child);
+      }
+    }
+    return order;
+  }
+};
+
+/*
+ * Users of every value.
+ */
+class IrDefUse {
+ private:
+  std::vector<std::vector<int>> users_;
+
+ public:
+  explicit IrDefUse(const IrFunction& func): users_(func.instrs.size()) {
+    for (const IrBlock& block: func.blocks) {
+      for (int instr_id: block.instrs) {
+        for (int operand: func.instrs[instr_id].operands) {
+          users_[operand].push_back(instr_id);
+        }
+      }
+    }
+  }
+
+  const std::vector<int>& getUsers(int value) const {
+    return users_[value];
+  }
+
+  size_t getUseCnt(int value) const {
+    return users_[value].size();
+  }
+};
+
+/*
+ * Values live at the borders of blocks. A phi uses its operands at the
+ * end of the matching predecessors and defines its value at the start of
+ * its own block, so phis are live in, their operands are live out.
+ */
+class IrLiveness {
+ private:
+  std::vector<std::set<int>> live_in_;
+  std::vector<std::set<int>> live_out_;
+
+  std::set<int> liveOutOf(const IrFunction& func, int block) const {
+    std::set<int> live;
+
+    for (int succ: func.blocks[block].succs) {
+      size_t pred_pos = 0;
+      while (func.blocks[succ].preds[pred_pos] != block) {
+        ++pred_pos;
+      }
+      for (int value: live_in_[succ]) {
+        if (func.instrs[value].opcode != IR_PHI || func.instrs[value].block != succ) {
+          live.insert(value);
+        }
+      }
+      for (int instr_id: func.blocks[succ].instrs) {
+        if (func.instrs[instr_id].opcode != IR_PHI) {
+          break;
+        }
+        live.insert(func.instrs[instr_id].operands[pred_pos]);
+      }
+    }
+    return live;
+  }
+
+ public:
+  explicit IrLiveness(const IrFunction& func):
+    live_in_(func.blocks.size()), live_out_(func.blocks.size()) {
+    std::vector<int> rpo = getReversePostorder(func);
+
+    for (bool changed = true; changed; ) {
+      changed = false;
+      for (auto iter = rpo.rbegin(); iter != rpo.rend(); ++iter) {
+        int block = *iter;
+        std::set<int> live = liveOutOf(func, block);
+
+        for (auto instr = func.blocks[block].instrs.rbegin(); instr != func.blocks[block].instrs.rend(); ++instr) {
+          const IrInstr& instr_data = func.instrs[*instr];
+
+          if (instr_data.opcode == IR_PHI) {
+            live.insert(*instr);
+            continue;
+          }
+          live.erase(*instr);
+          for (int operand: instr_data.operands) {
+            live.insert(operand);
+          }
+        }
+        if (live != live_in_[block]) {
+          live_in_[block] = std::move(live);
+          changed = true;
+        }
+      }
+    }
+    for (int block: rpo) {
+      live_out_[block] = liveOutOf(func, block);
+    }
+  }
+
+  const std::set<int>& getLiveIn(int block) const {
+    return live_in_[block];
+  }
+
+  const std::set<int>& getLiveOut(int block) const {
+    return live_out_[block];
+  }
+};
+
+#endif //DED_PROG_LANG_IR_ANALYSIS_H
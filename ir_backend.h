@@ -0,0 +1,418 @@
+//
+// Created by mike on 28.12.18.
+//
+
+#ifndef DED_PROG_LANG_IR_BACKEND_H
+#define DED_PROG_LANG_IR_BACKEND_H
+
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "code_generator.h"
+#include "exception.h"
+#include "ir.h"
+#include "ir_analysis.h"
+
+/*
+ * Turns a program in SSA form into assembler of some machine.
+ */
+class IrBackend {
+ public:
+  virtual ~IrBackend() {}
+
+  virtual void printProgram(IrProgram& program, FILE* asm_file) = 0;
+};
+
+/*
+ * Code for the stack machine. A value whose only use is the next thing
+ * that consumes the operand stack stays on it, as in code made from the
+ * tree; the others get a frame slot after the parameters. Slots are shared
+ * by values that are never live at once: blocks are colored in dominator
+ * tree order, which is optimal for SSA. Phis are left through copies at
+ * the end of predecessors, critical edges being split first: all incoming
+ * values are pushed, then popped into the phi slots, so copies never
+ * overwrite each other.
+ */
+class StackBackend : public IrBackend {
+ private:
+  FILE* asm_file_{nullptr};
+  const IrFunction* func_{nullptr};
+  std::vector<bool> on_stack_;
+  std::vector<std::vector<int>> pre_pushes_;
+  std::vector<std::vector<int>> own_pushes_;
+  std::vector<int> slots_;
+  size_t frame_size_{0};
+
+  void emit(const char* format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(asm_file_, format, args);
+    va_end(args);
+  }
+
+  std::string blockLabel(int block) const {
+    return "bb_" + std::to_string(func_->func_id) + "_" + std::to_string(block);
+  }
+
+  /*
+   * Constants and parameters are pushed where they are used; parameter
+   * slots are never written.
+   */
+  bool isRematerialized(int value) const {
+    return func_->instrs[value].opcode == IR_CONST || func_->instrs[value].opcode == IR_PARAM;
+  }
+
+  bool needsSlot(const IrDefUse& def_use, int value) const {
+    return func_->hasValue(value) && !on_stack_[value] && !isRematerialized(value) &&
+      def_use.getUseCnt(value) != 0;
+  }
+
+  bool canStay(const IrDefUse& def_use, int value) const {
+    return func_->hasValue(value) && func_->instrs[value].opcode != IR_PHI && def_use.getUseCnt(value) == 1;
+  }
+
+  /*
+   * An operand stays on the stack when it is computed right before the
+   * operands after it that stay, or right before the user if none does.
+   * The other operands are pushed from their slots at the start of the
+   * computation of the next operand that stays, or by the user itself.
+   */
+  void placeOnStack(const IrDefUse& def_use) {
+    for (const IrBlock& block: func_->blocks) {
+      std::vector<int> group_start(block.instrs.size());
+
+      for (int pos = 0; pos < static_cast<int>(block.instrs.size()); ++pos) {
+        int instr_id = block.instrs[pos];
+        const std::vector<int>& operands = func_->instrs[instr_id].operands;
+        int prev_pos = pos - 1;
+        std::vector<int>* pushes = &own_pushes_[instr_id];
+
+        group_start[pos] = pos;
+        if (func_->instrs[instr_id].opcode == IR_PHI) {
+          continue;
+        }
+        for (auto operand = operands.rbegin(); operand != operands.rend(); ++operand) {
+          if (prev_pos >= 0 && block.instrs[prev_pos] == *operand && canStay(def_use, *operand)) {
+            on_stack_[*operand] = true;
+            prev_pos = group_start[prev_pos] - 1;
+            pushes = &pre_pushes_[block.instrs[prev_pos + 1]];
+            continue;
+          }
+          pushes->insert(pushes->begin(), *operand);
+        }
+        group_start[pos] = prev_pos + 1;
+      }
+    }
+  }
+
+  static int takeSlot(std::vector<bool>& busy) {
+    for (size_t slot = 0; slot < busy.size(); ++slot) {
+      if (!busy[slot]) {
+        busy[slot] = true;
+        return static_cast<int>(slot);
+      }
+    }
+    busy.push_back(true);
+    return static_cast<int>(busy.size()) - 1;
+  }
+
+  void assignSlots(const IrDefUse& def_use, const IrDominators& dominators, const IrLiveness& liveness) {
+    size_t slot_cnt = 0;
+    std::vector<size_t> last_use(func_->instrs.size(), 0);
+
+    for (int block: dominators.getPreorder()) {
+      const std::vector<int>& instrs = func_->blocks[block].instrs;
+      std::vector<bool> busy(slot_cnt, false);
+
+      for (int value: liveness.getLiveIn(block)) {
+        if (slots_[value] != -1) {
+          busy[slots_[value]] = true;
+        }
+      }
+      for (size_t pos = 0; pos < instrs.size(); ++pos) {
+        for (int operand: func_->instrs[instrs[pos]].operands) {
+          last_use[operand] = pos;
+        }
+      }
+
+      for (size_t pos = 0; pos < instrs.size(); ++pos) {
+        int instr_id = instrs[pos];
+
+        if (func_->instrs[instr_id].opcode != IR_PHI) {
+          for (int operand: func_->instrs[instr_id].operands) {
+            if (slots_[operand] != -1 && last_use[operand] == pos && liveness.getLiveOut(block).count(operand) == 0) {
+              busy[slots_[operand]] = false;
+            }
+          }
+        }
+        if (needsSlot(def_use, instr_id)) {
+          slots_[instr_id] = takeSlot(busy);
+        }
+      }
+      slot_cnt = std::max(slot_cnt, busy.size());
+    }
+    frame_size_ = func_->param_cnt + slot_cnt;
+  }
+
+  void pushValue(int value) {
+    if (func_->instrs[value].opcode == IR_CONST) {
+      emit("  push %s\n", numberText(func_->instrs[value].number).c_str());
+      return;
+    }
+    if (func_->instrs[value].opcode == IR_PARAM) {
+      emit("  push [rcx+%d]\n", func_->instrs[value].arg);
+      return;
+    }
+    if (slots_[value] == -1) {
+      throw IncorrectArgumentException("value v" + std::to_string(value) + " of " + func_->name + " has no slot",
+                                       __PRETTY_FUNCTION__);
+    }
+    emit("  push [rcx+%zu]\n", func_->param_cnt + slots_[value]);
+  }
+
+  /*
+   * A call whose value is returned right away leaves the frame and jumps,
+   * as in code made from the tree.
+   */
+  bool isTailCall(int instr_id) const {
+    const IrInstr& instr = func_->instrs[instr_id];
+    const std::vector<int>& instrs = func_->blocks[instr.block].instrs;
+
+    if (func_->is_main || instr.opcode != IR_CALL || !on_stack_[instr_id] || instrs.size() < 2 ||
+        instrs[instrs.size() - 2] != instr_id) {
+      return false;
+    }
+    const IrInstr& last = func_->instrs[instrs.back()];
+    return last.opcode == IR_RETURN && last.operands.size() == 1 && last.operands[0] == instr_id;
+  }
+
+  /*
+   * A comparison whose only use is the branch right after it is not
+   * computed: the branch jumps on its operands.
+   */
+  bool isFusedCompare(int instr_id) const {
+    const IrInstr& instr = func_->instrs[instr_id];
+    const std::vector<int>& instrs = func_->blocks[instr.block].instrs;
+
+    if (instr.opcode != IR_BINARY || comparisonJump(instr.arg, true) == nullptr || !on_stack_[instr_id]) {
+      return false;
+    }
+    return instrs.size() >= 2 && instrs[instrs.size() - 2] == instr_id &&
+      func_->instrs[instrs.back()].opcode == IR_BRANCH;
+  }
+
+  /*
+   * nullptr when the fused comparison is ordered and has no jump for when
+   * it does not hold.
+   */
+  const char* branchJump(int cond, bool when_true) const {
+    if (isFusedCompare(cond)) {
+      return comparisonJump(func_->instrs[cond].arg, when_true);
+    }
+    return when_true ? "jne" : "je";
+  }
+
+  void printPhiCopies(int block) {
+    const IrBlock& block_data = func_->blocks[block];
+    if (block_data.succs.size() != 1) {
+      return;
+    }
+
+    int succ = block_data.succs[0];
+    size_t pred_pos = 0;
+    std::vector<int> phis;
+
+    while (func_->blocks[succ].preds[pred_pos] != block) {
+      ++pred_pos;
+    }
+    for (int instr_id: func_->blocks[succ].instrs) {
+      if (func_->instrs[instr_id].opcode != IR_PHI) {
+        break;
+      }
+      if (slots_[instr_id] != -1) {
+        pushValue(func_->instrs[instr_id].operands[pred_pos]);
+        phis.push_back(instr_id);
+      }
+    }
+    for (auto phi = phis.rbegin(); phi != phis.rend(); ++phi) {
+      emit("  pop [rcx+%zu]\n", func_->param_cnt + slots_[*phi]);
+    }
+  }
+
+  void printTerminator(const IrInstr& instr, int next_block) {
+    const std::vector<int>& succs = func_->blocks[instr.block].succs;
+
+    switch (instr.opcode) {
+      case IR_JUMP:
+        printPhiCopies(instr.block);
+        if (succs[0] != next_block) {
+          emit("  jmp %s\n", blockLabel(succs[0]).c_str());
+        }
+        break;
+      case IR_BRANCH:
+        if (!isFusedCompare(instr.operands[0])) {
+          emit("  push 0\n");
+        }
+        if (succs[1] == next_block || branchJump(instr.operands[0], false) == nullptr) {
+          emit("  %s %s\n", branchJump(instr.operands[0], true), blockLabel(succs[0]).c_str());
+          if (succs[1] != next_block) {
+            emit("  jmp %s\n", blockLabel(succs[1]).c_str());
+          }
+          break;
+        }
+        emit("  %s %s\n", branchJump(instr.operands[0], false), blockLabel(succs[1]).c_str());
+        if (succs[0] != next_block) {
+          emit("  jmp %s\n", blockLabel(succs[0]).c_str());
+        }
+        break;
+      case IR_RETURN:
+        if (instr.operands.size() == 1 && isTailCall(instr.operands[0])) {
+          break;
+        }
+        emit(func_->is_main ? "  end\n" : "  leave\n  ret\n");
+        break;
+      default:
+        break;
+    }
+  }
+
+  void printInstr(int instr_id, int next_block) {
+    const IrInstr& instr = func_->instrs[instr_id];
+
+    if (instr.opcode == IR_PHI) {
+      return;
+    }
+    for (int value: pre_pushes_[instr_id]) {
+      pushValue(value);
+    }
+    for (int operand: own_pushes_[instr_id]) {
+      pushValue(operand);
+    }
+
+    switch (instr.opcode) {
+      case IR_CONST:
+      case IR_PARAM:
+        if (on_stack_[instr_id]) {
+          pushValue(instr_id);
+        }
+        return;
+      case IR_LOAD_GLOBAL:
+        emit("  push [%d]\n", instr.arg);
+        break;
+      case IR_STORE_GLOBAL:
+        emit("  pop [%d]\n", instr.arg);
+        break;
+      case IR_BINARY:
+      case IR_UNARY:
+        if (isFusedCompare(instr_id)) {
+          break;
+        }
+        if (operatorCommand(instr.arg) == nullptr) {
+          throw IncorrectArgumentException("no such operator " + std::to_string(instr.arg), __PRETTY_FUNCTION__);
+        }
+        emit("  %s\n", operatorCommand(instr.arg));
+        break;
+      case IR_STD:
+        emit(instr.arg == SIN ? "  sin\n" : instr.arg == COS ? "  cos\n" : "  sqrt\n");
+        break;
+      case IR_CALL:
+        if (isTailCall(instr_id)) {
+          emit("  leave\n");
+          emit("  jmp func_%d\n", instr.arg);
+          return;
+        }
+        emit("  call func_%d\n", instr.arg);
+        break;
+      case IR_IN:
+        emit("  in rax\n");
+        emit("  push rax\n");
+        break;
+      case IR_OUT:
+        emit("  pop rbx\n");
+        emit("  out rbx\n");
+        break;
+      default:
+        printTerminator(instr, next_block);
+        return;
+    }
+
+    if (!func_->hasValue(instr_id) || on_stack_[instr_id]) {
+      return;
+    }
+    if (slots_[instr_id] != -1) {
+      emit("  pop [rcx+%zu]\n", func_->param_cnt + slots_[instr_id]);
+    } else {
+      emit("  pop rax\n");
+    }
+  }
+
+  void printFunction(IrFunction& func) {
+    func.splitCriticalEdges();
+    func_ = &func;
+    on_stack_.assign(func.instrs.size(), false);
+    own_pushes_.assign(func.instrs.size(), {});
+    pre_pushes_.assign(func.instrs.size(), {});
+    slots_.assign(func.instrs.size(), -1);
+
+    IrDefUse def_use(func);
+    IrDominators dominators(func);
+    IrLiveness liveness(func);
+    placeOnStack(def_use);
+    assignSlots(def_use, dominators, liveness);
+
+    if (func.is_main) {
+      emit("\n:func_main\n");
+    } else {
+      emit(":func_%d\n", func.func_id);
+    }
+    emit("  enter %zu\n", frame_size_);
+    for (size_t param_id = func.param_cnt; param_id > 0; --param_id) {
+      emit("  pop [rcx+%zu]\n", param_id - 1);
+    }
+
+    const std::vector<int>& layout = dominators.getReversePostorder();
+    for (size_t pos = 0; pos < layout.size(); ++pos) {
+      int next_block = (pos + 1 < layout.size() ? layout[pos + 1] : IrFunction::NO_BLOCK);
+
+      if (pos != 0) {
+        emit("  :%s\n", blockLabel(layout[pos]).c_str());
+      }
+      for (int instr_id: func.blocks[layout[pos]].instrs) {
+        printInstr(instr_id, next_block);
+      }
+    }
+  }
+
+ public:
+  void printProgram(IrProgram& program, FILE* asm_file) {
+    asm_file_ = asm_file;
+    if (program.functions.empty()) {
+      return;
+    }
+
+    emit("  enter %zu\n", program.global_cnt);
+    emit("jmp func_main\n");
+    for (IrFunction& func: program.functions) {
+      if (!func.blocks.empty()) {
+        printFunction(func);
+      }
+    }
+  }
+};
+
+/*
+ * Backends that take the SSA form, by the name given in --backend.
+ */
+std::unique_ptr<IrBackend> makeIrBackend(const std::string& name) {
+  if (name == "stack") {
+    return std::unique_ptr<IrBackend>(new StackBackend());
+  }
+  throw IncorrectArgumentException("no such backend: " + name + ", known backends: tree stack",
+                                   __PRETTY_FUNCTION__);
+}
+
+#endif //DED_PROG_LANG_IR_BACKEND_H
@@ -0,0 +1,766 @@
+//
+// Created by mike on 27.12.18.
+//
+
+#ifndef DED_PROG_LANG_IR_BUILDER_H
+#define DED_PROG_LANG_IR_BUILDER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common_classes.h"
+#include "exception.h"
+#include "flat_tree.h"
+#include "ir.h"
+
+/*
+ * Lowers a flat tree to SSA, one function at a time. Values are built the
+ * way the stack machine would compute them, on a stack of value ids, and
+ * the tree is walked with a stack of tasks instead of recursion. SSA form
+ * is built on the fly (Braun et al., "Simple and Efficient Construction of
+ * Static Single Assignment Form"): the current definition of a variable is
+ * kept per block, reads in blocks whose predecessors are not all known yet
+ * get incomplete phis, and trivial phis are removed as soon as they appear.
+ * The initialisers of globals go to the start of main.
+ */
+class IrBuilder {
+ private:
+  enum TaskKind {
+    TASK_VISIT,
+    TASK_FINISH,
+    TASK_DROP,
+    TASK_DEFINE_LOCAL,
+    TASK_STORE_GLOBAL,
+    TASK_IF_COND,
+    TASK_IF_THEN_END,
+    TASK_IF_ELSE_END,
+    TASK_WHILE_COND,
+    TASK_WHILE_END,
+    TASK_LOGIC_RIGHT,
+    TASK_LOGIC_END,
+  };
+
+  struct BuildTask {
+    TaskKind kind;
+    uint32_t node_id;
+    int func_id;
+    int blocks[3];
+    size_t arg;
+  };
+
+  class BuildTaskList {
+   private:
+    std::vector<BuildTask> tasks_;
+
+   public:
+    void add(TaskKind kind, uint32_t node_id, int func_id, size_t arg = 0,
+             int block_a = IrFunction::NO_BLOCK, int block_b = IrFunction::NO_BLOCK,
+             int block_c = IrFunction::NO_BLOCK) {
+      tasks_.push_back({kind, node_id, func_id, {block_a, block_b, block_c}, arg});
+    }
+
+    void moveTo(std::vector<BuildTask>& stack) {
+      for (auto iter = tasks_.rbegin(); iter != tasks_.rend(); ++iter) {
+        stack.push_back(*iter);
+      }
+      tasks_.clear();
+    }
+  };
+
+  const FlatTree& tree_;
+  IrFunction func_;
+  int current_{IrFunction::NO_BLOCK};
+  std::vector<int> values_;
+  BuildTaskList tasks_;
+
+  size_t var_cnt_{0};
+  std::vector<std::vector<int>> defs_;
+  std::vector<std::vector<std::pair<int, int>>> incomplete_phis_;
+  std::vector<bool> sealed_;
+  std::vector<int> forward_;
+  std::vector<std::vector<int>> phi_users_;
+
+  /* SSA construction */
+
+  int newBlock() {
+    int block = func_.addBlock();
+    defs_.emplace_back(var_cnt_, -1);
+    incomplete_phis_.emplace_back();
+    sealed_.push_back(false);
+    return block;
+  }
+
+  int newInstr(IrOpcode opcode, int arg, const std::vector<int>& operands = {}, double number = 0.0) {
+    int instr_id = func_.append(current_, opcode, arg, operands, number);
+    forward_.push_back(-1);
+    phi_users_.emplace_back();
+    return instr_id;
+  }
+
+  int newPhi(int block) {
+    int phi = func_.addPhi(block);
+    forward_.push_back(-1);
+    phi_users_.emplace_back();
+    return phi;
+  }
+
+  int resolve(int value) const {
+    while (forward_[value] != -1) {
+      value = forward_[value];
+    }
+    return value;
+  }
+
+  void writeVariable(int var_id, int block, int value) {
+    defs_[block][var_id] = value;
+  }
+
+  /*
+   * Walks up chains of single predecessors without recursion; only a
+   * block that joins several paths recurses, through its new phi.
+   */
+  int readVariable(int var_id, int block) {
+    std::vector<int> chain;
+    int value = -1;
+
+    while (true) {
+      if (defs_[block][var_id] != -1) {
+        value = resolve(defs_[block][var_id]);
+        break;
+      }
+      chain.push_back(block);
+      if (!sealed_[block]) {
+        value = newPhi(block);
+        incomplete_phis_[block].push_back({var_id, value});
+        break;
+      }
+      if (func_.blocks[block].preds.size() == 1) {
+        block = func_.blocks[block].preds[0];
+        continue;
+      }
+      value = newPhi(block);
+      writeVariable(var_id, block, value);
+      value = addPhiOperands(var_id, value);
+      break;
+    }
+
+    for (int chain_block: chain) {
+      writeVariable(var_id, chain_block, value);
+    }
+    return value;
+  }
+
+  int addPhiOperands(int var_id, int phi) {
+    std::vector<int> preds = func_.blocks[func_.instrs[phi].block].preds;
+
+    for (int pred: preds) {
+      int operand = readVariable(var_id, pred);
+      func_.instrs[phi].operands.push_back(operand);
+      phi_users_[operand].push_back(phi);
+    }
+    return tryRemoveTrivialPhi(phi);
+  }
+
+  /*
+   * A phi whose operands are all one value (or itself) is that value.
+   * Phis that used it may become trivial in turn.
+   */
+  int tryRemoveTrivialPhi(int phi) {
+    int same = -1;
+
+    for (int operand: func_.instrs[phi].operands) {
+      operand = resolve(operand);
+      if (operand == same || operand == phi) {
+        continue;
+      }
+      if (same != -1) {
+        return phi;
+      }
+      same = operand;
+    }
+    if (same == -1) {
+      throw IncorrectArgumentException("variable of " + func_.name + " is read where it has no value",
+                                       __PRETTY_FUNCTION__);
+    }
+
+    forward_[phi] = same;
+    func_.instrs[phi].removed = true;
+    std::vector<int> users = phi_users_[phi];
+    for (int user: users) {
+      phi_users_[same].push_back(user);
+      if (user != phi && !func_.instrs[user].removed) {
+        tryRemoveTrivialPhi(user);
+      }
+    }
+    return same;
+  }
+
+  void sealBlock(int block) {
+    std::vector<std::pair<int, int>> phis = std::move(incomplete_phis_[block]);
+
+    sealed_[block] = true;
+    for (const std::pair<int, int>& var_phi: phis) {
+      addPhiOperands(var_phi.first, var_phi.second);
+    }
+  }
+
+  /* control flow */
+
+  void jumpTo(int block) {
+    newInstr(IR_JUMP, 0);
+    func_.addEdge(current_, block);
+  }
+
+  void branchTo(int value, int then_block, int else_block) {
+    newInstr(IR_BRANCH, 0, {value});
+    func_.addEdge(current_, then_block);
+    func_.addEdge(current_, else_block);
+  }
+
+  /* values */
+
+  void pushValue(int value) {
+    values_.push_back(value);
+  }
+
+  int popValue() {
+    if (values_.empty()) {
+      throw IncorrectArgumentException("expression of " + func_.name + " has no value", __PRETTY_FUNCTION__);
+    }
+    int value = values_.back();
+    values_.pop_back();
+    return value;
+  }
+
+  int getVarId(uint32_t var_node) const {
+    int slot = tree_.getPayload(var_node);
+    return tree_.getType(var_node) == LOCAL_VARIABLE ? static_cast<int>(func_.param_cnt) + slot : slot;
+  }
+
+  static bool isGlobal(NodeType type, int func_id) {
+    return type == VARIABLE || func_id == -1;
+  }
+
+  void readNodeVariable(uint32_t var_node, int func_id) {
+    if (isGlobal(tree_.getType(var_node), func_id)) {
+      pushValue(newInstr(IR_LOAD_GLOBAL, tree_.getPayload(var_node)));
+    } else {
+      pushValue(readVariable(getVarId(var_node), current_));
+    }
+  }
+
+  void assignNodeVariable(uint32_t var_node, int func_id, int value) {
+    if (isGlobal(tree_.getType(var_node), func_id)) {
+      newInstr(IR_STORE_GLOBAL, tree_.getPayload(var_node), {value});
+    } else {
+      writeVariable(getVarId(var_node), current_, value);
+    }
+  }
+
+  /* tasks */
+
+  void visitSons(uint32_t node_id, int func_id, uint32_t first_son = 0) {
+    for (uint32_t son_pos = first_son; son_pos < tree_.getSonCnt(node_id); ++son_pos) {
+      tasks_.add(TASK_VISIT, tree_.getSon(node_id, son_pos), func_id);
+    }
+  }
+
+  /*
+   * Statements leave nothing behind: a call whose value is not used is
+   * dropped from the value stack after its statement.
+   */
+  void visitStatements(uint32_t node_id, int func_id, uint32_t first_son = 0) {
+    for (uint32_t son_pos = first_son; son_pos < tree_.getSonCnt(node_id); ++son_pos) {
+      tasks_.add(TASK_VISIT, tree_.getSon(node_id, son_pos), func_id);
+      tasks_.add(TASK_DROP, FlatTree::NO_NODE, func_id, values_.size());
+    }
+  }
+
+  /*
+   * && and || are control flow: the right operand gets a block of its own
+   * and the join picks the result with a phi.
+   */
+  void visitOperator(uint32_t node_id, int func_id) {
+    int oper_type = tree_.getPayload(node_id);
+
+    if ((oper_type == BOOL_AND || oper_type == BOOL_OR) && tree_.getSonCnt(node_id) == 2) {
+      int right_block = newBlock();
+      int join_block = newBlock();
+
+      tasks_.add(TASK_VISIT, tree_.getSon(node_id, 0), func_id);
+      tasks_.add(TASK_LOGIC_RIGHT, node_id, func_id, 0, right_block, join_block);
+      tasks_.add(TASK_VISIT, tree_.getSon(node_id, 1), func_id);
+      tasks_.add(TASK_LOGIC_END, node_id, func_id, 0, right_block, join_block);
+      return;
+    }
+    if (oper_type == EQUAL) {
+      tasks_.add(TASK_VISIT, tree_.getSon(node_id, 1), func_id);
+    } else {
+      if (oper_type == MINUS && tree_.getSonCnt(node_id) == 1) {
+        pushValue(newInstr(IR_CONST, 0, {}, 0.0));
+      }
+      visitSons(node_id, func_id);
+    }
+    tasks_.add(TASK_FINISH, node_id, func_id);
+  }
+
+  void visitStandartFunction(uint32_t node_id, int func_id) {
+    switch (tree_.getPayload(node_id)) {
+      case INPUT:
+        assignNodeVariable(tree_.getSon(node_id, 0), func_id, newInstr(IR_IN, 0));
+        return;
+      case CALL:
+        visitSons(node_id, func_id, 1);
+        break;
+      default:
+        visitSons(node_id, func_id);
+        break;
+    }
+    tasks_.add(TASK_FINISH, node_id, func_id);
+  }
+
+  void visitLogic(uint32_t node_id, int func_id) {
+    switch (tree_.getPayload(node_id)) {
+      case IF:
+      {
+        int then_block = newBlock();
+        int else_block = (tree_.getSonCnt(node_id) > 2 ? newBlock() : IrFunction::NO_BLOCK);
+        int join_block = newBlock();
+
+        tasks_.add(TASK_VISIT, tree_.getSon(node_id, 0), func_id);
+        tasks_.add(TASK_IF_COND, node_id, func_id, 0, then_block, else_block, join_block);
+        tasks_.add(TASK_VISIT, tree_.getSon(node_id, 1), func_id);
+        tasks_.add(TASK_IF_THEN_END, node_id, func_id, 0, then_block, else_block, join_block);
+        if (else_block != IrFunction::NO_BLOCK) {
+          tasks_.add(TASK_VISIT, tree_.getSon(node_id, 2), func_id);
+          tasks_.add(TASK_IF_ELSE_END, node_id, func_id, 0, then_block, else_block, join_block);
+        }
+        break;
+      }
+      case WHILE:
+      {
+        int header_block = newBlock();
+        int body_block = newBlock();
+        int exit_block = newBlock();
+
+        jumpTo(header_block);
+        current_ = header_block;
+        tasks_.add(TASK_VISIT, tree_.getSon(node_id, 0), func_id);
+        tasks_.add(TASK_WHILE_COND, node_id, func_id, 0, header_block, body_block, exit_block);
+        tasks_.add(TASK_VISIT, tree_.getSon(node_id, 1), func_id);
+        tasks_.add(TASK_WHILE_END, node_id, func_id, 0, header_block, body_block, exit_block);
+        break;
+      }
+      case CONDITION:
+        visitSons(node_id, func_id);
+        break;
+      case CONDITION_MET:
+      case ELSE:
+        visitStatements(node_id, func_id);
+        break;
+      default:
+        throw IncorrectArgumentException(std::string("no such separate logic block was provided: ") +
+                                           std::to_string(tree_.getPayload(node_id)), __PRETTY_FUNCTION__);
+    }
+  }
+
+  /*
+   * Code after a return is not lowered: there is no current block until
+   * the next join that something reaches.
+   */
+  void visitNode(uint32_t node_id, int func_id) {
+    if (current_ == IrFunction::NO_BLOCK) {
+      return;
+    }
+
+    switch (tree_.getType(node_id)) {
+      case NUMBER:
+        pushValue(newInstr(IR_CONST, 0, {}, tree_.getValue(node_id)));
+        break;
+      case VARIABLE:
+      case LOCAL_VARIABLE:
+      case PARAM:
+        readNodeVariable(node_id, func_id);
+        break;
+      case OPERATOR:
+        visitOperator(node_id, func_id);
+        break;
+      case STANDART_FUNCTION:
+        visitStandartFunction(node_id, func_id);
+        break;
+      case LOGIC:
+        visitLogic(node_id, func_id);
+        break;
+      case RETURN:
+        visitSons(node_id, func_id);
+        tasks_.add(TASK_FINISH, node_id, func_id);
+        break;
+      case VAR_INIT:
+        break;
+      default:
+        throw IncorrectArgumentException(std::string("no such statement node type: ") +
+                                           std::to_string(tree_.getType(node_id)), __PRETTY_FUNCTION__);
+    }
+  }
+
+  /*
+   * x ^ n for a small constant n by the multiplications raiseToPower does.
+   */
+  int multiplyChain(int base, int exponent) {
+    int top_bit = 0;
+    int power = base;
+
+    while ((exponent >> (top_bit + 1)) != 0) {
+      ++top_bit;
+    }
+    for (int bit = top_bit - 1; bit >= 0; --bit) {
+      power = newInstr(IR_BINARY, MULTIPLY, {power, power});
+      if (((exponent >> bit) & 1) != 0) {
+        power = newInstr(IR_BINARY, MULTIPLY, {power, base});
+      }
+    }
+    return power;
+  }
+
+  void finishOperator(uint32_t node_id, int func_id) {
+    int oper_type = tree_.getPayload(node_id);
+    int arg_b = popValue();
+
+    switch (oper_type) {
+      case EQUAL:
+        assignNodeVariable(tree_.getSon(node_id, 0), func_id, arg_b);
+        return;
+      case PLUS_EQUAL:
+      case MINUS_EQUAL:
+      case MULTIPLY_EQUAL:
+      case DIVIDE_EQUAL:
+      {
+        static const int base_oper[] = {PLUS, MINUS, MULTIPLY, DIVIDE};
+        int value = newInstr(IR_BINARY, base_oper[oper_type - PLUS_EQUAL], {popValue(), arg_b});
+        assignNodeVariable(tree_.getSon(node_id, 0), func_id, value);
+        return;
+      }
+      case BOOL_NOT:
+        pushValue(newInstr(IR_UNARY, oper_type, {arg_b}));
+        return;
+      case POWER:
+        if (func_.instrs[arg_b].opcode == IR_CONST && isChainExponent(func_.instrs[arg_b].number)) {
+          pushValue(multiplyChain(popValue(), static_cast<int>(func_.instrs[arg_b].number)));
+          return;
+        }
+        pushValue(newInstr(IR_BINARY, oper_type, {popValue(), arg_b}));
+        return;
+      default:
+        pushValue(newInstr(IR_BINARY, oper_type, {popValue(), arg_b}));
+        return;
+    }
+  }
+
+  bool isBoolean(int value) const {
+    const IrInstr& instr = func_.instrs[value];
+    return (instr.opcode == IR_BINARY || instr.opcode == IR_UNARY) && instr.arg >= BOOL_EQUAL && instr.arg <= BOOL_AND;
+  }
+
+  /*
+   * The left operand decides alone when it is false for && and true for
+   * ||; that edge brings the result as a constant, the other one the
+   * right operand compared with zero.
+   */
+  void startLogicRight(const BuildTask& task) {
+    int left_value = popValue();
+    bool is_and = tree_.getPayload(task.node_id) == BOOL_AND;
+
+    pushValue(newInstr(IR_CONST, 0, {}, is_and ? 0.0 : 1.0));
+    if (is_and) {
+      branchTo(left_value, task.blocks[0], task.blocks[1]);
+    } else {
+      branchTo(left_value, task.blocks[1], task.blocks[0]);
+    }
+    sealBlock(task.blocks[0]);
+    current_ = task.blocks[0];
+  }
+
+  void finishLogic(const BuildTask& task) {
+    int right_value = popValue();
+    int decided_value = popValue();
+
+    if (!isBoolean(right_value)) {
+      right_value = newInstr(IR_BINARY, BOOL_NOT_EQUAL, {right_value, newInstr(IR_CONST, 0, {}, 0.0)});
+    }
+    jumpTo(task.blocks[1]);
+    sealBlock(task.blocks[1]);
+    current_ = task.blocks[1];
+
+    int phi = newPhi(current_);
+    func_.instrs[phi].operands = {decided_value, right_value};
+    pushValue(phi);
+  }
+
+  void finishStandartFunction(uint32_t node_id) {
+    int std_func_type = tree_.getPayload(node_id);
+
+    switch (std_func_type) {
+      case OUTPUT:
+        newInstr(IR_OUT, 0, {popValue()});
+        break;
+      case SIN:
+      case COS:
+      case SQ_ROOT:
+        pushValue(newInstr(IR_STD, std_func_type, {popValue()}));
+        break;
+      case CALL:
+      {
+        int callee = tree_.getPayload(tree_.getSon(node_id, 0));
+        size_t param_cnt = tree_.getParamCnt(callee);
+
+        if (param_cnt + 1 != tree_.getSonCnt(node_id)) {
+          throw IncorrectArgumentException(std::string("called function get ") + std::to_string(param_cnt) +
+            " params but not " + std::to_string(tree_.getSonCnt(node_id) - 1), __PRETTY_FUNCTION__);
+        }
+        std::vector<int> args(values_.end() - param_cnt, values_.end());
+        values_.resize(values_.size() - param_cnt);
+        pushValue(newInstr(IR_CALL, callee, args));
+        break;
+      }
+      default:
+        throw IncorrectArgumentException(std::string("no such standart function ") +
+                                           std::to_string(std_func_type), __PRETTY_FUNCTION__);
+    }
+  }
+
+  /*
+   * Every call leaves a value, so a function that returns none returns 0.
+   */
+  void newReturn() {
+    if (func_.is_main) {
+      newInstr(IR_RETURN, 0);
+    } else {
+      newInstr(IR_RETURN, 0, {newInstr(IR_CONST, 0, {}, 0.0)});
+    }
+  }
+
+  void finishNode(uint32_t node_id, int func_id) {
+    switch (tree_.getType(node_id)) {
+      case OPERATOR:
+        finishOperator(node_id, func_id);
+        break;
+      case STANDART_FUNCTION:
+        finishStandartFunction(node_id);
+        break;
+      case RETURN:
+        if (tree_.getSonCnt(node_id) == 1) {
+          newInstr(IR_RETURN, 0, {popValue()});
+        } else {
+          newReturn();
+        }
+        current_ = IrFunction::NO_BLOCK;
+        break;
+      default:
+        break;
+    }
+  }
+
+  void leaveBlock(int next_block) {
+    if (current_ != IrFunction::NO_BLOCK) {
+      jumpTo(next_block);
+    }
+  }
+
+  void enterJoin(int join_block) {
+    sealBlock(join_block);
+    current_ = func_.blocks[join_block].preds.empty() ? IrFunction::NO_BLOCK : join_block;
+  }
+
+  void runTask(const BuildTask& task) {
+    switch (task.kind) {
+      case TASK_VISIT:
+        visitNode(task.node_id, task.func_id);
+        break;
+      case TASK_FINISH:
+        finishNode(task.node_id, task.func_id);
+        break;
+      case TASK_DROP:
+        values_.resize(std::min(values_.size(), task.arg));
+        break;
+      case TASK_DEFINE_LOCAL:
+        writeVariable(static_cast<int>(func_.param_cnt + task.arg), current_, popValue());
+        break;
+      case TASK_STORE_GLOBAL:
+        newInstr(IR_STORE_GLOBAL, static_cast<int>(task.arg), {popValue()});
+        break;
+      case TASK_IF_COND:
+      {
+        int value = popValue();
+        int else_block = task.blocks[1] != IrFunction::NO_BLOCK ? task.blocks[1] : task.blocks[2];
+
+        branchTo(value, task.blocks[0], else_block);
+        sealBlock(task.blocks[0]);
+        if (task.blocks[1] != IrFunction::NO_BLOCK) {
+          sealBlock(task.blocks[1]);
+        }
+        current_ = task.blocks[0];
+        break;
+      }
+      case TASK_IF_THEN_END:
+        leaveBlock(task.blocks[2]);
+        if (task.blocks[1] != IrFunction::NO_BLOCK) {
+          current_ = task.blocks[1];
+        } else {
+          enterJoin(task.blocks[2]);
+        }
+        break;
+      case TASK_IF_ELSE_END:
+        leaveBlock(task.blocks[2]);
+        enterJoin(task.blocks[2]);
+        break;
+      case TASK_WHILE_COND:
+        branchTo(popValue(), task.blocks[1], task.blocks[2]);
+        sealBlock(task.blocks[1]);
+        sealBlock(task.blocks[2]);
+        current_ = task.blocks[1];
+        break;
+      case TASK_WHILE_END:
+        leaveBlock(task.blocks[0]);
+        sealBlock(task.blocks[0]);
+        current_ = task.blocks[2];
+        break;
+      case TASK_LOGIC_RIGHT:
+        startLogicRight(task);
+        break;
+      case TASK_LOGIC_END:
+        finishLogic(task);
+        break;
+    }
+  }
+
+  /*
+   * Drops removed phis, points operands at the values that replaced them
+   * and deletes joins that nothing reaches.
+   */
+  void finishFunction() {
+    std::vector<int> new_ids(func_.blocks.size());
+    std::vector<IrBlock> blocks;
+
+    for (size_t block = 0; block < func_.blocks.size(); ++block) {
+      new_ids[block] = IrFunction::NO_BLOCK;
+      if (block == 0 || !func_.blocks[block].preds.empty()) {
+        new_ids[block] = static_cast<int>(blocks.size());
+        blocks.push_back(std::move(func_.blocks[block]));
+      }
+    }
+    for (IrBlock& block: blocks) {
+      std::vector<int> instrs;
+      for (int instr_id: block.instrs) {
+        if (!func_.instrs[instr_id].removed) {
+          instrs.push_back(instr_id);
+        }
+      }
+      block.instrs = std::move(instrs);
+      for (int& pred: block.preds) {
+        pred = new_ids[pred];
+      }
+      for (int& succ: block.succs) {
+        succ = new_ids[succ];
+      }
+    }
+    for (IrInstr& instr: func_.instrs) {
+      instr.block = new_ids[instr.block];
+      for (int& operand: instr.operands) {
+        operand = resolve(operand);
+      }
+    }
+    func_.blocks = std::move(blocks);
+  }
+
+  void buildFunction(uint32_t func_node, int func_id, uint32_t globals_node) {
+    std::vector<BuildTask> stack;
+
+    func_ = IrFunction();
+    func_.name = tree_.getFuncName(func_id);
+    func_.func_id = func_id;
+    func_.is_main = (func_id == tree_.getMainId());
+    func_.param_cnt = tree_.getParamCnt(func_id);
+    var_cnt_ = tree_.getFrameSize(func_id);
+    defs_.clear();
+    incomplete_phis_.clear();
+    sealed_.clear();
+    forward_.clear();
+    phi_users_.clear();
+    values_.clear();
+
+    current_ = newBlock();
+    sealBlock(current_);
+    for (size_t param_id = 0; param_id < func_.param_cnt; ++param_id) {
+      writeVariable(static_cast<int>(param_id), current_, newInstr(IR_PARAM, static_cast<int>(param_id)));
+    }
+    if (globals_node != FlatTree::NO_NODE) {
+      for (uint32_t son_pos = 0; son_pos < tree_.getSonCnt(globals_node); ++son_pos) {
+        tasks_.add(TASK_VISIT, tree_.getSon(globals_node, son_pos), -1);
+        tasks_.add(TASK_STORE_GLOBAL, FlatTree::NO_NODE, -1, son_pos);
+      }
+    }
+    uint32_t var_init = tree_.getSon(func_node, 0);
+    for (uint32_t son_pos = 0; son_pos < tree_.getSonCnt(var_init); ++son_pos) {
+      tasks_.add(TASK_VISIT, tree_.getSon(var_init, son_pos), func_id);
+      tasks_.add(TASK_DEFINE_LOCAL, FlatTree::NO_NODE, func_id, son_pos);
+    }
+    visitStatements(func_node, func_id, 1);
+    tasks_.moveTo(stack);
+
+    while (!stack.empty()) {
+      BuildTask task = stack.back();
+      stack.pop_back();
+
+      runTask(task);
+      tasks_.moveTo(stack);
+    }
+
+    if (current_ != IrFunction::NO_BLOCK) {
+      newReturn();
+    }
+    finishFunction();
+  }
+
+ public:
+  explicit IrBuilder(const FlatTree& tree): tree_(tree) {}
+
+  IrProgram build() {
+    IrProgram program{tree_.getGlobalCnt(), {}};
+
+    if (tree_.empty()) {
+      return program;
+    }
+
+    uint32_t root = tree_.getRoot();
+    uint32_t funcs = tree_.getSon(root, 1);
+    std::vector<uint32_t> func_nodes(tree_.getFuncCnt());
+
+    for (uint32_t& func_node: func_nodes) {
+      func_node = FlatTree::NO_NODE;
+    }
+    for (uint32_t son_pos = 0; son_pos < tree_.getSonCnt(funcs); ++son_pos) {
+      uint32_t func_node = tree_.getSon(funcs, son_pos);
+      if (tree_.getSonCnt(func_node) != 0) {
+        func_nodes[tree_.getPayload(func_node)] = func_node;
+      }
+    }
+    func_nodes[tree_.getMainId()] = tree_.getSon(root, 2);
+
+    program.functions.resize(func_nodes.size());
+    for (int func_id = 0; func_id < static_cast<int>(func_nodes.size()); ++func_id) {
+      if (func_nodes[func_id] == FlatTree::NO_NODE) {
+        continue;
+      }
+      uint32_t globals_node = FlatTree::NO_NODE;
+      if (func_id == tree_.getMainId()) {
+        globals_node = tree_.getSon(root, 0);
+      }
+      buildFunction(func_nodes[func_id], func_id, globals_node);
+      program.functions[func_id] = std::move(func_);
+    }
+    return program;
+  }
+};
+
+#endif //DED_PROG_LANG_IR_BUILDER_H
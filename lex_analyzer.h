@@ -11,6 +11,10 @@
 #include <string>
 #include <set>
 
+#include "arena.h"
+#include "common_classes.h"
+#include "exception.h"
+
 enum TokenType {
   BRACE,
   SEPARATOR,
@@ -23,16 +27,15 @@ enum TokenType {
 };
 
 struct Token {
-  std::string value;
+  StringRef value;
   TokenType token_type;
 };
 
 class LexAnalyzer {
  private:
-  const static size_t MAX_BUF_SIZE = 4096;
-
-  char buf_[MAX_BUF_SIZE];
+  std::vector<char> buf_;
   size_t buf_size_;
+  Arena& arena_;
   char* buf_ptr_;
 
   void skipSpaceChars() {
@@ -52,7 +55,7 @@ class LexAnalyzer {
   }
 
   bool isOper(char ch) const {
-    return ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '!';
+    return ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '^' || ch == '!';
   }
 
   bool isExprChar(char ch) const {
@@ -62,15 +65,22 @@ class LexAnalyzer {
   bool isSeparator(char ch) const {
     return ch == ',' || ch == ';' || ch == '!' || ch == '&' ||
            ch == '|' || ch == '<' || ch == '>' || ch == '=' ||
-           ch == '+' || ch == '-' || ch == '*' || ch == '/';
+           ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '^';
   }
 
-  std::set<std::string> keywords_;
+  std::set<StringRef> keywords_;
+
+  Token makeToken(const std::string& value, TokenType token_type) {
+    if (value.empty()) {
+      return {StringRef(), token_type};
+    }
+    return {StringRef(value, arena_), token_type};
+  }
 
  public:
-  LexAnalyzer(FILE* input) {
-    buf_size_ = fread((void*)buf_, sizeof(char), MAX_BUF_SIZE - 1, input);
-    buf_ptr_ = buf_;
+  LexAnalyzer(FILE* input, Arena& arena): arena_(arena) {
+    buf_size_ = readWholeFile(input, buf_);
+    buf_ptr_ = buf_.data();
     std::cout << "size of code buffer: " << buf_size_ << '\n';
 
     keywords_.insert("lol");
@@ -92,7 +102,7 @@ class LexAnalyzer {
   }
 
   bool done() const {
-    return buf_ptr_ == buf_ + buf_size_;
+    return buf_ptr_ == buf_.data() + buf_size_;
   }
 
   Token parseInt() {
@@ -111,7 +121,7 @@ class LexAnalyzer {
       --buf_ptr_;
     }
 
-    return {result, INTEGER};
+    return makeToken(result, INTEGER);
   }
 
   Token parseDouble() {
@@ -121,23 +131,23 @@ class LexAnalyzer {
     if (done() || *buf_ptr_ != '.' || int_part.value == "") {
       return int_part;
     }
-    result = int_part.value + ".";
+    result = int_part.value.str() + ".";
     ++buf_ptr_;
     while (!done() && std::isdigit(*buf_ptr_)) {
       result.push_back(*buf_ptr_);
       ++buf_ptr_;
     }
-    return {result, DOUBLE};
+    return makeToken(result, DOUBLE);
   }
 
   Token parseBrace() {
     if (isBrace(*buf_ptr_)) {
-      Token result{std::string("") + *buf_ptr_, BRACE};
+      Token result = makeToken(std::string("") + *buf_ptr_, BRACE);
 
       ++buf_ptr_;
       return result;
     }
-    return {"", BRACE};
+    return makeToken("", BRACE);
   }
 
   Token parseString(const std::string& str, TokenType token_type = STRING) {
@@ -153,10 +163,10 @@ class LexAnalyzer {
     }
     if (char_id < str.size()) {
       buf_ptr_ = was_ptr;
-      return {"", token_type};
+      return makeToken("", token_type);
     }
 
-    return {str, token_type};
+    return makeToken(str, token_type);
   }
 
 
@@ -165,7 +175,7 @@ class LexAnalyzer {
 
     std::vector<std::string> oper_strs{"==", "!=", "!", "<=", ">=", "<", ">",
                                        "||", "&&", "+=", "-=", "*=", "/=",
-                                       "+", "-", "*", "/", "="};
+                                       "+", "-", "*", "/", "^", "="};
 
     for (const std::string& oper_str: oper_strs) {
       result = parseString(oper_str, OPER);
@@ -178,28 +188,28 @@ class LexAnalyzer {
 
   Token parseSeparator() {
     if (*buf_ptr_ == ';') {
-      Token result{std::string("") + *buf_ptr_, SEPARATOR};
+      Token result = makeToken(std::string("") + *buf_ptr_, SEPARATOR);
 
       ++buf_ptr_;
       return result;
     }
     if (*buf_ptr_ == ',') {
-      Token result{std::string("") + *buf_ptr_, SEPARATOR};
+      Token result = makeToken(std::string("") + *buf_ptr_, SEPARATOR);
 
       ++buf_ptr_;
       return result;
     }
-    return {"", SEPARATOR};
+    return makeToken("", SEPARATOR);
   }
 
   Token parseAssign() {
     if (*buf_ptr_ == '=') {
-      Token result{std::string("") + *buf_ptr_, ASSIGN};
+      Token result = makeToken(std::string("") + *buf_ptr_, ASSIGN);
 
       ++buf_ptr_;
       return result;
     }
-    return {"", ASSIGN};
+    return makeToken("", ASSIGN);
   }
 
   Token parseName() {
@@ -210,7 +220,7 @@ class LexAnalyzer {
       ++buf_ptr_;
     }
 
-    return {result, STRING};
+    return makeToken(result, STRING);
   }
 
   Token parseKeyword() {
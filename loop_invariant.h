@@ -0,0 +1,147 @@
+//
+// Created by mike on 25.12.18.
+//
+
+#ifndef DED_PROG_LANG_LOOP_INVARIANT_H
+#define DED_PROG_LANG_LOOP_INVARIANT_H
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_analysis.h"
+#include "tree_visitor.h"
+
+/*
+ * Moves loop invariant expressions out of while loops. An expression is
+ * invariant when it is pure, cannot trap and reads only variables which
+ * nothing in the loop writes; a call in the loop may write every global.
+ * Each maximal invariant expression is computed once into a temporary
+ * right before the loop, equal expressions share one temporary. Outer
+ * loops go first, so an expression leaves as many loops as it can.
+ */
+class LoopInvariantPass : public Pass {
+ private:
+  class Hoister : public TreeRewriter {
+   private:
+    const ModifiedVarsFinder& modified_;
+    std::set<Node*> invariant_;
+    std::vector<std::pair<Node*, int>> hoisted_;
+
+    bool isInvariantNode(Node* node, int func_id) const {
+      switch (node->type) {
+        case NUMBER:
+          return true;
+        case VARIABLE:
+        case LOCAL_VARIABLE:
+        case PARAM:
+          return !modified_.isModified(getVarKey(tree_, node, func_id));
+        case OPERATOR:
+          if (isAssignOperator(node)) {
+            return false;
+          }
+          return node->value != DIVIDE || (node->sons[1]->type == NUMBER && node->sons[1]->value != 0.0);
+        case STANDART_FUNCTION:
+          return node->value == SIN || node->value == COS || node->value == SQ_ROOT;
+        default:
+          return false;
+      }
+    }
+
+    static bool isWorthHoisting(const Node* node) {
+      return node->type == OPERATOR || node->type == STANDART_FUNCTION;
+    }
+
+    int getTemporary(Node* expr, int func_id) {
+      for (const std::pair<Node*, int>& hoisted: hoisted_) {
+        if (isSameTree(hoisted.first, expr)) {
+          return hoisted.second;
+        }
+      }
+      hoisted_.push_back({expr, tree_.addTemporary("licm", func_id)});
+      return hoisted_.back().second;
+    }
+
+   protected:
+    Node* rewrite(Node* node, int func_id) {
+      bool sons_invariant = true;
+
+      for (Node* son: node->sons) {
+        sons_invariant &= invariant_.count(son) != 0;
+      }
+      if (sons_invariant && isInvariantNode(node, func_id)) {
+        invariant_.insert(node);
+        return node;
+      }
+
+      for (Node*& son: node->sons) {
+        if (invariant_.count(son) != 0 && isWorthHoisting(son)) {
+          son = tree_.newNode(LOCAL_VARIABLE, getTemporary(son, func_id));
+          noteChanges();
+        }
+      }
+      return node;
+    }
+
+   public:
+    Hoister(Tree& tree, const ModifiedVarsFinder& modified): TreeRewriter(tree), modified_(modified) {}
+
+    const std::vector<std::pair<Node*, int>>& getHoisted() const {
+      return hoisted_;
+    }
+  };
+
+  size_t hoisted_cnt_{0};
+  size_t loop_cnt_{0};
+
+  void hoistFromLoop(Tree& tree, const LoopSite& site) {
+    if (site.block == nullptr ||
+        std::find(site.block->sons.begin(), site.block->sons.end(), site.loop) == site.block->sons.end()) {
+      return;
+    }
+
+    ModifiedVarsFinder modified(tree);
+    modified.walk(site.loop, site.func_id);
+
+    Hoister hoister(tree, modified);
+    hoister.walk(site.loop, site.func_id);
+    if (hoister.getHoisted().empty()) {
+      return;
+    }
+
+    NodeList& statements = site.block->sons;
+    auto loop_pos = std::find(statements.begin(), statements.end(), site.loop);
+    std::vector<Node*> assigns;
+
+    for (const std::pair<Node*, int>& hoisted: hoister.getHoisted()) {
+      assigns.push_back(tree.newNode(OPERATOR, EQUAL, {tree.newNode(LOCAL_VARIABLE, hoisted.second), hoisted.first}));
+    }
+    statements.insert(loop_pos, assigns.begin(), assigns.end());
+    hoisted_cnt_ += hoister.getRewriteCnt();
+    ++loop_cnt_;
+  }
+
+ public:
+  size_t run(Tree& tree) {
+    LoopFinder finder(tree);
+    finder.walk(tree.getRoot());
+
+    hoisted_cnt_ = 0;
+    loop_cnt_ = 0;
+    for (const LoopSite& site: finder.getSites()) {
+      hoistFromLoop(tree, site);
+    }
+    return hoisted_cnt_;
+  }
+
+  std::string getReport() const {
+    return "hoisted " + std::to_string(hoisted_cnt_) + " expressions out of " +
+      std::to_string(loop_cnt_) + " loops";
+  }
+};
+
+#endif //DED_PROG_LANG_LOOP_INVARIANT_H
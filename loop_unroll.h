@@ -0,0 +1,260 @@
+//
+// Created by mike on 31.12.18.
+//
+
+#ifndef DED_PROG_LANG_LOOP_UNROLL_H
+#define DED_PROG_LANG_LOOP_UNROLL_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_analysis.h"
+#include "tree_profile.h"
+#include "tree_visitor.h"
+
+/*
+ * Unrolls while loops whose trip count is known while compiling: the
+ * condition compares a local with a constant by <, <=, > or >=, and the
+ * local starts from a constant and is only written by a constant step at
+ * the top level of the body. The trip count comes from doing the same
+ * double arithmetic as the program. Short loops become copies of their
+ * body. Longer ones run factor copies of the body per test while the
+ * copies fit in MAX_UNROLLED_SIZE nodes, and the original loop runs what
+ * is left. Inner loops go first. With a profile loops the run never
+ * entered are left alone and hot ones may take twice as many nodes.
+ */
+class LoopUnrollPass : public Pass {
+ private:
+  static const size_t MAX_FULL_TRIPS = 16;
+  static const size_t MAX_UNROLLED_SIZE = 256;
+  static const size_t MAX_HOT_UNROLLED_SIZE = 512;
+  static const size_t MAX_SIMULATED_TRIPS = 1 << 20;
+
+  struct CountedLoop {
+    Node* var;
+    double start;
+    double step;
+    size_t trip_cnt;
+  };
+
+  Tree* tree_{nullptr};
+  size_t factor_;
+  const TreeProfile* profile_;
+  size_t full_cnt_{0};
+  size_t partial_cnt_{0};
+
+  static int mirrorComparison(int oper_type) {
+    switch (oper_type) {
+      case BOOL_LOWER:
+        return BOOL_GREATER;
+      case BOOL_GREATER:
+        return BOOL_LOWER;
+      case BOOL_NOT_LOWER:
+        return BOOL_NOT_GREATER;
+      case BOOL_NOT_GREATER:
+        return BOOL_NOT_LOWER;
+      default:
+        return -1;
+    }
+  }
+
+  static bool compare(int oper_type, double value, double limit) {
+    switch (oper_type) {
+      case BOOL_LOWER:
+        return value < limit;
+      case BOOL_GREATER:
+        return value > limit;
+      case BOOL_NOT_LOWER:
+        return value >= limit;
+      default:
+        return value <= limit;
+    }
+  }
+
+  /*
+   * The value of the local when the loop starts: the constant the last
+   * statement before the loop that writes it assigns or, at the top level
+   * of a function, its constant initialiser if nothing writes it earlier.
+   */
+  bool findStart(const LoopSite& site, const Node* var, double& start) const {
+    NodeList& statements = site.block->sons;
+    VarKey key = getVarKey(*tree_, var, site.func_id);
+
+    for (auto pos = std::find(statements.begin(), statements.end(), site.loop); pos != statements.begin(); ) {
+      Node* statement = *--pos;
+      AssignedVarsFinder assigned(*tree_);
+
+      if (statement->type == VAR_INIT) {
+        break;
+      }
+      assigned.walk(statement, site.func_id);
+      if (assigned.getAssigned().count(key) == 0) {
+        continue;
+      }
+      if (statement->type != OPERATOR || statement->value != EQUAL || statement->sons[1]->type != NUMBER) {
+        return false;
+      }
+      start = statement->sons[1]->value;
+      return true;
+    }
+
+    if ((site.block->type != USER_FUNCTION && site.block->type != MAIN) || site.block->sons.empty() ||
+        site.block->sons[0]->type != VAR_INIT) {
+      return false;
+    }
+
+    const Node* init = site.block->sons[0]->sons[static_cast<size_t>(var->value)];
+    if (init->type != NUMBER) {
+      return false;
+    }
+    start = init->value;
+    return true;
+  }
+
+  bool findCountedLoop(const LoopSite& site, CountedLoop& counted) const {
+    Node* condition = site.loop->sons[0]->sons[0];
+    int oper_type = static_cast<int>(condition->value);
+
+    if (condition->type != OPERATOR || condition->sons.size() != 2 || mirrorComparison(oper_type) == -1) {
+      return false;
+    }
+
+    Node* var = condition->sons[0];
+    Node* limit = condition->sons[1];
+    if (var->type == NUMBER) {
+      std::swap(var, limit);
+      oper_type = mirrorComparison(oper_type);
+    }
+    if (var->type != LOCAL_VARIABLE || limit->type != NUMBER) {
+      return false;
+    }
+
+    AssignCountFinder assigns(*tree_);
+    assigns.walk(site.loop, site.func_id);
+    if (assigns.getCount(getVarKey(*tree_, var, site.func_id)) != 1) {
+      return false;
+    }
+
+    Node* step = nullptr;
+    int step_sign = 1;
+    for (Node* statement: site.loop->sons[1]->sons) {
+      if (isAssignOperator(statement) && isSameVar(statement->sons[0], var)) {
+        step = getStep(statement, step_sign);
+      }
+    }
+    if (step == nullptr || step->type != NUMBER || !findStart(site, var, counted.start)) {
+      return false;
+    }
+
+    counted.var = var;
+    counted.step = step_sign * step->value;
+    counted.trip_cnt = 0;
+    for (double value = counted.start; compare(oper_type, value, limit->value); value += counted.step) {
+      if (++counted.trip_cnt > MAX_SIMULATED_TRIPS) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<Node*> copyBody(const LoopSite& site, size_t copy_cnt) const {
+    std::vector<Node*> copies;
+
+    for (size_t copy_id = 0; copy_id < copy_cnt; ++copy_id) {
+      for (const Node* statement: site.loop->sons[1]->sons) {
+        copies.push_back(copyTree(*tree_, statement));
+      }
+    }
+    return copies;
+  }
+
+  /*
+   * The unrolled loop tests the value the local has after the last full
+   * group of copies, so it stops right there whatever the original
+   * comparison was.
+   */
+  void unrollLoop(const LoopSite& site) {
+    CountedLoop counted{nullptr, 0.0, 0.0, 0};
+
+    if (site.block == nullptr ||
+        std::find(site.block->sons.begin(), site.block->sons.end(), site.loop) == site.block->sons.end() ||
+        !findCountedLoop(site, counted)) {
+      return;
+    }
+
+    size_t max_size = MAX_UNROLLED_SIZE;
+    if (profile_ != nullptr && profile_->isColdLoop(site.loop)) {
+      return;
+    }
+    if (profile_ != nullptr && profile_->isHotLoop(site.loop)) {
+      max_size = MAX_HOT_UNROLLED_SIZE;
+    }
+
+    Tree& tree = *tree_;
+    NodeList& statements = site.block->sons;
+    size_t body_size = countNodes(tree, site.loop->sons[1]);
+
+    if (counted.trip_cnt <= MAX_FULL_TRIPS && counted.trip_cnt * body_size <= max_size) {
+      std::vector<Node*> copies = copyBody(site, counted.trip_cnt);
+      auto loop_pos = statements.erase(std::find(statements.begin(), statements.end(), site.loop));
+      statements.insert(loop_pos, copies.begin(), copies.end());
+      ++full_cnt_;
+      return;
+    }
+
+    size_t factor = factor_;
+    while (factor > 1 && factor * body_size > max_size) {
+      --factor;
+    }
+    if (factor < 2 || counted.trip_cnt < 2 * factor) {
+      return;
+    }
+
+    size_t unrolled_trips = counted.trip_cnt - counted.trip_cnt % factor;
+    double stop = counted.start;
+    for (size_t trip_id = 0; trip_id < unrolled_trips; ++trip_id) {
+      stop += counted.step;
+    }
+
+    std::vector<Node*> copies = copyBody(site, factor);
+    Node* body = tree.newNode(LOGIC, CONDITION_MET);
+    body->sons.assign(copies.begin(), copies.end());
+    Node* condition = tree.newNode(OPERATOR, counted.step > 0 ? BOOL_LOWER : BOOL_GREATER,
+                                   {copyTree(tree, counted.var), tree.newNode(NUMBER, stop)});
+    Node* unrolled = tree.newNode(LOGIC, WHILE, {tree.newNode(LOGIC, CONDITION, {condition}), body});
+
+    auto loop_pos = std::find(statements.begin(), statements.end(), site.loop);
+    if (unrolled_trips == counted.trip_cnt) {
+      *loop_pos = unrolled;
+    } else {
+      statements.insert(loop_pos, unrolled);
+    }
+    ++partial_cnt_;
+  }
+
+ public:
+  LoopUnrollPass(size_t factor, const TreeProfile* profile = nullptr): factor_(factor), profile_(profile) {}
+
+  size_t run(Tree& tree) {
+    tree_ = &tree;
+    full_cnt_ = 0;
+    partial_cnt_ = 0;
+
+    LoopFinder finder(tree);
+    finder.walk(tree.getRoot());
+    for (auto site = finder.getSites().rbegin(); site != finder.getSites().rend(); ++site) {
+      unrollLoop(*site);
+    }
+    return full_cnt_ + partial_cnt_;
+  }
+
+  std::string getReport() const {
+    return "unrolled " + std::to_string(full_cnt_) + " loops fully and " + std::to_string(partial_cnt_) +
+      " by up to " + std::to_string(factor_);
+  }
+};
+
+#endif //DED_PROG_LANG_LOOP_UNROLL_H
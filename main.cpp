@@ -1,13 +1,28 @@
 #include <cstdio>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <unordered_map>
 
 #include "exception.h"
 #include "lex_analyzer.h"
 #include "parser.h"
 #include "tree.h"
 #include "common_classes.h"
-
+#include "session.h"
+#include "flat_tree.h"
+#include "code_generator.h"
+#include "ir.h"
+#include "ir_backend.h"
+#include "ir_builder.h"
+#include "options.h"
+#include "pass_manager.h"
+#include "passes.h"
+#include "tree_analysis.h"
+#include "profile.h"
+#include "tree_profile.h"
+
+#include "asm_optimizer.h"
 #include "assembler.h"
 #include "executor.h"
 #include "visualizer.h"
@@ -20,77 +35,152 @@ void printError(const std::string& text) {
   std::cerr << "!!! " << text << '\n';
 }
 
-void myAssembler(const char* asm_filename, const char* binary_filename) {
+void myAssembler(const char* asm_filename, const char* binary_filename,
+                 std::unordered_map<std::string, int>* labels = nullptr) {
   std::cout << "assembler was started\n";
 
   SmartFile asm_file(asm_filename, "r");
   SmartFile binary_file(binary_filename, "w");
 
   try {
-    assembly(asm_file.getFile(), binary_file.getFile());
+    assembly(asm_file.getFile(), binary_file.getFile(), labels);
   } catch (ProcessorException& exc) {
     std::cerr << exc;
     exit(1);
   }
 }
 
-void myExecutor(const char* binary_filename) {
+void myExecutor(const char* binary_filename, const char* profile_filename = nullptr,
+                const std::unordered_map<std::string, int>* labels = nullptr) {
   SmartFile binary_file(binary_filename);
-
+  SmartFile profile_file;
+
+  if (profile_filename != nullptr) {
+    profile_file.setFile(profile_filename, "w");
+    if (profile_file.getFile() == nullptr) {
+      throw IncorrectArgumentException(std::string("cannot write the profile to ") + profile_filename,
+                                       __PRETTY_FUNCTION__);
+    }
+  }
   try {
-    execute(binary_file.getFile());
+    execute(binary_file.getFile(), profile_file.getFile(), labels);
   } catch (ProcessorException& exc) {
     std::cerr << exc;
     exit(1);
   }
 }
 
-void myInterpreter(const char* asm_filename, const char* binary_filename) {
+void optimizeAssembler(const char* asm_filename) {
+  AsmOptimizer optimizer;
+  SmartFile asm_file(asm_filename, "r");
+
+  optimizer.read(asm_file.getFile());
+  asm_file.setFile(asm_filename, "w");
+  optimizer.optimize();
+  optimizer.write(asm_file.getFile());
+  printLine(optimizer.getReport());
+}
+
+void myInterpreter(const char* asm_filename, const char* binary_filename, const char* profile_filename = nullptr) {
+  std::unordered_map<std::string, int> labels;
+
   try {
-    myAssembler(asm_filename, binary_filename);
-    myExecutor(binary_filename);
+    myAssembler(asm_filename, binary_filename, &labels);
+    myExecutor(binary_filename, profile_filename, &labels);
   } catch (ProcessorException& exc) {
     std::cerr << exc;
   }
 }
 
-StackAllocator<Node> Tree::allocator_ = StackAllocator<Node>();
-
+/*
+ * The tree goes to <code>_tree in the binary format; --text-tree also
+ * writes the old text dump to <code>_tree.txt for debugging. Backends
+ * other than tree print the assembler from the SSA form. A profile to use
+ * is laid over the tree before any pass runs. From -O1 on the assembler is
+ * optimized as a whole once it is written.
+ */
 void complile(int argc, char* argv[]) {
+  CompilerOptions options = parseOptions(argc, argv, 3);
   SmartFile code_file(argv[1], "r");
-  LexAnalyzer lex_analyzer(code_file.getFile());
-  std::vector<Token> tokens;
+  CompilationSession session;
+  PassManager pass_manager;
 
-  lex_analyzer.parseTokens(tokens);
+  std::unique_ptr<TreeProfile> profile;
 
-  Parser parser(tokens, Tree::allocator_);
-  Tree prog_tree = parser.makeTree();
+  session.parse(code_file.getFile());
+  if (!options.profile_use.empty()) {
+    SmartFile profile_file(options.profile_use.c_str(), "r");
+    ExecutionProfile execution_profile;
 
+    execution_profile.read(profile_file.getFile());
+    profile.reset(new TreeProfile(session.getTree(), execution_profile));
+  }
+  registerStandardPasses(pass_manager, options, profile.get());
+  if (options.explicit_passes) {
+    pass_manager.buildPipeline(options.passes);
+  } else {
+    pass_manager.buildPipeline(options.opt_level);
+  }
+  pass_manager.run(session.getTree());
+  pass_manager.printStats(std::cout);
+
+  FlatTree prog_tree(session.getTree());
+  CodeGenerator code_generator(prog_tree, options.opt_level >= 2);
+  if (options.memoize) {
+    code_generator.setMemoized(findMemoizable(session.getTree()));
+  }
 
   std::string tree_filename = std::string(argv[1]) + "_tree";
-  SmartFile tree_file(tree_filename.c_str(), "w");
+  SmartFile tree_file(tree_filename.c_str(), "wb");
+  prog_tree.writeBinary(tree_file.getFile());
+  tree_file.release();
+
+  if (options.text_tree) {
+    std::string text_tree_filename = tree_filename + ".txt";
+    SmartFile text_tree_file(text_tree_filename.c_str(), "w");
+
+    prog_tree.printTree(text_tree_file.getFile());
+  }
 
   SmartFile asm_file(argv[2], "w");
-  prog_tree.printTree(tree_file.getFile());
-  prog_tree.printAssembler(asm_file.getFile());
+  if (options.backend != "tree" || options.dump_ir) {
+    IrProgram program = IrBuilder(prog_tree).build();
+
+    if (options.dump_ir) {
+      std::string ir_filename = std::string(argv[1]) + "_ir.txt";
+      SmartFile ir_file(ir_filename.c_str(), "w");
+
+      for (const IrFunction& func: program.functions) {
+        func.print(ir_file.getFile());
+      }
+    }
+    if (options.backend != "tree") {
+      makeIrBackend(options.backend)->printProgram(program, asm_file.getFile());
+    }
+  }
+  if (options.backend == "tree") {
+    code_generator.printAssembler(asm_file.getFile());
+  }
   asm_file.release();
-  tree_file.release();
+  if (options.opt_level >= 1) {
+    optimizeAssembler(argv[2]);
+  }
+  session.printStats(std::cout);
 
   std::string binary_filename = std::string(argv[1]) + "_binary";
-  myInterpreter(argv[2], binary_filename.c_str());
+  myInterpreter(argv[2], binary_filename.c_str(),
+                options.profile_generate.empty() ? nullptr : options.profile_generate.c_str());
 }
 
 void visualize(const std::string& tree_filename) {
-  SmartFile parse_tree_file(tree_filename.c_str(), "r");
-  Visualizer visualizer(parse_tree_file.getFile());
+  Visualizer visualizer(tree_filename.c_str());
 
   visualizer.makeTree();
   visualizer.show("prog_tree.gv");
 }
 
 void translate(const std::string& tree_filename) {
-  SmartFile parse_tree_file(tree_filename.c_str(), "r");
-  Visualizer visualizer(parse_tree_file.getFile());
+  Visualizer visualizer(tree_filename.c_str());
 
   visualizer.makeTree();
   visualizer.translate("code.lolpp");
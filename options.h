@@ -0,0 +1,101 @@
+//
+// Created by mike on 23.12.18.
+//
+
+#ifndef DED_PROG_LANG_OPTIONS_H
+#define DED_PROG_LANG_OPTIONS_H
+
+#include <cctype>
+#include <cstdlib>
+#include <string>
+
+#include "exception.h"
+
+/*
+ * Command line options that follow the code and assembler file names:
+ *   -O<level>           optimization level, 0 by default
+ *   --passes=<a,b,...>  run exactly these passes instead of the level's
+ *   --text-tree         also dump the tree as text to <code>_tree.txt
+ *   --backend=<name>    tree (the default) prints assembler right from the
+ *                       tree, stack goes through the SSA form
+ *   --dump-ir           write the SSA form to <code>_ir.txt
+ *   --unroll=<factor>   copies of the body per test in unrolled loops, 4
+ *                       by default
+ *   --profile-generate=<file>
+ *                       run the program compiled by the tree backend
+ *                       without passes and write to the file how many
+ *                       times it reached every label
+ *   --profile-use=<file>
+ *                       guide inlining, the layout of ifs and unrolling
+ *                       by such a profile of the same code
+ *   --memoize           pure functions that call functions or loop keep
+ *                       their results in a table of the processor; needs
+ *                       the tree backend
+ */
+struct CompilerOptions {
+  int opt_level{0};
+  bool explicit_passes{false};
+  std::string passes;
+  bool text_tree{false};
+  std::string backend{"tree"};
+  bool dump_ir{false};
+  size_t unroll_factor{4};
+  std::string profile_generate;
+  std::string profile_use;
+  bool memoize{false};
+};
+
+bool startsWith(const std::string& str, const std::string& prefix) {
+  return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+CompilerOptions parseOptions(int argc, char* argv[], int first_arg) {
+  CompilerOptions options;
+
+  for (int arg_id = first_arg; arg_id < argc; ++arg_id) {
+    std::string arg = argv[arg_id];
+
+    if (startsWith(arg, "-O") && arg.size() == 3 && std::isdigit(arg[2])) {
+      options.opt_level = arg[2] - '0';
+    } else if (startsWith(arg, "--passes=")) {
+      options.explicit_passes = true;
+      options.passes = arg.substr(std::string("--passes=").size());
+    } else if (arg == "--text-tree") {
+      options.text_tree = true;
+    } else if (startsWith(arg, "--backend=")) {
+      options.backend = arg.substr(std::string("--backend=").size());
+    } else if (arg == "--dump-ir") {
+      options.dump_ir = true;
+    } else if (startsWith(arg, "--unroll=")) {
+      std::string factor = arg.substr(std::string("--unroll=").size());
+      char* factor_end = nullptr;
+      long value = std::strtol(factor.c_str(), &factor_end, 10);
+
+      if (factor.empty() || *factor_end != '\0' || value < 1) {
+        throw IncorrectArgumentException("unroll factor must be a positive number: " + factor, __PRETTY_FUNCTION__);
+      }
+      options.unroll_factor = static_cast<size_t>(value);
+    } else if (startsWith(arg, "--profile-generate=")) {
+      options.profile_generate = arg.substr(std::string("--profile-generate=").size());
+    } else if (startsWith(arg, "--profile-use=")) {
+      options.profile_use = arg.substr(std::string("--profile-use=").size());
+    } else if (arg == "--memoize") {
+      options.memoize = true;
+    } else {
+      throw IncorrectArgumentException("unknown option " + arg, __PRETTY_FUNCTION__);
+    }
+  }
+
+  if (!options.profile_generate.empty() &&
+      (options.opt_level != 0 || options.explicit_passes || options.backend != "tree" ||
+       !options.profile_use.empty())) {
+    throw IncorrectArgumentException("profiles are only generated by the tree backend without passes",
+                                     __PRETTY_FUNCTION__);
+  }
+  if (options.memoize && options.backend != "tree") {
+    throw IncorrectArgumentException("memoization needs the tree backend", __PRETTY_FUNCTION__);
+  }
+  return options;
+}
+
+#endif //DED_PROG_LANG_OPTIONS_H
@@ -19,8 +19,12 @@ class Parser {
   const static int MAX_BUF_SIZE = 4096;
 
   std::vector<Token> tokens_;
-  size_t token_ptr_;
-  StackAllocator<Node>& allocator_;
+  size_t token_ptr_{0};
+  Arena& arena_;
+
+  Node* newNode(NodeType type, double value, std::initializer_list<Node*> sons = {}) {
+    return tree_.newNode(type, value, sons);
+  }
 
   bool compareToken(const std::string& str) {
     return !done() && tokens_[token_ptr_].value == str;
@@ -33,7 +37,7 @@ class Parser {
     }
     if (tokens_[token_ptr_].token_type == DOUBLE ||
           tokens_[token_ptr_].token_type == INTEGER) {
-      Node* result = allocator_.init_alloc(Node(NUMBER, atof(tokens_[token_ptr_].value.c_str())));
+      Node* result = newNode(NUMBER, atof(tokens_[token_ptr_].value.c_str()));
 
       ++token_ptr_;
       return result;
@@ -41,154 +45,256 @@ class Parser {
     return nullptr;
   }
 
-  Node* getE(int func_id) {
-    LOG("getE");
-    if (done()) {
-      return nullptr;
-    }
+  enum ExprOperKind {
+    BINARY_OPER,
+    UNARY_OPER,
+    BRACKET_GROUP,
+    CALL_GROUP
+  };
 
-    try {
-      Node *cur_node = getT(func_id);
-      if (cur_node == nullptr) {
-        return nullptr;
-      }
+  struct ExprOper {
+    ExprOperKind kind;
+    LangOperator oper;
+    size_t priority;
+    Node* call_node;
+  };
 
-      while (compareToken("+") || compareToken("-") || compareToken("||") || compareToken("/") ||
-             compareToken("==") || compareToken("!=") || compareToken("<=") || compareToken(">=") ||
-             compareToken("<") || compareToken(">")) {
+  const static size_t UNARY_PRIORITY = 4;
+  const static size_t POWER_PRIORITY = 5;
 
-        std::string oper = tokens_[token_ptr_].value;
-        ++token_ptr_;
+  /*
+   * || and ^ group to the right, the rest to the left. ^ binds tighter
+   * than the unary operators, so -x^2 is -(x^2).
+   */
+  static bool isRightAssociative(size_t priority) {
+    return priority == 1 || priority == POWER_PRIORITY;
+  }
 
-        Node* next_operand = nullptr;
+  size_t getBinaryPriority() const {
+    if (done() || tokens_[token_ptr_].token_type != OPER) {
+      return 0;
+    }
+    const StringRef& oper = tokens_[token_ptr_].value;
 
-        if (oper == "||") {
-          next_operand = getE(func_id);
-        } else {
-          next_operand = getT(func_id);
-        }
+    if (oper == "||") {
+      return 1;
+    }
+    if (oper == "^") {
+      return POWER_PRIORITY;
+    }
+    if (oper == "*" || oper == "/" || oper == "&&") {
+      return 3;
+    }
+    if (oper == "+" || oper == "-" || oper == "==" || oper == "!=" ||
+        oper == "<=" || oper == ">=" || oper == "<" || oper == ">") {
+      return 2;
+    }
+    return 0;
+  }
 
-        if (next_operand == nullptr) {
-          throw IncorrectParsingException("after operator + or - should be an operand",
-                                          __PRETTY_FUNCTION__);
-        }
+  bool isOpenGroup(const ExprOper& expr_oper) const {
+    return expr_oper.kind == BRACKET_GROUP || expr_oper.kind == CALL_GROUP;
+  }
 
-        cur_node = allocator_.init_alloc(Node(OPERATOR, getOperTypeByOper(oper), {cur_node, next_operand}));
-      }
+  void reduceExpr(std::vector<Node*>& operands, std::vector<ExprOper>& opers) {
+    ExprOper expr_oper = opers.back();
+    opers.pop_back();
 
-      return cur_node;
-    } catch (InterpreterException& exc) {
-      throw exc;
+    if (expr_oper.kind == UNARY_OPER) {
+      Node* operand = operands.back();
+
+      operands.back() = newNode(OPERATOR, expr_oper.oper, {operand});
+      return;
     }
+    Node* right_operand = operands.back();
+    operands.pop_back();
+    Node* left_operand = operands.back();
+
+    operands.back() = newNode(OPERATOR, expr_oper.oper, {left_operand, right_operand});
   }
 
-  Node* getT(int func_id) {
-    LOG("getT");
+  void reduceToGroup(std::vector<Node*>& operands, std::vector<ExprOper>& opers) {
+    while (!isOpenGroup(opers.back())) {
+      reduceExpr(operands, opers);
+    }
+  }
 
-    try {
-      Node *cur_node = getP(func_id);
-      if (cur_node == nullptr) {
-        return nullptr;
-      }
+  Node* getCallHeader(int /* func_id */) {
+    if (done() || token_ptr_ + 1 == tokens_.size() || tokens_[token_ptr_ + 1].value != "(") {
+      return nullptr;
+    }
+    const StringRef& name = tokens_[token_ptr_].value;
+    Node* call_node = nullptr;
 
-      while (compareToken("*") || compareToken("/") || compareToken("&&")) {
-        std::string oper = tokens_[token_ptr_].value;
-        ++token_ptr_;
-        Node* next_operand = nullptr;
+    if (name == "sin") {
+      call_node = newNode(STANDART_FUNCTION, SIN);
+    } else if (name == "cos") {
+      call_node = newNode(STANDART_FUNCTION, COS);
+    } else if (name == "sqrt") {
+      call_node = newNode(STANDART_FUNCTION, SQ_ROOT);
+    } else if (tokens_[token_ptr_].token_type != KEYWORD && isCorrectVariable(name) &&
+               tree_.getFunctionId(name) != -1) {
+      Node* func_node = newNode(USER_FUNCTION, tree_.getFunctionId(name));
 
-        if (oper == "||") {
-          next_operand = getE(func_id);
-        } else {
-          next_operand = getP(func_id);
-        }
+      call_node = newNode(STANDART_FUNCTION, CALL, {func_node});
+    } else {
+      return nullptr;
+    }
+    token_ptr_ += 2;
+    return call_node;
+  }
 
-        if (next_operand == nullptr) {
-          throw IncorrectParsingException("after operator * or / should be an operand",
-                                          __PRETTY_FUNCTION__);
-        }
-        cur_node = allocator_.init_alloc(Node(OPERATOR, getOperTypeByOper(oper), {cur_node, next_operand}));
-      }
+  bool isCallAhead(int func_id) {
+    size_t was_ptr = token_ptr_;
+    Node* call_node = getCallHeader(func_id);
 
-      return cur_node;
-    } catch (InterpreterException& exc) {
-      throw exc;
+    token_ptr_ = was_ptr;
+    return call_node != nullptr;
+  }
+
+  void closeCallGroup(std::vector<Node*>& operands, std::vector<ExprOper>& opers, bool has_arg) {
+    Node* call_node = opers.back().call_node;
+    opers.pop_back();
+
+    if (has_arg) {
+      call_node->sons.push_back(operands.back());
+      operands.pop_back();
+    }
+    if (call_node->value != CALL && call_node->sons.size() != 1) {
+      throw IncorrectParsingException("builtin function requires exactly one argument",
+                                      __PRETTY_FUNCTION__);
     }
+    operands.push_back(call_node);
   }
 
-  Node* getP(int func_id) {
-    LOG("getP");
+  /*
+   * Operator precedence parser for E. Brackets and call arguments are kept
+   * as groups on the operator stack, so nesting depth is bounded by the heap
+   * and not by the native stack.
+   */
+  Node* getE(int func_id) {
+    LOG("getE");
+    if (done()) {
+      return nullptr;
+    }
 
-    try {
-      Node* expr = nullptr;
+    size_t was_ptr = token_ptr_;
+    std::vector<Node*> operands;
+    std::vector<ExprOper> opers;
+    size_t open_group_cnt = 0;
+    bool expect_operand = true;
 
-      if (compareToken("(")) {
-        ++token_ptr_;
-        expr = getE(func_id);
-        if (expr == nullptr) {
-          --token_ptr_;
-          return nullptr;
+    while (true) {
+      if (expect_operand) {
+        if (getStr("!")) {
+          opers.push_back({UNARY_OPER, BOOL_NOT, UNARY_PRIORITY, nullptr});
+          continue;
+        }
+        if (getStr("-")) {
+          opers.push_back({UNARY_OPER, MINUS, UNARY_PRIORITY, nullptr});
+          continue;
+        }
+        if (getStr("(")) {
+          opers.push_back({BRACKET_GROUP, EQUAL, 0, nullptr});
+          ++open_group_cnt;
+          continue;
+        }
+        if (compareToken(")") && !opers.empty() && opers.back().kind == CALL_GROUP &&
+            opers.back().call_node->value == CALL && opers.back().call_node->sons.size() == 1) {
+          ++token_ptr_;
+          closeCallGroup(operands, opers, false);
+          --open_group_cnt;
+          expect_operand = false;
+          continue;
         }
 
-        LOG(token_ptr_);
-        if (!compareToken(")")) {
-          throw IncorrectParsingException(") was expected",
-                                          __PRETTY_FUNCTION__);
+        Node* operand = getN();
+
+        if (operand == nullptr) {
+          operand = getParam(func_id, false);
+        }
+        if (operand == nullptr) {
+          operand = getId(func_id);
+        }
+        if (operand == nullptr) {
+          Node* call_node = getCallHeader(func_id);
+
+          if (call_node != nullptr) {
+            opers.push_back({CALL_GROUP, EQUAL, 0, call_node});
+            ++open_group_cnt;
+            continue;
+          }
+        }
+        if (operand == nullptr) {
+          if (operands.empty() && opers.size() == open_group_cnt && opers.size() <= 1) {
+            token_ptr_ = was_ptr;
+            return nullptr;
+          }
+          throw IncorrectParsingException("an operand was expected", __PRETTY_FUNCTION__);
         }
-        ++token_ptr_;
-        return expr;
-      }
 
-      if (getStr("!")) {
-        expr = allocator_.init_alloc(Node{OPERATOR, BOOL_NOT, {getP(func_id)}});
-      } else if (getStr("-")) {
-        expr = allocator_.init_alloc(Node{OPERATOR, MINUS, {getP(func_id)}});
+        operands.push_back(operand);
+        expect_operand = false;
+        continue;
       }
 
-      if (expr == nullptr) {
-        expr = getN();
-      }
-      if (expr == nullptr) {
-        expr = getParam(func_id, false);
-      }
-      if (expr == nullptr) {
-        expr = getId(func_id);
-      }
-      if (expr == nullptr) {
-        expr = getFuncCall(func_id);
+      size_t priority = getBinaryPriority();
+
+      if (priority != 0) {
+        while (!opers.empty() && !isOpenGroup(opers.back()) &&
+               (opers.back().priority > priority ||
+                (opers.back().priority == priority && !isRightAssociative(priority)))) {
+          reduceExpr(operands, opers);
+        }
+        opers.push_back({BINARY_OPER, getOperTypeByOper(tokens_[token_ptr_].value), priority, nullptr});
+        ++token_ptr_;
+        expect_operand = true;
+        continue;
       }
 
-      return expr;
-    } catch (InterpreterException& exc) {
-      throw exc;
-    }
-  }
+      if (compareToken(")") && open_group_cnt != 0) {
+        ++token_ptr_;
+        reduceToGroup(operands, opers);
 
-  Node* getFuncCall(int func_id) {
-    Node* func_node = nullptr;
+        if (opers.back().kind == CALL_GROUP) {
+          closeCallGroup(operands, opers, true);
+        } else {
+          opers.pop_back();
+        }
+        --open_group_cnt;
+        continue;
+      }
+
+      if (compareToken(",") && open_group_cnt != 0) {
+        reduceToGroup(operands, opers);
 
-    if (func_node == nullptr) {
-      func_node = getSin(func_id);
+        if (opers.back().kind != CALL_GROUP || opers.back().call_node->value != CALL) {
+          throw IncorrectParsingException(", is allowed only between function arguments",
+                                          __PRETTY_FUNCTION__);
+        }
+        ++token_ptr_;
+        opers.back().call_node->sons.push_back(operands.back());
+        operands.pop_back();
+        expect_operand = true;
+        continue;
+      }
+      break;
     }
-    if (func_node == nullptr) {
-      func_node = getCos(func_id);
+
+    if (open_group_cnt != 0) {
+      throw IncorrectParsingException(") was expected", __PRETTY_FUNCTION__);
     }
-    if (func_node == nullptr) {
-      func_node = getSqrt(func_id);
+    while (!opers.empty()) {
+      reduceExpr(operands, opers);
     }
-    if (func_node == nullptr) {
-      func_node = getFuncHeader(func_id, false);
-      if (func_node == nullptr) {
-        return nullptr;
-      }
-      Node* call_node = allocator_.init_alloc(Node{STANDART_FUNCTION, CALL, {func_node}});
+    return operands.back();
+  }
 
-      for (size_t param_id = 0; param_id < func_node->sons.size(); ++param_id) {
-        call_node->sons.push_back(func_node->sons[param_id]);
-      }
-      func_node->sons.clear();
-      return call_node;
+  Node* getFuncCall(int func_id) {
+    if (!isCallAhead(func_id)) {
+      return nullptr;
     }
-    return func_node;
+    return getE(func_id);
   }
 
   bool isVariableNameBegin(char ch) const {
@@ -199,7 +305,7 @@ class Parser {
     return isVariableNameBegin(ch) || ch == '_' || isdigit(ch);
   }
 
-  bool isCorrectVariable(const std::string& str) const {
+  bool isCorrectVariable(const StringRef& str) const {
     bool correct_name = isVariableNameBegin(str[0]);
 
     for (char ch: str) {
@@ -212,7 +318,7 @@ class Parser {
     if (done() || tokens_[token_ptr_].token_type == KEYWORD) {
       return nullptr;
     }
-    const std::string& cur_token = tokens_[token_ptr_].value;
+    const StringRef& cur_token = tokens_[token_ptr_].value;
 
     LOG("getId");
     LOG(std::to_string(token_ptr_));
@@ -241,15 +347,15 @@ class Parser {
         node_type = LOCAL_VARIABLE;
       }
       LOG("I want to add var");
-      local_address = tree_.addVariable(cur_token, func_id, allocator_.init_alloc(Node{NUMBER, 0}));
+      local_address = tree_.addVariable(cur_token, func_id, newNode(NUMBER, 0));
       LOG(std::string("its address is ") + std::to_string(local_address));
       LOG("getId on finish line");
     }
 
     if (local_address != -1) {
-      return allocator_.init_alloc(Node(node_type, local_address));
+      return newNode(node_type, local_address);
     } else {
-      return allocator_.init_alloc(Node(node_type, global_address));
+      return newNode(node_type, global_address);
     }
   }
 
@@ -266,7 +372,7 @@ class Parser {
       }
 
       Node* var_node = getId(func_id, true);
-      Node* value_node = allocator_.init_alloc(Node(NUMBER, 0.0));
+      Node* value_node = newNode(NUMBER, 0.0);
 
       if (var_node == nullptr) {
         throw IncorrectParsingException(std::string("after ") + type + " should be a variable name",
@@ -356,7 +462,7 @@ class Parser {
       if (!getStr(")")) {
         throw IncorrectParsingException(") was expected after scan", __PRETTY_FUNCTION__);
       }
-      return allocator_.init_alloc(Node(STANDART_FUNCTION, INPUT, {var_node}));
+      return newNode(STANDART_FUNCTION, INPUT, {var_node});
     } catch (InterpreterException& exc) {
       throw exc;
     }
@@ -365,7 +471,7 @@ class Parser {
   Node* getPrint(int func_id) {
     LOG("getPrint");
     LOG(std::to_string(token_ptr_));
-    const std::string& cur_token = tokens_[token_ptr_].value;
+    const StringRef& cur_token = tokens_[token_ptr_].value;
 
     try {
       if (cur_token != "print") {
@@ -388,7 +494,7 @@ class Parser {
         throw IncorrectParsingException(") was expected after print", __PRETTY_FUNCTION__);
       }
       ++token_ptr_;
-      return allocator_.init_alloc(Node(STANDART_FUNCTION, OUTPUT, {expr_node}));
+      return newNode(STANDART_FUNCTION, OUTPUT, {expr_node});
     } catch (InterpreterException& exc) {
       throw exc;
     }
@@ -436,7 +542,7 @@ class Parser {
         throw IncorrectParsingException("an expression was expected after =", __PRETTY_FUNCTION__);
       }
 
-      return allocator_.init_alloc(Node(OPERATOR, oper_type, {var_node, expr_node}));
+      return newNode(OPERATOR, oper_type, {var_node, expr_node});
     } catch (InterpreterException& exc) {
       throw exc;
     }
@@ -450,9 +556,9 @@ class Parser {
     }
     Node* result_node = getE(func_id);
     if (result_node == nullptr) {
-      return allocator_.init_alloc(Node{RETURN, 0});
+      return newNode(RETURN, 0);
     } else {
-      return allocator_.init_alloc(Node{RETURN, 0, {result_node}});
+      return newNode(RETURN, 0, {result_node});
     }
   }
 
@@ -480,12 +586,6 @@ class Parser {
       if (node == nullptr) {
         node = getA(func_id);
       }
-      if (node == nullptr) {
-        node = getLogic(func_id, "if");
-      }
-      if (node == nullptr) {
-        node = getLogic(func_id, "while");
-      }
       if (node == nullptr) {
         node = getFuncCall(func_id);
       }
@@ -497,7 +597,7 @@ class Parser {
         return nullptr;
       }
 
-      if (node->type != LOGIC && !getStr(";")) {
+      if (!getStr(";")) {
         std::cout << token_ptr_ << '\n';
         std::cout << tokens_[token_ptr_].value << '\n';
         throw IncorrectParsingException("where ; ???", __PRETTY_FUNCTION__);
@@ -519,7 +619,7 @@ class Parser {
 
   Node* getVarInit(int func_id) {
     if (func_id == -1) {
-      tree_.getRoot()->sons[0] = allocator_.init_alloc(Node{VAR_INIT, 0});
+      tree_.getRoot()->sons[0] = newNode(VAR_INIT, 0);
     }
 
     Node* cur_var = getV(func_id);
@@ -533,95 +633,106 @@ class Parser {
     return nullptr;
   }
 
-  Node* getElse(int func_id) {
-    if (!getStr("else")) {
+  Node* getLogicHeader(int func_id, const std::string& oper) {
+    if (!getStr(oper)) {
       return nullptr;
     }
-    if (!getStr("lol")) {
-      throw IncorrectParsingException("where is lol???", __PRETTY_FUNCTION__);
+
+    LOG(oper);
+    if (!getStr("(")) {
+      throw IncorrectParsingException(std::string("( was expected after ") + oper,
+                                      __PRETTY_FUNCTION__);
     }
-    Node* else_node = allocator_.init_alloc(Node{LOGIC, ELSE});
-    Node* g_node = getG(func_id);
 
-    while (g_node != nullptr) {
-      LOG("getG from else");
-      else_node->sons.push_back(g_node);
-      g_node = getG(func_id);
+    Node *expr_node = getE(func_id);
+
+    if (expr_node == nullptr) {
+      throw IncorrectParsingException(std::string("logic expression was expected in") + oper,
+                                      __PRETTY_FUNCTION__);
     }
-    if (!getStr("kek")) {
-      throw IncorrectParsingException("where is kek???", __PRETTY_FUNCTION__);
+
+    Node* condition_node = newNode(LOGIC, CONDITION, {expr_node});
+
+    if (!getStr(")")) {
+      throw IncorrectParsingException(") was expected after (", __PRETTY_FUNCTION__);
+    }
+    if (!getStr("lol")) {
+      throw IncorrectParsingException("where is lol???", __PRETTY_FUNCTION__);
     }
-    return else_node;
+
+    Node* condition_met_node = newNode(LOGIC, CONDITION_MET);
+
+    return newNode(LOGIC, static_cast<double>(oper == "if" ? IF : WHILE),
+                                      {condition_node, condition_met_node});
   }
 
-  Node* getLogic(int func_id, const std::string& oper) {
-    try {
-      if (!getStr(oper)) {
-        return nullptr;
-      }
+  struct OpenBlock {
+    Node* block_node;
+    Node* logic_node;
+  };
 
-      LOG(oper);
-      if (!getStr("(")) {
-        throw IncorrectParsingException(std::string("( was expected after ") + oper,
-                                        __PRETTY_FUNCTION__);
-      }
+  /*
+   * Parses statements up to the kek which closes body_node. Nested if, else
+   * and while blocks are kept on an explicit stack, the closing kek of the
+   * body itself is left for the caller.
+   */
+  void getBody(int func_id, Node* body_node) {
+    std::vector<OpenBlock> blocks{{body_node, nullptr}};
 
-      Node *expr_node = getE(func_id);
+    while (true) {
+      if (compareToken("kek")) {
+        if (blocks.size() == 1) {
+          return;
+        }
+        OpenBlock closed_block = blocks.back();
 
-      if (expr_node == nullptr) {
-        throw IncorrectParsingException(std::string("logic expression was expected in") + oper,
-                                        __PRETTY_FUNCTION__);
+        blocks.pop_back();
+        ++token_ptr_;
+
+        if (closed_block.logic_node->value == IF && closed_block.block_node->value == CONDITION_MET &&
+            getStr("else")) {
+          if (!getStr("lol")) {
+            throw IncorrectParsingException("where is lol???", __PRETTY_FUNCTION__);
+          }
+          Node* else_node = newNode(LOGIC, ELSE);
+
+          closed_block.logic_node->sons.push_back(else_node);
+          blocks.push_back({else_node, closed_block.logic_node});
+        }
+        continue;
       }
 
-      Node* condition_node = allocator_.init_alloc(Node{LOGIC, CONDITION, {expr_node}});
+      Node* logic_node = getLogicHeader(func_id, "if");
 
-      if (!getStr(")")) {
-        throw IncorrectParsingException(") was expected after (", __PRETTY_FUNCTION__);
+      if (logic_node == nullptr) {
+        logic_node = getLogicHeader(func_id, "while");
       }
-      if (!getStr("lol")) {
-        throw IncorrectParsingException("where is lol???", __PRETTY_FUNCTION__);
+      if (logic_node != nullptr) {
+        blocks.back().block_node->sons.push_back(logic_node);
+        blocks.push_back({logic_node->sons[1], logic_node});
+        continue;
       }
 
-      Node* condition_met_node = allocator_.init_alloc(Node{LOGIC, CONDITION_MET});
       Node* g_node = getG(func_id);
 
-      while (g_node != nullptr) {
-        LOG(std::string("getG from ") + oper);
-        condition_met_node->sons.push_back(g_node);
-        g_node = getG(func_id);
-      }
-
-      if (!getStr("kek")) {
+      if (g_node == nullptr) {
         LOG(std::to_string(token_ptr_));
-        LOG(tokens_[token_ptr_].value);
         throw IncorrectParsingException("where is kek???", __PRETTY_FUNCTION__);
       }
-
-      Node* result_node = allocator_.init_alloc(Node{LOGIC, (oper == "if" ? IF : WHILE),
-                                                    {condition_node, condition_met_node}});
-      if (oper == "if") {
-        Node* else_node = getElse(func_id);
-
-        if (else_node != nullptr) {
-          result_node->sons.push_back(else_node);
-        }
+      if (blocks.size() != 1 || g_node->type != VAR_INIT) {
+        blocks.back().block_node->sons.push_back(g_node);
       }
-
-      return result_node;
-    } catch (InterpreterException& exc) {
-      throw exc;
     }
   }
 
-
-  std::pair<std::string, int> getFuncName(bool add_func = false, Node* func_node = nullptr) {
+  std::pair<StringRef, int> getFuncName(bool add_func = false, Node* func_node = nullptr) {
     LOG(tokens_[token_ptr_].value);
 
     if (done() || tokens_[token_ptr_].token_type == KEYWORD) {
       return {"", -1};
     }
 
-    std::string func_name = tokens_[token_ptr_].value;
+    StringRef func_name = tokens_[token_ptr_].value;
     int func_id = tree_.getFunctionId(func_name);
 
     if ((!add_func && func_id == -1) || !isCorrectVariable(func_name)) {
@@ -648,7 +759,7 @@ class Parser {
       return nullptr;
     }
 
-    std::string param_name = tokens_[token_ptr_].value;
+    StringRef param_name = tokens_[token_ptr_].value;
     int param_id = tree_.getParamId(param_name, func_id);
 
     if (!isCorrectVariable(param_name) || (!add_param && param_id == -1)) {
@@ -670,12 +781,12 @@ class Parser {
       param_id = tree_.addParam(param_name, func_id);
     }
 
-    return allocator_.init_alloc(Node(PARAM, param_id));
+    return newNode(PARAM, param_id);
   }
 
-  Node* getFuncHeader(int cur_func, bool add_func = false) {
-    Node* func_node = allocator_.init_alloc(Node{USER_FUNCTION, 0});
-    std::pair<std::string, int> func_id = getFuncName(add_func, func_node);
+  Node* getFuncHeader() {
+    Node* func_node = newNode(USER_FUNCTION, 0);
+    std::pair<StringRef, int> func_id = getFuncName(true, func_node);
 
     if (func_id.first.empty()) {
       return nullptr;
@@ -686,25 +797,13 @@ class Parser {
     if (!getStr("(")) {
       throw IncorrectParsingException("( was expected after function name", __PRETTY_FUNCTION__);
     }
-    if (add_func) {
-      Node* param_node = getParam(func_id.second, add_func);
+    Node* param_node = getParam(func_id.second, true);
 
-      while (param_node != nullptr) {
-        if (!getStr(",")) {
-          break;
-        }
-        param_node = getParam(func_id.second, add_func);
-      }
-    } else {
-      Node* e_node = getE(cur_func);
-
-      while (e_node != nullptr) {
-        func_node->sons.push_back(e_node);
-        if (!getStr(",")) {
-          break;
-        }
-        e_node = getE(cur_func);
+    while (param_node != nullptr) {
+      if (!getStr(",")) {
+        break;
       }
+      param_node = getParam(func_id.second, true);
     }
 
     if (!getStr(")")) {
@@ -721,7 +820,7 @@ class Parser {
       }
 
       LOG(std::string("getFunc ") + std::to_string(token_ptr_));
-      Node* func_node = getFuncHeader(-1, true);
+      Node* func_node = getFuncHeader();
 
       if (func_node == nullptr) {
         throw IncorrectParsingException("function name was expected after func", __PRETTY_FUNCTION__);
@@ -731,15 +830,9 @@ class Parser {
         throw IncorrectParsingException("where is lol???", __PRETTY_FUNCTION__);
       }
 
-      func_node->sons.push_back(allocator_.init_alloc(Node{VAR_INIT, 0}));
+      func_node->sons.push_back(newNode(VAR_INIT, 0));
 
-      Node* g_node = getG(func_node->value);
-      while (g_node != nullptr) {
-        if (g_node->type != VAR_INIT) {
-          func_node->sons.push_back(g_node);
-        }
-        g_node = getG(func_node->value);
-      }
+      getBody(func_node->value, func_node);
 
       if (!getStr("kek")) {
         throw IncorrectParsingException("where is kek???", __PRETTY_FUNCTION__);
@@ -753,7 +846,7 @@ class Parser {
 
   Node* getFuncs() {
     try {
-      Node *func_init = allocator_.init_alloc(Node{FUNCS, 0});
+      Node *func_init = newNode(FUNCS, 0);
       Node *cur_func = getFunc();
 
       while (cur_func != nullptr) {
@@ -788,18 +881,12 @@ class Parser {
                                         __PRETTY_FUNCTION__);
       }
 
-      Node* main_node = allocator_.init_alloc(Node(MAIN, 0.0));
+      Node* main_node = newNode(MAIN, 0.0);
 
       int func_id = tree_.addFunction("main", main_node);
-      main_node->sons.push_back(allocator_.init_alloc(Node{VAR_INIT, 0.0}));
+      main_node->sons.push_back(newNode(VAR_INIT, 0.0));
 
-      Node* g_node = getG(func_id);
-      while (g_node != nullptr) {
-        if (g_node->type != VAR_INIT) {
-          main_node->sons.push_back(g_node);
-        }
-        g_node = getG(func_id);
-      }
+      getBody(func_id, main_node);
 
       if (!getStr("kek")) {
         throw IncorrectParsingException("where is kek????",
@@ -816,9 +903,9 @@ class Parser {
   Node* getRoot() {
     try {
       LOG("getRoot");
-      tree_.setRoot(allocator_.init_alloc(Node{ROOT, 0.0, {nullptr, nullptr, nullptr}}));
+      tree_.setRoot(newNode(ROOT, 0.0, {nullptr, nullptr, nullptr}));
 
-      tree_.getRoot()->sons[0] = allocator_.init_alloc(Node{VAR_INIT, 0});
+      tree_.getRoot()->sons[0] = newNode(VAR_INIT, 0);
       getVarInit(-1);
       tree_.getRoot()->sons[1] = getFuncs();
       tree_.getRoot()->sons[2] = getMain();
@@ -834,44 +921,6 @@ class Parser {
     }
   }
 
-  Node* getBuiltinFunc(int func_id, const std::string& str, StandartFunction func_type) {
-    Node* result = allocator_.init_alloc(Node(STANDART_FUNCTION, func_type, {nullptr}));
-
-
-    if (!getStr(str)) {
-      return nullptr;
-    }
-    if (!getStr("(")) {
-      throw IncorrectParsingException(std::string("was expected ( after ") + str,
-                                      __PRETTY_FUNCTION__);
-    }
-    Node* expr_node = getE(func_id);
-
-    if (expr_node == nullptr) {
-      throw IncorrectParsingException(str + " requires an argument",
-                                      __PRETTY_FUNCTION__);
-    }
-    if (!getStr(")")) {
-      throw IncorrectParsingException(std::string("was expected _ after ") + str,
-                                      __PRETTY_FUNCTION__);
-    }
-
-    result->sons[0] = expr_node;
-    return result;
-  }
-
-  Node* getSin(int func_id) {
-    return getBuiltinFunc(func_id, "sin", SIN);
-  }
-
-  Node* getCos(int func_id) {
-    return getBuiltinFunc(func_id, "cos", COS);
-  }
-
-  Node* getSqrt(int func_id) {
-    return getBuiltinFunc(func_id, "sqrt", SQ_ROOT);
-  }
-
   Tree tree_;
 
  public:
@@ -880,8 +929,8 @@ class Parser {
     return token_ptr_ == tokens_.size();
   }
 
-  Parser(const std::vector<Token>& tokens, StackAllocator<Node>& allocator):
-      allocator_(allocator) {
+  Parser(const std::vector<Token>& tokens, Arena& arena):
+      arena_(arena), tree_(arena) {
     tokens_ = tokens;
   }
 
@@ -0,0 +1,150 @@
+//
+// Created by mike on 23.12.18.
+//
+
+#ifndef DED_PROG_LANG_PASS_MANAGER_H
+#define DED_PROG_LANG_PASS_MANAGER_H
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "exception.h"
+#include "tree.h"
+#include "tree_visitor.h"
+
+/*
+ * One step of the middle end. run changes the tree in place and returns the
+ * number of changes it made, which only goes to the statistics.
+ */
+class Pass {
+ public:
+  virtual ~Pass() {}
+
+  virtual size_t run(Tree& tree) = 0;
+
+  /*
+   * Pass specific summary of the last run, printed after its statistics.
+   */
+  virtual std::string getReport() const {
+    return "";
+  }
+};
+
+/*
+ * Runs an ordered list of named passes over a tree. Passes are registered
+ * with the lowest optimization level that enables them; the pipeline is
+ * either every pass enabled at the chosen level, in registration order, or
+ * an explicit comma separated list of names.
+ */
+class PassManager {
+ private:
+  struct PassInfo {
+    std::string name;
+    int min_opt_level;
+    std::function<Pass*()> factory;
+  };
+
+  struct PassStats {
+    std::string name;
+    double time_ms;
+    size_t nodes_before;
+    size_t nodes_after;
+    size_t change_cnt;
+    std::string report;
+  };
+
+  std::vector<PassInfo> registry_;
+  std::vector<std::pair<std::string, std::unique_ptr<Pass>>> pipeline_;
+  std::vector<PassStats> stats_;
+
+  const PassInfo& findPass(const std::string& name) const {
+    for (const PassInfo& info: registry_) {
+      if (info.name == name) {
+        return info;
+      }
+    }
+
+    std::string known_names;
+    for (const PassInfo& info: registry_) {
+      known_names += " " + info.name;
+    }
+    throw IncorrectArgumentException("no such pass: " + name + ", known passes:" + known_names,
+                                     __PRETTY_FUNCTION__);
+  }
+
+  void addToPipeline(const PassInfo& info) {
+    pipeline_.emplace_back(info.name, std::unique_ptr<Pass>(info.factory()));
+  }
+
+ public:
+  void registerPass(const std::string& name, int min_opt_level, std::function<Pass*()> factory) {
+    registry_.push_back({name, min_opt_level, factory});
+  }
+
+  void buildPipeline(int opt_level) {
+    pipeline_.clear();
+    for (const PassInfo& info: registry_) {
+      if (info.min_opt_level <= opt_level) {
+        addToPipeline(info);
+      }
+    }
+  }
+
+  void buildPipeline(const std::string& pass_list) {
+    size_t begin = 0;
+
+    pipeline_.clear();
+    while (begin <= pass_list.size()) {
+      size_t end = pass_list.find(',', begin);
+
+      if (end == std::string::npos) {
+        end = pass_list.size();
+      }
+      if (end != begin) {
+        addToPipeline(findPass(pass_list.substr(begin, end - begin)));
+      }
+      begin = end + 1;
+    }
+  }
+
+  void run(Tree& tree) {
+    for (auto& named_pass: pipeline_) {
+      PassStats stats{named_pass.first, 0.0, countNodes(tree, tree.getRoot()), 0, 0, ""};
+      auto start = std::chrono::steady_clock::now();
+
+      stats.change_cnt = named_pass.second->run(tree);
+
+      auto finish = std::chrono::steady_clock::now();
+      stats.time_ms = std::chrono::duration<double, std::milli>(finish - start).count();
+      stats.nodes_after = countNodes(tree, tree.getRoot());
+      stats.report = named_pass.second->getReport();
+      stats_.push_back(stats);
+    }
+  }
+
+  void printStats(std::ostream& os) const {
+    char line[256];
+    double total_ms = 0.0;
+
+    for (const PassStats& stats: stats_) {
+      snprintf(line, sizeof(line), "# pass %-12s %9.3f ms, nodes %zu -> %zu, %zu changes\n",
+               stats.name.c_str(), stats.time_ms, stats.nodes_before, stats.nodes_after, stats.change_cnt);
+      os << line;
+      if (!stats.report.empty()) {
+        os << "#   " << stats.report << '\n';
+      }
+      total_ms += stats.time_ms;
+    }
+    if (!stats_.empty()) {
+      snprintf(line, sizeof(line), "# passes total %9.3f ms\n", total_ms);
+      os << line;
+    }
+  }
+};
+
+#endif //DED_PROG_LANG_PASS_MANAGER_H
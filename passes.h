@@ -0,0 +1,55 @@
+//
+// Created by mike on 23.12.18.
+//
+
+#ifndef DED_PROG_LANG_PASSES_H
+#define DED_PROG_LANG_PASSES_H
+
+#include "branch_layout.h"
+#include "constant_folding.h"
+#include "common_subexpr.h"
+#include "dead_code.h"
+#include "function_merging.h"
+#include "inliner.h"
+#include "loop_invariant.h"
+#include "loop_unroll.h"
+#include "options.h"
+#include "pass_manager.h"
+#include "specialization.h"
+#include "strength_reduction.h"
+#include "tree_profile.h"
+#include "verify_pass.h"
+
+/*
+ * Every pass the compiler knows, in pipeline order, with the optimization
+ * level that turns it on. Passes with a level above the highest one are
+ * only run when named in --passes.
+ */
+const int MAX_OPT_LEVEL = 3;
+
+/*
+ * profile may be nullptr. The layout of ifs only pays off in the tree
+ * backend, the SSA form would evaluate the not it adds.
+ */
+void registerStandardPasses(PassManager& pass_manager, const CompilerOptions& options, TreeProfile* profile) {
+  size_t unroll_factor = options.unroll_factor;
+  TreeProfile* layout_profile = (options.backend == "tree" ? profile : nullptr);
+
+  pass_manager.registerPass("layout", 1, [layout_profile]() -> Pass* {
+    return new BranchLayoutPass(layout_profile);
+  });
+  pass_manager.registerPass("merge", 1, []() -> Pass* { return new FunctionMergingPass(); });
+  pass_manager.registerPass("inline", 2, [profile]() -> Pass* { return new InlinePass(profile); });
+  pass_manager.registerPass("specialize", 3, []() -> Pass* { return new SpecializationPass(); });
+  pass_manager.registerPass("unroll", 3, [unroll_factor, profile]() -> Pass* {
+    return new LoopUnrollPass(unroll_factor, profile);
+  });
+  pass_manager.registerPass("fold", 1, []() -> Pass* { return new ConstantFoldingPass(); });
+  pass_manager.registerPass("dce", 1, []() -> Pass* { return new DeadCodePass(); });
+  pass_manager.registerPass("licm", 2, []() -> Pass* { return new LoopInvariantPass(); });
+  pass_manager.registerPass("strength", 2, []() -> Pass* { return new StrengthReductionPass(); });
+  pass_manager.registerPass("cse", 2, []() -> Pass* { return new CommonSubexprPass(); });
+  pass_manager.registerPass("verify", MAX_OPT_LEVEL + 1, []() -> Pass* { return new VerifyPass(); });
+}
+
+#endif //DED_PROG_LANG_PASSES_H
@@ -0,0 +1,63 @@
+//
+// Created by mike on 01.01.19.
+//
+
+#ifndef DED_PROG_LANG_PROFILE_H
+#define DED_PROG_LANG_PROFILE_H
+
+#include <cstdio>
+#include <map>
+#include <string>
+
+#include "exception.h"
+
+/*
+ * What a run of the program left behind: how many times control reached
+ * every label of its assembler. The file has one "<label> <count>" line
+ * per label.
+ */
+class ExecutionProfile {
+ private:
+  static const size_t MAX_LABEL_SIZE = 255;
+
+  std::map<std::string, size_t> label_counts_;
+
+ public:
+  void setCount(const std::string& label, size_t count) {
+    label_counts_[label] = count;
+  }
+
+  bool hasLabel(const std::string& label) const {
+    return label_counts_.find(label) != label_counts_.end();
+  }
+
+  size_t getCount(const std::string& label) const {
+    auto found = label_counts_.find(label);
+
+    return found == label_counts_.end() ? 0 : found->second;
+  }
+
+  void write(FILE* file) const {
+    for (const auto& label_count: label_counts_) {
+      fprintf(file, "%s %zu\n", label_count.first.c_str(), label_count.second);
+    }
+  }
+
+  void read(FILE* file) {
+    if (file == nullptr) {
+      throw IncorrectArgumentException("cannot open the profile", __PRETTY_FUNCTION__);
+    }
+
+    char label[MAX_LABEL_SIZE + 1] = "";
+    size_t count = 0;
+    int read_cnt = 0;
+    while ((read_cnt = fscanf(file, "%255s %zu", label, &count)) == 2) {
+      label_counts_[label] = count;
+    }
+    if (read_cnt != EOF) {
+      throw IncorrectArgumentException(std::string("broken profile line at ") + label, __PRETTY_FUNCTION__);
+    }
+  }
+};
+
+#endif //DED_PROG_LANG_PROFILE_H
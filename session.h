@@ -0,0 +1,57 @@
+//
+// Created by mike on 13.12.18.
+//
+
+#ifndef DED_PROG_LANG_SESSION_H
+#define DED_PROG_LANG_SESSION_H
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "arena.h"
+#include "lex_analyzer.h"
+#include "parser.h"
+#include "tree.h"
+
+/*
+ * Everything one compilation allocates: tokens, their text, the tree and
+ * its symbol names live in the session's arena and are dropped together
+ * with the session.
+ */
+class CompilationSession {
+ private:
+  Arena arena_;
+  std::vector<Token> tokens_;
+  Tree tree_;
+
+ public:
+  CompilationSession(): tree_(arena_) {}
+
+  CompilationSession(const CompilationSession& another) = delete;
+  CompilationSession& operator=(const CompilationSession& another) = delete;
+
+  void parse(FILE* code_file) {
+    LexAnalyzer lex_analyzer(code_file, arena_);
+
+    lex_analyzer.parseTokens(tokens_);
+
+    Parser parser(tokens_, arena_);
+    tree_ = parser.makeTree();
+  }
+
+  Tree& getTree() {
+    return tree_;
+  }
+
+  Arena& getArena() {
+    return arena_;
+  }
+
+  void printStats(std::ostream& os) const {
+    os << "# session: " << tokens_.size() << " tokens\n";
+    arena_.printStats(os);
+  }
+};
+
+#endif //DED_PROG_LANG_SESSION_H
@@ -0,0 +1,191 @@
+//
+// Created by mike on 02.01.19.
+//
+
+#ifndef DED_PROG_LANG_SPECIALIZATION_H
+#define DED_PROG_LANG_SPECIALIZATION_H
+
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_analysis.h"
+#include "tree_visitor.h"
+
+/*
+ * Specializes functions on the constant arguments of their calls. A call
+ * that passes numbers for parameters the callee never writes goes to a
+ * copy of the callee with those parameters replaced by the numbers and
+ * dropped from its parameter list; calls with the same numbers share the
+ * copy, and calls in copies are specialized in turn. The passes that run
+ * later fold what the numbers make constant. At most MAX_COPIES copies are
+ * made, MAX_COPIES_PER_FUNCTION of one function, and only of functions up
+ * to MAX_COPIED_SIZE nodes.
+ */
+class SpecializationPass : public Pass {
+ private:
+  static const size_t MAX_COPIES = 16;
+  static const size_t MAX_COPIES_PER_FUNCTION = 4;
+  static const size_t MAX_COPIED_SIZE = 160;
+
+  /*
+   * The callee and the numbers passed for its parameters, by parameter.
+   */
+  typedef std::pair<int, std::vector<std::pair<int, double>>> CopyKey;
+
+  class ConstantCallFinder : public TreeVisitor {
+   private:
+    std::vector<Node*> calls_;
+
+    bool preVisit(Node* node, int /* func_id */) {
+      if (node->type != STANDART_FUNCTION || node->value != CALL) {
+        return true;
+      }
+      for (size_t arg_id = 1; arg_id < node->sons.size(); ++arg_id) {
+        if (node->sons[arg_id]->type == NUMBER) {
+          calls_.push_back(node);
+          break;
+        }
+      }
+      return true;
+    }
+
+   public:
+    explicit ConstantCallFinder(const Tree& tree): TreeVisitor(tree) {}
+
+    const std::vector<Node*>& getCalls() const {
+      return calls_;
+    }
+  };
+
+  Tree* tree_{nullptr};
+  std::map<CopyKey, int> copies_;
+  std::map<int, size_t> copy_cnts_;
+  size_t specialized_cnt_{0};
+
+  /*
+   * Numbers that compare equal but are not the same, -0 and NaN, are not
+   * passed into copies.
+   */
+  static bool isSpecialNumber(double value) {
+    return std::isnan(value) || (value == 0.0 && std::signbit(value));
+  }
+
+  bool findKey(const Node* call, CopyKey& key) const {
+    int callee = static_cast<int>(call->sons[0]->value);
+
+    if (callee == tree_->getMainId() || tree_->getFuncNode(callee) == nullptr) {
+      return false;
+    }
+
+    AssignedVarsFinder assigned(*tree_);
+    assigned.walk(tree_->getFuncNode(callee), callee);
+    key.first = callee;
+    key.second.clear();
+    for (size_t arg_id = 1; arg_id < call->sons.size(); ++arg_id) {
+      const Node* arg = call->sons[arg_id];
+      int param_id = static_cast<int>(arg_id) - 1;
+
+      if (arg->type == NUMBER && !isSpecialNumber(arg->value) &&
+          assigned.getAssigned().count({callee, param_id}) == 0) {
+        key.second.push_back({param_id, arg->value});
+      }
+    }
+    return !key.second.empty();
+  }
+
+  int makeCopy(const CopyKey& key) {
+    Tree& tree = *tree_;
+    Node* func_node = tree.getFuncNode(key.first);
+    std::vector<bool> kept_params(tree.getParamCnt(key.first), true);
+    std::map<int, double> numbers;
+
+    for (const std::pair<int, double>& param: key.second) {
+      kept_params[param.first] = false;
+      numbers[param.first] = param.second;
+    }
+    std::vector<int> new_ids = Tree::compactIds(kept_params);
+
+    Node* copy = copyTree(tree, func_node);
+    std::vector<Node*> stack{copy};
+    while (!stack.empty()) {
+      Node* node = stack.back();
+      stack.pop_back();
+
+      if (node == nullptr) {
+        continue;
+      }
+      if (node->type == PARAM && numbers.count(static_cast<int>(node->value)) != 0) {
+        node->type = NUMBER;
+        node->value = numbers[static_cast<int>(node->value)];
+      } else if (node->type == PARAM) {
+        node->value = new_ids[static_cast<int>(node->value)];
+      }
+      stack.insert(stack.end(), node->sons.begin(), node->sons.end());
+    }
+
+    int copy_id = tree.addFunctionCopy(key.first, copy, kept_params);
+    copy->value = copy_id;
+    tree.getRoot()->sons[1]->sons.push_back(copy);
+    return copy_id;
+  }
+
+  static void redirectCall(Node* call, const CopyKey& key, int copy_id) {
+    call->sons[0]->value = copy_id;
+    for (auto param = key.second.rbegin(); param != key.second.rend(); ++param) {
+      call->sons.erase(call->sons.begin() + param->first + 1);
+    }
+  }
+
+ public:
+  size_t run(Tree& tree) {
+    tree_ = &tree;
+    copies_.clear();
+    copy_cnts_.clear();
+    specialized_cnt_ = 0;
+
+    ConstantCallFinder finder(tree);
+    finder.walk(tree.getRoot());
+    std::vector<Node*> calls = finder.getCalls();
+
+    while (!calls.empty()) {
+      Node* call = calls.back();
+      calls.pop_back();
+
+      CopyKey key;
+      if (!findKey(call, key)) {
+        continue;
+      }
+
+      auto found = copies_.find(key);
+      if (found == copies_.end()) {
+        if (copies_.size() >= MAX_COPIES || copy_cnts_[key.first] >= MAX_COPIES_PER_FUNCTION ||
+            countNodes(tree, tree.getFuncNode(key.first)) > MAX_COPIED_SIZE) {
+          continue;
+        }
+
+        int copy_id = makeCopy(key);
+        found = copies_.insert({key, copy_id}).first;
+        ++copy_cnts_[key.first];
+
+        ConstantCallFinder copy_finder(tree);
+        copy_finder.walk(tree.getFuncNode(copy_id), copy_id);
+        calls.insert(calls.end(), copy_finder.getCalls().begin(), copy_finder.getCalls().end());
+      }
+      redirectCall(call, key, found->second);
+      ++specialized_cnt_;
+    }
+    return specialized_cnt_;
+  }
+
+  std::string getReport() const {
+    return "specialized " + std::to_string(specialized_cnt_) + " calls with " + std::to_string(copies_.size()) +
+      " copies of functions";
+  }
+};
+
+#endif //DED_PROG_LANG_SPECIALIZATION_H
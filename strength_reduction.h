@@ -0,0 +1,369 @@
+//
+// Created by mike on 30.12.18.
+//
+
+#ifndef DED_PROG_LANG_STRENGTH_REDUCTION_H
+#define DED_PROG_LANG_STRENGTH_REDUCTION_H
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_analysis.h"
+#include "tree_visitor.h"
+
+/*
+ * Replaces operations by cheaper ones. Division by a power of two becomes
+ * multiplication by its reciprocal, which is exact and needs no check for
+ * zero, and doubling a variable becomes an addition. In while loops a
+ * product of an induction variable, a local stepped once per iteration by
+ * an invariant, and an invariant factor is kept in a temporary that grows
+ * by step * factor right after the step. Only locals that never hold
+ * anything but integers take part, so the sum stays equal to the product
+ * while the values stay below 2^53.
+ */
+class StrengthReductionPass : public Pass {
+ private:
+  /*
+   * Stepping the temporary costs four commands per iteration and every
+   * product it replaces saves two, as mul costs the same as add here.
+   */
+  static const size_t MIN_PRODUCT_USES = 3;
+
+  class OperatorReducer : public TreeRewriter {
+   private:
+    static bool getExactReciprocal(const Node* divisor, double& reciprocal) {
+      int exponent = 0;
+
+      if (divisor->type != NUMBER || divisor->value == 0.0 || !std::isfinite(divisor->value) ||
+          std::fabs(std::frexp(divisor->value, &exponent)) != 0.5) {
+        return false;
+      }
+      reciprocal = 1.0 / divisor->value;
+      return std::isnormal(reciprocal);
+    }
+
+   protected:
+    Node* rewrite(Node* node, int /* func_id */) {
+      double reciprocal = 0.0;
+
+      if (node->type != OPERATOR || node->sons.size() != 2) {
+        return node;
+      }
+      if ((node->value == DIVIDE || node->value == DIVIDE_EQUAL) && getExactReciprocal(node->sons[1], reciprocal)) {
+        node->value = (node->value == DIVIDE ? MULTIPLY : MULTIPLY_EQUAL);
+        node->sons[1] = tree_.newNode(NUMBER, reciprocal);
+        noteChanges();
+      } else if (node->value == MULTIPLY && isNumber(node->sons[0], 2.0) && isVariableNode(node->sons[1])) {
+        std::swap(node->sons[0], node->sons[1]);
+      }
+      if (node->value == MULTIPLY && isNumber(node->sons[1], 2.0) && isVariableNode(node->sons[0])) {
+        node->value = PLUS;
+        node->sons[1] = tree_.newNode(node->sons[0]->type, node->sons[0]->value);
+        noteChanges();
+      }
+      return node;
+    }
+
+   public:
+    explicit OperatorReducer(Tree& tree): TreeRewriter(tree) {}
+  };
+
+  /*
+   * Everything given to the locals of functions: the initialiser and the
+   * values assigned, nullptr for a value that is not known to be an
+   * integer.
+   */
+  class LocalDefsFinder : public TreeVisitor {
+   private:
+    std::vector<std::pair<VarKey, const Node*>> defs_;
+
+   protected:
+    bool preVisit(Node* node, int func_id) {
+      if (func_id == -1) {
+        return true;
+      }
+      if (node->type == VAR_INIT) {
+        for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
+          defs_.push_back({{func_id, static_cast<int>(tree_.getParamCnt(func_id) + son_id)}, node->sons[son_id]});
+        }
+      } else if (isAssignOperator(node)) {
+        Node* value = (node->value == DIVIDE_EQUAL ? nullptr : node->sons[1]);
+        defs_.push_back({getVarKey(tree_, node->sons[0], func_id), value});
+      } else if (node->type == STANDART_FUNCTION && node->value == INPUT) {
+        defs_.push_back({getVarKey(tree_, node->sons[0], func_id), nullptr});
+      }
+      return true;
+    }
+
+   public:
+    explicit LocalDefsFinder(const Tree& tree): TreeVisitor(tree) {}
+
+    const std::vector<std::pair<VarKey, const Node*>>& getDefs() const {
+      return defs_;
+    }
+  };
+
+  struct InductionVar {
+    Node* var;
+    Node* statement;
+    Node* step;
+    int step_sign;
+  };
+
+  struct ProductGroup {
+    size_t iv_id;
+    Node* factor;
+    std::vector<Node**> slots;
+  };
+
+  Tree* tree_{nullptr};
+  std::set<VarKey> integers_;
+  size_t reduced_cnt_{0};
+  size_t product_cnt_{0};
+  size_t loop_cnt_{0};
+
+  static bool isInteger(double value) {
+    return std::isfinite(value) && std::floor(value) == value;
+  }
+
+  bool isIntegerExpression(const Node* root, int func_id, const std::set<VarKey>& integers) const {
+    std::vector<const Node*> stack{root};
+
+    while (!stack.empty()) {
+      const Node* node = stack.back();
+      stack.pop_back();
+
+      if (node->type == NUMBER) {
+        if (!isInteger(node->value)) {
+          return false;
+        }
+        continue;
+      }
+      if (node->type == LOCAL_VARIABLE) {
+        if (integers.count(getVarKey(*tree_, node, func_id)) == 0) {
+          return false;
+        }
+        continue;
+      }
+      if (node->type != OPERATOR || (node->value != PLUS && node->value != MINUS && node->value != MULTIPLY)) {
+        return false;
+      }
+      for (const Node* son: node->sons) {
+        stack.push_back(son);
+      }
+    }
+    return true;
+  }
+
+  /*
+   * Starts with every local and drops those given a value that may not be
+   * an integer until nothing changes.
+   */
+  void findIntegerLocals(Tree& tree) {
+    LocalDefsFinder finder(tree);
+    finder.walk(tree.getRoot());
+
+    integers_.clear();
+    for (const std::pair<VarKey, const Node*>& def: finder.getDefs()) {
+      if (def.first.func_id != -1 && def.first.slot >= static_cast<int>(tree.getParamCnt(def.first.func_id))) {
+        integers_.insert(def.first);
+      }
+    }
+    for (bool changed = true; changed; ) {
+      changed = false;
+      for (const std::pair<VarKey, const Node*>& def: finder.getDefs()) {
+        if (integers_.count(def.first) != 0 &&
+            (def.second == nullptr || !isIntegerExpression(def.second, def.first.func_id, integers_))) {
+          integers_.erase(def.first);
+          changed = true;
+        }
+      }
+    }
+  }
+
+  bool isInvariantInteger(const Node* node, const LoopSite& site, const ModifiedVarsFinder& modified) const {
+    if (node->type == NUMBER) {
+      return isInteger(node->value);
+    }
+    if (node->type != LOCAL_VARIABLE) {
+      return false;
+    }
+
+    VarKey key = getVarKey(*tree_, node, site.func_id);
+    return integers_.count(key) != 0 && !modified.isModified(key);
+  }
+
+  /*
+   * i = i + s, i = s + i, i = i - s, i += s and i -= s at the top level
+   * of the body, the only assignment of i in the loop.
+   */
+  std::vector<InductionVar> findInductionVars(const LoopSite& site, const ModifiedVarsFinder& modified,
+                                              const AssignCountFinder& assigns) const {
+    std::vector<InductionVar> ivs;
+
+    for (Node* statement: site.loop->sons[1]->sons) {
+      if (!isAssignOperator(statement) || statement->sons[0]->type != LOCAL_VARIABLE) {
+        continue;
+      }
+
+      Node* var = statement->sons[0];
+      VarKey key = getVarKey(*tree_, var, site.func_id);
+      InductionVar iv{var, statement, nullptr, 1};
+
+      if (integers_.count(key) == 0 || assigns.getCount(key) != 1) {
+        continue;
+      }
+      iv.step = getStep(statement, iv.step_sign);
+      if (iv.step != nullptr && isInvariantInteger(iv.step, site, modified)) {
+        ivs.push_back(iv);
+      }
+    }
+    return ivs;
+  }
+
+  /*
+   * Groups the products of an induction variable and an invariant factor
+   * met anywhere in the loop by variable and factor.
+   */
+  std::vector<ProductGroup> findProducts(const LoopSite& site, const ModifiedVarsFinder& modified,
+                                         const std::vector<InductionVar>& ivs) const {
+    std::vector<ProductGroup> groups;
+    std::vector<Node**> stack;
+
+    for (Node*& son: site.loop->sons) {
+      stack.push_back(&son);
+    }
+    while (!stack.empty()) {
+      Node** slot = stack.back();
+      stack.pop_back();
+      Node* node = *slot;
+
+      bool is_product = false;
+      if (node->type == OPERATOR && node->value == MULTIPLY && node->sons.size() == 2) {
+        for (size_t var_pos = 0; var_pos < 2 && !is_product; ++var_pos) {
+          Node* factor = node->sons[1 - var_pos];
+          auto iv = std::find_if(ivs.begin(), ivs.end(), [&](const InductionVar& another) {
+            return isSameVar(node->sons[var_pos], another.var);
+          });
+          if (iv == ivs.end() || !isInvariantInteger(factor, site, modified)) {
+            continue;
+          }
+
+          size_t iv_id = static_cast<size_t>(iv - ivs.begin());
+          auto group = std::find_if(groups.begin(), groups.end(), [&](const ProductGroup& another) {
+            return another.iv_id == iv_id && isSameTree(another.factor, factor);
+          });
+          if (group == groups.end()) {
+            groups.push_back({iv_id, factor, {}});
+            group = groups.end() - 1;
+          }
+          group->slots.push_back(slot);
+          is_product = true;
+        }
+      }
+      for (Node*& son: node->sons) {
+        if (son != nullptr && !is_product) {
+          stack.push_back(&son);
+        }
+      }
+    }
+    return groups;
+  }
+
+  void reduceLoop(const LoopSite& site) {
+    if (site.block == nullptr ||
+        std::find(site.block->sons.begin(), site.block->sons.end(), site.loop) == site.block->sons.end()) {
+      return;
+    }
+
+    ModifiedVarsFinder modified(*tree_);
+    modified.walk(site.loop, site.func_id);
+    AssignCountFinder assigns(*tree_);
+    assigns.walk(site.loop, site.func_id);
+
+    std::vector<InductionVar> ivs = findInductionVars(site, modified, assigns);
+    if (ivs.empty()) {
+      return;
+    }
+
+    std::vector<ProductGroup> groups = findProducts(site, modified, ivs);
+    std::vector<std::pair<const ProductGroup*, int>> temps;
+    Tree& tree = *tree_;
+
+    /* the slots point into the loop, so they go before any statement is added */
+    for (const ProductGroup& group: groups) {
+      if (group.slots.size() < MIN_PRODUCT_USES) {
+        continue;
+      }
+      temps.push_back({&group, tree.addTemporary("sr", site.func_id)});
+      for (Node** slot: group.slots) {
+        *slot = tree.newNode(LOCAL_VARIABLE, temps.back().second);
+      }
+      product_cnt_ += group.slots.size();
+    }
+
+    for (const std::pair<const ProductGroup*, int>& group_temp: temps) {
+      const ProductGroup& group = *group_temp.first;
+      const InductionVar& iv = ivs[group.iv_id];
+      int temp = group_temp.second;
+      Node* increment = nullptr;
+
+      if (iv.step->type == NUMBER && group.factor->type == NUMBER) {
+        increment = tree.newNode(NUMBER, iv.step->value * group.factor->value);
+      } else {
+        int step_temp = tree.addTemporary("sr", site.func_id);
+
+        Node* step_value = tree.newNode(OPERATOR, MULTIPLY, {copyTree(tree, iv.step), copyTree(tree, group.factor)});
+        insertBefore(site.block, site.loop,
+                     tree.newNode(OPERATOR, EQUAL, {tree.newNode(LOCAL_VARIABLE, step_temp), step_value}));
+        increment = tree.newNode(LOCAL_VARIABLE, step_temp);
+      }
+
+      Node* start = tree.newNode(OPERATOR, MULTIPLY, {copyTree(tree, iv.var), copyTree(tree, group.factor)});
+      insertBefore(site.block, site.loop, tree.newNode(OPERATOR, EQUAL, {tree.newNode(LOCAL_VARIABLE, temp), start}));
+
+      NodeList& body = site.loop->sons[1]->sons;
+      Node* step = tree.newNode(OPERATOR, iv.step_sign > 0 ? PLUS_EQUAL : MINUS_EQUAL,
+                                {tree.newNode(LOCAL_VARIABLE, temp), increment});
+      body.insert(std::find(body.begin(), body.end(), iv.statement) + 1, step);
+    }
+    loop_cnt_ += !temps.empty();
+  }
+
+  static void insertBefore(Node* block, Node* statement, Node* new_statement) {
+    NodeList& statements = block->sons;
+    statements.insert(std::find(statements.begin(), statements.end(), statement), new_statement);
+  }
+
+ public:
+  size_t run(Tree& tree) {
+    tree_ = &tree;
+    reduced_cnt_ = 0;
+    product_cnt_ = 0;
+    loop_cnt_ = 0;
+
+    findIntegerLocals(tree);
+    LoopFinder finder(tree);
+    finder.walk(tree.getRoot());
+    for (const LoopSite& site: finder.getSites()) {
+      reduceLoop(site);
+    }
+
+    OperatorReducer reducer(tree);
+    tree.setRoot(reducer.walk(tree.getRoot()));
+    reduced_cnt_ = reducer.getRewriteCnt();
+    return reduced_cnt_ + product_cnt_;
+  }
+
+  std::string getReport() const {
+    return "reduced " + std::to_string(reduced_cnt_) + " operators and " + std::to_string(product_cnt_) +
+      " products in " + std::to_string(loop_cnt_) + " loops";
+  }
+};
+
+#endif //DED_PROG_LANG_STRENGTH_REDUCTION_H
@@ -0,0 +1,21 @@
+# Compiles and runs PROGRAM with the options in ARGS in WORK_DIR and
+# compares what it printed with the EXPECTED file. Every test has a
+# WORK_DIR of its own, so tests of one program can run at once.
+get_filename_component(program_name ${PROGRAM} NAME)
+file(MAKE_DIRECTORY ${WORK_DIR})
+configure_file(${PROGRAM} ${WORK_DIR}/${program_name} COPYONLY)
+separate_arguments(args UNIX_COMMAND "${ARGS}")
+
+execute_process(COMMAND ${COMPILER} ${program_name} ${program_name}.asm ${args}
+                WORKING_DIRECTORY ${WORK_DIR} TIMEOUT 60 INPUT_FILE /dev/null
+                OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${program_name} ${ARGS} failed:\n${output}")
+endif()
+
+string(REGEX MATCHALL "# console out: [^\n]*\n" printed "${output}")
+string(REPLACE ";" "" printed "${printed}")
+file(READ ${EXPECTED} expected)
+if(NOT printed STREQUAL expected)
+  message(FATAL_ERROR "${program_name} ${ARGS} printed\n${printed}instead of\n${expected}")
+endif()
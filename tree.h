@@ -5,6 +5,7 @@
 #ifndef DED_PROG_LANG_TREE_H
 #define DED_PROG_LANG_TREE_H
 
+#include <cstdio>
 #include <cstring>
 #include <cctype>
 #include <cstdlib>
@@ -16,7 +17,7 @@
 #include <algorithm>
 
 #include "exception.h"
-#include "stack_allocator.h"
+#include "arena.h"
 
 #define PRINT_STEP(text)\
 {\
@@ -107,7 +108,7 @@ enum LangLogic {
 };
 
 bool isOperator(char ch) {
-  return ch == '+' || ch == '-' || ch == '*' || ch == '/';
+  return ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '^';
 }
 
 bool isVariable(char ch) {
@@ -131,7 +132,7 @@ size_t operPriority(LangOperator oper_type) {
   throw IncorrectArgumentException("it is not an operator", __PRETTY_FUNCTION__);
 }
 
-LangOperator getOperTypeByOper(const std::string& oper) {
+LangOperator getOperTypeByOper(const StringRef& oper) {
   if (oper == "+") {
     return PLUS;
   }
@@ -144,6 +145,9 @@ LangOperator getOperTypeByOper(const std::string& oper) {
   if (oper == "/") {
     return DIVIDE;
   }
+  if (oper == "^") {
+    return POWER;
+  }
   if (oper == "==") {
     return BOOL_EQUAL;
   }
@@ -193,22 +197,26 @@ char getOperByOperType(LangOperator oper_type) {
   }
 }
 
+struct Node;
+
+typedef std::vector<Node*, ArenaAllocator<Node*>> NodeList;
+
 struct Node {
   NodeType type;
   double value{0.0};
-  std::vector<Node*> sons;
+  NodeList sons;
 
   bool operator==(const Node& another) const {
     return type == another.type && value == another.value;
   }
 
-  Node(NodeType type, double value):
-    type(type), value(value) {
+  Node(NodeType type, double value, Arena& arena):
+    type(type), value(value), sons(ArenaAllocator<Node*>(&arena)) {
 
   }
 
-  Node(NodeType type, double value, std::vector<Node*> sons):
-    type(type), value(value), sons(sons) {
+  Node(NodeType type, double value, std::initializer_list<Node*> sons, Arena& arena):
+    type(type), value(value), sons(sons, ArenaAllocator<Node*>(&arena)) {
 
   }
 
@@ -216,34 +224,38 @@ struct Node {
 
 struct FuncBlock {
   Node* func_node;
-  std::map<std::string, size_t> param_shift;
-  std::map<std::string, size_t> var_shift;
+  std::map<StringRef, size_t> param_shift;
+  std::map<StringRef, size_t> var_shift;
 };
 
 class Tree {
  private:
+  Arena* arena_;
   Node* root_{nullptr};
-  std::unordered_map<std::string, size_t> global_var_map_;
-  std::unordered_map<std::string, size_t> func_map_;
+  std::unordered_map<StringRef, size_t> global_var_map_;
+  std::unordered_map<StringRef, size_t> func_map_;
   std::vector<FuncBlock> func_blocks_;
 
-  mutable size_t cnt_if_{0};
-  mutable size_t cnt_while_{0};
-
  public:
-  static StackAllocator<Node> allocator_;
+  Tree(Arena& arena, Node* node = nullptr): arena_(&arena), root_(node) {}
+
+  Node* newNode(NodeType type, double value, std::initializer_list<Node*> sons = {}) {
+    return arena_->make<Node>(type, value, sons, *arena_);
+  }
 
-  Tree(Node* node = nullptr): root_(node) {}
+  Arena& getArena() {
+    return *arena_;
+  }
 
   void setRoot(Node* new_root) {
     root_ = new_root;
   }
 
-  Node* getRoot() {
+  Node* getRoot() const {
     return root_;
   }
 
-  int getVariableAddress(const std::string& var_name, int func_id) {
+  int getVariableAddress(const StringRef& var_name, int func_id) {
     if (func_id == -1) {
       auto iter = global_var_map_.find(var_name);
 
@@ -261,7 +273,7 @@ class Tree {
     }
   }
 
-  int addVariable(const std::string& var_name, int func_id, Node* value_node) {
+  int addVariable(const StringRef& var_name, int func_id, Node* value_node) {
     std::cout << "add variable " << var_name << " to function " << func_id << '\n';
 
     int result = -1;
@@ -299,7 +311,7 @@ class Tree {
     }
   }
 
-  int getFunctionId(const std::string& func_name) {
+  int getFunctionId(const StringRef& func_name) {
     auto iter = func_map_.find(func_name);
 
     if (iter == func_map_.end()) {
@@ -308,7 +320,10 @@ class Tree {
     return iter->second;
   }
 
-  int getParamId(const std::string& param_name, int func_id) {
+  int getParamId(const StringRef& param_name, int func_id) {
+    if (func_id == -1) {
+      return -1;
+    }
     auto iter = func_blocks_[func_id].param_shift.find(param_name);
 
     if (iter == func_blocks_[func_id].param_shift.end()) {
@@ -317,14 +332,14 @@ class Tree {
     return iter->second;
   }
 
-  int addParam(const std::string& param_name, int func_id) {
+  int addParam(const StringRef& param_name, int func_id) {
     int result = func_blocks_[func_id].param_shift.size();
 
     func_blocks_[func_id].param_shift[param_name] = result;
     return result;
   }
 
-  int addFunction(const std::string& func_name, Node* func_node) {
+  int addFunction(const StringRef& func_name, Node* func_node) {
     auto iter = func_map_.find(func_name);
 
     if (iter != func_map_.end()) {
@@ -339,443 +354,186 @@ class Tree {
     return result;
   }
 
-  void printLevel(const std::string text, FILE* tree_file, size_t level) const {
-    for (size_t sep_id = 0; sep_id < level; ++sep_id) {
-      fprintf(tree_file, "  ");
+  /*
+   * Adds a copy of a function that only takes the parameters marked in
+   * kept_params, renumbered in order, and returns its id. The copy goes
+   * right before main, so that main keeps the last id; its name is the
+   * name of the original with a suffix no name from the code can have.
+   * Nodes of the copy are renumbered by the caller.
+   */
+  int addFunctionCopy(int func_id, Node* func_node, const std::vector<bool>& kept_params) {
+    std::string base_name = getFuncName(func_id).str() + "$";
+    std::string name;
+
+    for (size_t copy_id = 0; ; ++copy_id) {
+      name = base_name + std::to_string(copy_id);
+      if (getFunctionId(StringRef(name)) == -1) {
+        break;
+      }
     }
-    fprintf(tree_file, "%s\n", text.c_str());
-  }
 
-  std::string prettyDouble(double value) const {
-    if (value == static_cast<int>(value)) {
-      return std::to_string(static_cast<int>(value));
+    int main_id = getMainId();
+    FuncBlock copy = func_blocks_[func_id];
+    copy.func_node = func_node;
+    renumberShifts(copy.param_shift, compactIds(kept_params));
+    func_blocks_.insert(func_blocks_.begin() + main_id, copy);
+    for (std::pair<const StringRef, size_t>& cp: func_map_) {
+      if (static_cast<int>(cp.second) == main_id) {
+        ++cp.second;
+      }
     }
-    return std::to_string(value);
+    func_map_[StringRef(name, *arena_)] = main_id;
+    return main_id;
   }
 
-  void printNodeBegin(Node* node, FILE* tree_file, size_t level) const {
-    printLevel(std::string("[ ") + std::to_string(node->type) + " " + prettyDouble(node->value),
-               tree_file, level);
-  }
+  std::vector<StringRef> sortedNames(const std::map<StringRef, size_t>& shifts) const {
+    std::vector<StringRef> result(shifts.size());
 
-  void printNodeEnd(Node* node, FILE* tree_file, size_t level) const {
-    printLevel(std::string("]"), tree_file, level);
-  }
-
-  void printLeaf(Node* node, FILE* tree_file, size_t level) const {
-    printLevel(std::string("[ ") + std::to_string(node->type) + " " + prettyDouble(node->value) + "]",
-               tree_file, level);
+    for (const std::pair<const StringRef, size_t>& cp: shifts) {
+      result[cp.second] = cp.first;
+    }
+    return result;
   }
 
+  std::vector<StringRef> getGlobalNames() const {
+    std::vector<StringRef> result(global_var_map_.size());
 
-  void printTreeRec(Node* node, FILE* tree_file, size_t level) const {
-    if (node == nullptr) {
-      return;
+    for (const std::pair<const StringRef, size_t>& cp: global_var_map_) {
+      result[cp.second] = cp.first;
     }
-    if (node->sons.size() == 0) {
-      printLeaf(node, tree_file, level);
-      return;
-    }
-    printNodeBegin(node, tree_file, level);
-    for (size_t child_id = 0; child_id < node->sons.size(); ++child_id) {
-      printTreeRec(node->sons[child_id], tree_file, level + 1);
-    }
-    printNodeEnd(node, tree_file, level);
+    return result;
   }
 
-  void printFuncVars(FILE* tree_file,
-                     const std::map<std::string, size_t>& vars) const {
-    std::vector<std::pair<size_t, std::string>> sorted_vars;
-
-    for (const std::pair<std::string, size_t>& cp: vars) {
-      sorted_vars.push_back({cp.second, cp.first});
-    }
-    std::sort(sorted_vars.begin(), sorted_vars.end());
-    for (const std::pair<size_t, std::string>& cp: sorted_vars) {
-      fprintf(tree_file, "%s\n", cp.second.c_str());
-    }
+  size_t getGlobalCnt() const {
+    return global_var_map_.size();
   }
 
-  void printFuncs(FILE* tree_file) const {
-    fprintf(tree_file, "FUNCS %zu\n", func_blocks_.size());
-    std::vector<std::pair<size_t, std::string>> funcs;
+  size_t getFuncCnt() const {
+    return func_blocks_.size();
+  }
 
-    for (const std::pair<std::string, size_t>& cp: func_map_) {
-      funcs.push_back({cp.second, cp.first});
-    }
-    std::sort(funcs.begin(), funcs.end());
-    for (const std::pair<size_t, std::string>& cp: funcs) {
-      //fprintf(tree_file, "func %zu\n", cp.first);
-      fprintf(tree_file, "%s:\nPARAMS %zu\n", cp.second.c_str(),
-              func_blocks_[cp.first].param_shift.size());
-      printFuncVars(tree_file, func_blocks_[cp.first].param_shift);
-
-      fprintf(tree_file, "NEWVAR %zu\n", func_blocks_[cp.first].var_shift.size());
-      printFuncVars(tree_file, func_blocks_[cp.first].var_shift);
+  StringRef getFuncName(int func_id) const {
+    for (const std::pair<const StringRef, size_t>& cp: func_map_) {
+      if (cp.second == static_cast<size_t>(func_id)) {
+        return cp.first;
+      }
     }
+    throw IncorrectArgumentException("no function with id " + std::to_string(func_id), __PRETTY_FUNCTION__);
   }
 
-  void printVars(FILE* tree_file) const {
-    fprintf(tree_file, "VARS %zu\n", global_var_map_.size());
-    std::vector<std::pair<size_t, std::string>> vars;
-
-    for (const std::pair<std::string, size_t>& cp: global_var_map_) {
-      vars.push_back({cp.second, cp.first});
-    }
-    std::sort(vars.begin(), vars.end());
-    for (const std::pair<size_t, std::string>& cp: vars) {
-      fprintf(tree_file, "%s\n", cp.second.c_str());
-    }
+  std::vector<StringRef> getParamNames(int func_id) const {
+    return sortedNames(func_blocks_[func_id].param_shift);
   }
 
-  void printTree(FILE* tree_file) const {
-    printVars(tree_file);
-    printFuncs(tree_file);
-    printTreeRec(root_, tree_file, 0);
+  std::vector<StringRef> getVarNames(int func_id) const {
+    return sortedNames(func_blocks_[func_id].var_shift);
   }
 
   int getParamCnt(int func_id) const {
     return func_blocks_[func_id].param_shift.size();
   }
 
-  void pushNodeVariable(Node* node, FILE* asm_file, int func_id) const {
-    if (node->sons[0]->type == VARIABLE) {
-      fprintf(asm_file, "  push [%d]\n", static_cast<int>(node->sons[0]->value));
-    } else if (node->sons[0]->type == LOCAL_VARIABLE) {
-      fprintf(asm_file, "  push [rcx+%d]\n", static_cast<int>(node->sons[0]->value) + getParamCnt(func_id));
-    } else if (node->sons[0]->type == PARAM) {
-      fprintf(asm_file, "  push [rcx+%d]\n", static_cast<int>(node->sons[0]->value));
-    }
+  int getVarCnt(int func_id) const {
+    return func_blocks_[func_id].var_shift.size();
   }
 
-  void popNodeVariable(Node* node, FILE* asm_file, int func_id) const {
-    if (node->sons[0]->type == VARIABLE) {
-      fprintf(asm_file, "  pop [%d]\n", static_cast<int>(node->sons[0]->value));
-    } else if (node->sons[0]->type == LOCAL_VARIABLE) {
-      fprintf(asm_file, "  pop [rcx+%d]\n", static_cast<int>(node->sons[0]->value) + getParamCnt(func_id));
-    } else if (node->sons[0]->type == PARAM) {
-      fprintf(asm_file, "  pop [rcx+%d]\n", static_cast<int>(node->sons[0]->value));
-    }
+  int getMainId() const {
+    return static_cast<int>(func_blocks_.size()) - 1;
   }
 
-  void printAsmRec(Node* node, FILE* asm_file, int func_id) const {
-    if (node == nullptr) {
-      return;
-    }
-    //std::cout << "node type " << node->type << '\n';
-    switch (node->type) {
-      case VAR_INIT:
-      {
-       // std::cout << "var_init " << func_id << '\n';
-        for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-          printAsmRec(node->sons[son_id], asm_file, func_id);
-          if (func_id != -1) {
-            fprintf(asm_file, "  pop [rcx+%zu]\n", son_id + getParamCnt(func_id));
-          } else {
-            fprintf(asm_file, "  pop [%zu]\n", son_id);
-          }
-        }
-        return;
-      }
-      case USER_FUNCTION:
-      {
-        std::cout << "print user function " << node->value << " from" << func_id << "\n";
-        if (func_id == -1) {
-          func_id = node->value;
-          fprintf(asm_file, ":func_%d\n", static_cast<int>(node->value));
-          for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-            printAsmRec(node->sons[son_id], asm_file, node->value);
-          }
-          fprintf(asm_file, "  ret\n");
-        } else {
-          fprintf(asm_file, "  call func_%d\n", static_cast<int>(node->value));
-        }
-        return;
-      }
-      case NUMBER:
-      {
-        fprintf(asm_file, "  push %.6lf\n", node->value);
-        return;
-      }
-      case VARIABLE:
-      {
-        fprintf(asm_file, "  push [%d]\n", static_cast<int>(node->value));
-        break;
-      }
-      case LOCAL_VARIABLE:
-      {
-        if (func_id != -1) {
-          fprintf(asm_file, "  push [rcx+%zu]\n", func_blocks_[func_id].param_shift.size() +
-                  static_cast<size_t>(node->value));
-        } else {
-          fprintf(asm_file, "  push [%d]\n", static_cast<int>(node->value));
-        }
-        break;
-      }
-      case PARAM:
-      {
-        fprintf(asm_file, "  push [rcx+%zu]\n", static_cast<size_t>(node->value));
-        break;
-      }
-      case OPERATOR:
-      {
-        int oper_type = static_cast<int>(node->value);
-
-        if (node->sons.size() == 1 && oper_type == MINUS) {
-          fprintf(asm_file, "  push 0\n");
-        }
-
-        if (oper_type != PLUS_EQUAL && oper_type != MINUS_EQUAL
-            && oper_type != MULTIPLY_EQUAL && oper_type != DIVIDE_EQUAL) {
-          for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-            printAsmRec(node->sons[son_id], asm_file, func_id);
-          }
-        }
-
-        switch (oper_type) {
-          case EQUAL:
-            printAsmRec(node->sons[1], asm_file, func_id);
-            popNodeVariable(node, asm_file, func_id);
-            break;
-          case PLUS_EQUAL:
-            pushNodeVariable(node, asm_file, func_id);
-            printAsmRec(node->sons[1], asm_file, func_id);
-            fprintf(asm_file, "  add\n");
-            popNodeVariable(node, asm_file, func_id);
-            break;
-          case MINUS_EQUAL:
-            pushNodeVariable(node, asm_file, func_id);
-            printAsmRec(node->sons[1], asm_file, func_id);
-            fprintf(asm_file, "  sub\n");
-            popNodeVariable(node, asm_file, func_id);
-            break;
-          case MULTIPLY_EQUAL:
-            pushNodeVariable(node, asm_file, func_id);
-            printAsmRec(node->sons[1], asm_file, func_id);
-            fprintf(asm_file, "  mul\n");
-            popNodeVariable(node, asm_file, func_id);
-            break;
-          case DIVIDE_EQUAL:
-            pushNodeVariable(node, asm_file, func_id);
-            printAsmRec(node->sons[1], asm_file, func_id);
-            fprintf(asm_file, "  div\n");
-            popNodeVariable(node, asm_file, func_id);
-            break;
-          case PLUS:
-            fprintf(asm_file, "  add\n");
-            break;
-          case MINUS:
-            fprintf(asm_file, "  sub\n");
-            break;
-          case MULTIPLY:
-            fprintf(asm_file, "  mul\n");
-            break;
-          case DIVIDE:
-            fprintf(asm_file, "  div\n");
-            break;
-          case POWER:
-            fprintf(asm_file, "  power\n");
-            break;
-          case BOOL_EQUAL:
-            fprintf(asm_file, "  is_equal\n");
-            break;
-          case BOOL_NOT_EQUAL:
-            fprintf(asm_file, "  is_nequal\n");
-            break;
-          case BOOL_NOT:
-            fprintf(asm_file, "  not\n");
-            break;
-          case BOOL_AND:
-            fprintf(asm_file, "  and\n");
-            break;
-          case BOOL_OR:
-            fprintf(asm_file, "  or\n");
-            break;
-          case BOOL_GREATER:
-            fprintf(asm_file, "  greater\n");
-            break;
-          case BOOL_LOWER:
-            fprintf(asm_file, "  lower\n");
-            break;
-          case BOOL_NOT_GREATER:
-            fprintf(asm_file, "  ngreater\n");
-            break;
-          case BOOL_NOT_LOWER:
-            fprintf(asm_file, "  nlower\n");
-            break;
-          default:
-            throw IncorrectArgumentException(std::string("no such operator ") + std::to_string(node->value),
-                                             __PRETTY_FUNCTION__);
-        }
-        break;
-      }
-      case STANDART_FUNCTION:
-      {
-        if (node->value != CALL) {
-          for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-            printAsmRec(node->sons[son_id], asm_file, func_id);
-          }
-        }
-        int std_func_type = static_cast<int>(node->value);
-
-        switch (std_func_type) {
-          case INPUT:
-            fprintf(asm_file, "  in rax\n");
-            fprintf(asm_file, "  push rax\n");
-            if (node->sons[0]->type == VARIABLE) {
-              fprintf(asm_file, "  pop [%d]\n", static_cast<int>(node->sons[0]->value));
-            } else if (node->sons[0]->type == LOCAL_VARIABLE) {
-              fprintf(asm_file, "  pop [rcx+%d]\n", static_cast<int>(node->sons[0]->value));
-            }
-            break;
-          case OUTPUT:
-            fprintf(asm_file, "  pop rbx\n");
-            fprintf(asm_file, "  out rbx\n");
-            break;
-          case SIN:
-            fprintf(asm_file, "  sin\n");
-            break;
-          case COS:
-            fprintf(asm_file, "  cos\n");
-            break;
-          case SQ_ROOT:
-            fprintf(asm_file, "  sqrt\n");
-            break;
-          case CALL: {
-            int call_func_id = static_cast<int>(node->sons[0]->value);
-            int param_cnt = getParamCnt(call_func_id);
-
-            if (param_cnt + 1 != node->sons.size()) {
-              throw IncorrectArgumentException(std::string("called function get ") +
-                std::to_string(param_cnt) + " params but not " +
-                std::to_string(node->sons[0]->sons.size()), __PRETTY_FUNCTION__);
-            }
-            for (size_t param_id = 1; param_id <= param_cnt; ++param_id) {
-              printAsmRec(node->sons[param_id], asm_file, func_id);
-            }
-
-            fprintf(asm_file, "  push rcx\n");
-            fprintf(asm_file, "  push %zu\n", func_blocks_[func_id].param_shift.size() +
-              func_blocks_[func_id].var_shift.size());
-            fprintf(asm_file, "  add\n");
-            fprintf(asm_file, "  pop rcx\n");
-            for (int param_id = param_cnt - 1; param_id >= 0; --param_id) {
-              fprintf(asm_file, "  pop [rcx+%d]\n", param_id);
-            }
-
-            fprintf(asm_file, "  call func_%d\n", call_func_id);
-
-            fprintf(asm_file, "  push rcx\n");
-            fprintf(asm_file, "  push %zu\n", func_blocks_[func_id].param_shift.size() +
-              func_blocks_[func_id].var_shift.size());
-            fprintf(asm_file, "  sub\n");
-            fprintf(asm_file, "  pop rcx\n");
-            break;
-          }
-          default:
-            throw IncorrectArgumentException(std::string("no such operator ") + std::to_string(node->value),
-                                             __PRETTY_FUNCTION__);
-        }
-        break;
-      }
-      case MAIN:
-      {
-        fprintf(asm_file, "\n:func_main\n");
-        for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-          printAsmRec(node->sons[son_id], asm_file, func_blocks_.size() - 1);
-        }
-        fprintf(asm_file, "  end\n");
-        break;
-      }
-      case FUNCS:
-      {
-        std::cout << "user func count " << node->sons.size() << "\n";
-        for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-          std::cout << "declare func " << node->sons[son_id]->value << " from " << func_id << "\n";
-          printAsmRec(node->sons[son_id], asm_file, func_id);
-        }
-        break;
-      }
-      case RETURN:
-      {
-        if (node->sons.size() == 1) {
-          printAsmRec(node->sons[0], asm_file, func_id);
-        }
-        if (func_id + 1 != func_map_.size()) {
-          fprintf(asm_file, "  ret\n");
-        } else {
-          fprintf(asm_file, "  end\n");
-        }
+  Node* getFuncNode(int func_id) const {
+    return func_blocks_[func_id].func_node;
+  }
+
+  /*
+   * Adds a compiler made local to a function, initialised with zero. Its
+   * name starts with prefix and cannot clash with names from the code.
+   */
+  int addTemporary(const std::string& prefix, int func_id) {
+    std::string name;
+
+    for (size_t temp_id = func_blocks_[func_id].var_shift.size(); ; ++temp_id) {
+      name = "$" + prefix + std::to_string(temp_id);
+      if (getVariableAddress(StringRef(name), func_id) == -1 && getParamId(StringRef(name), func_id) == -1) {
         break;
       }
-      case ROOT:
-      {
-        printAsmRec(node->sons[0], asm_file, func_id);
-        fprintf(asm_file, "jmp func_main\n");
-        printAsmRec(node->sons[1], asm_file, func_id);
-        printAsmRec(node->sons[2], asm_file, func_id);
-        break;
+    }
+    return addVariable(StringRef(name, *arena_), func_id, newNode(NUMBER, 0.0));
+  }
+
+  Node* getVarInitNode(int func_id) const {
+    if (func_id == -1) {
+      return root_->sons[0];
+    }
+    return func_blocks_[func_id].func_node->sons[0];
+  }
+
+  template<class ShiftMap>
+  static void renumberShifts(ShiftMap& shifts, const std::vector<int>& new_ids) {
+    for (auto iter = shifts.begin(); iter != shifts.end();) {
+      if (new_ids[iter->second] == -1) {
+        iter = shifts.erase(iter);
+      } else {
+        iter->second = new_ids[iter->second];
+        ++iter;
       }
-      case LOGIC:
-      {
-        int logic_type = static_cast<int>(node->value);
-
-        switch (logic_type) {
-          case IF:
-            printAsmRec(node->sons[0], asm_file, func_id);
-            fprintf(asm_file, "  push 0\n");
-            fprintf(asm_file, "  je if_end_%zu\n", cnt_if_);
-            printAsmRec(node->sons[1], asm_file, func_id);
-            fprintf(asm_file, "  jmp if_block_end_%zu\n", cnt_if_);
-            fprintf(asm_file, "  :if_end_%zu\n", cnt_if_);
-            if (node->sons.size() > 2) {
-              printAsmRec(node->sons[2], asm_file, func_id);
-            }
-            fprintf(asm_file, "  :if_block_end_%zu\n", cnt_if_);
-            ++cnt_if_;
-            break;
-          case ELSE:
-            for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-              printAsmRec(node->sons[son_id], asm_file, func_id);
-            }
-            break;
-          case WHILE:
-            fprintf(asm_file, "  :while_begin_%zu\n", cnt_while_);
-            printAsmRec(node->sons[0], asm_file, func_id);
-            fprintf(asm_file, "  push 0\n");
-            fprintf(asm_file, "  je while_end_%zu\n", cnt_while_);
-            printAsmRec(node->sons[1], asm_file, func_id);
-            fprintf(asm_file, "  jmp while_begin_%zu\n", cnt_while_);
-            fprintf(asm_file, "  :while_end_%zu\n", cnt_while_);
-            ++cnt_while_;
-            break;
-          case CONDITION:
-            printAsmRec(node->sons[0], asm_file, func_id);
-            break;
-          case CONDITION_MET:
-          {
-            for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-              printAsmRec(node->sons[son_id], asm_file, func_id);
-            }
-            break;
-          }
-          default:
-            throw IncorrectArgumentException(std::string("no such separate logic block was provided: ")
-                                               + std::to_string(logic_type), __PRETTY_FUNCTION__);
-        }
-        break;
+    }
+  }
+
+  static std::vector<int> compactIds(const std::vector<bool>& used) {
+    std::vector<int> new_ids(used.size(), -1);
+    int next_id = 0;
+
+    for (size_t old_id = 0; old_id < used.size(); ++old_id) {
+      if (used[old_id]) {
+        new_ids[old_id] = next_id++;
       }
-      default:
-      {
-        throw IncorrectArgumentException(std::string("no such node type:") + std::to_string(node->type),
-                                         __PRETTY_FUNCTION__);
+    }
+    return new_ids;
+  }
+
+  /*
+   * Drops the variables of a function (-1 for globals) which are not used,
+   * together with their VAR_INIT entries, and returns the new slot of every
+   * old one, -1 for the dropped ones. Nodes are renumbered by the caller.
+   */
+  std::vector<int> compactVariables(int func_id, const std::vector<bool>& used) {
+    std::vector<int> new_ids = compactIds(used);
+    Node* var_init = getVarInitNode(func_id);
+    size_t next_son = 0;
+
+    for (size_t var_id = 0; var_id < var_init->sons.size(); ++var_id) {
+      if (new_ids[var_id] != -1) {
+        var_init->sons[next_son++] = var_init->sons[var_id];
       }
     }
+    var_init->sons.resize(next_son);
+
+    if (func_id == -1) {
+      renumberShifts(global_var_map_, new_ids);
+    } else {
+      renumberShifts(func_blocks_[func_id].var_shift, new_ids);
+    }
+    return new_ids;
   }
 
-  void printAssembler(FILE* asm_file) const {
-    std::cout << "print asm rec\n";
-    printAsmRec(root_, asm_file, -1);
+  /*
+   * Drops the functions which are not used and returns the new id of every
+   * old one, -1 for the dropped ones. Main must stay used so that it keeps
+   * the last id. Nodes are renumbered by the caller.
+   */
+  std::vector<int> compactFunctions(const std::vector<bool>& used) {
+    std::vector<int> new_ids = compactIds(used);
+    std::vector<FuncBlock> func_blocks;
+
+    for (size_t func_id = 0; func_id < func_blocks_.size(); ++func_id) {
+      if (new_ids[func_id] != -1) {
+        func_blocks.push_back(std::move(func_blocks_[func_id]));
+      }
+    }
+    func_blocks_ = std::move(func_blocks);
+    renumberShifts(func_map_, new_ids);
+    return new_ids;
   }
 };
 
@@ -0,0 +1,515 @@
+//
+// Created by mike on 24.12.18.
+//
+
+#ifndef DED_PROG_LANG_TREE_ANALYSIS_H
+#define DED_PROG_LANG_TREE_ANALYSIS_H
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "tree.h"
+#include "tree_visitor.h"
+
+bool isAssignOperator(const Node* node) {
+  return node->type == OPERATOR &&
+    (node->value == EQUAL || node->value == PLUS_EQUAL || node->value == MINUS_EQUAL ||
+     node->value == MULTIPLY_EQUAL || node->value == DIVIDE_EQUAL);
+}
+
+bool isVariableNode(const Node* node) {
+  return node->type == VARIABLE || node->type == LOCAL_VARIABLE || node->type == PARAM;
+}
+
+bool isNumber(const Node* node, double value) {
+  return node->type == NUMBER && node->value == value;
+}
+
+bool isSameVar(const Node* var_a, const Node* var_b) {
+  return isVariableNode(var_a) && *var_a == *var_b;
+}
+
+/*
+ * The step of i = i + s, i = s + i, i = i - s, i += s or i -= s, nullptr
+ * for other statements; step_sign is -1 when the step is taken away.
+ */
+Node* getStep(Node* statement, int& step_sign) {
+  if (!isAssignOperator(statement)) {
+    return nullptr;
+  }
+
+  Node* var = statement->sons[0];
+  Node* value = statement->sons[1];
+  step_sign = 1;
+  if (statement->value == PLUS_EQUAL || statement->value == MINUS_EQUAL) {
+    step_sign = (statement->value == PLUS_EQUAL ? 1 : -1);
+    return value;
+  }
+  if (statement->value != EQUAL || value->type != OPERATOR || value->sons.size() != 2) {
+    return nullptr;
+  }
+  if (value->value == PLUS && isSameVar(value->sons[1], var)) {
+    return value->sons[0];
+  }
+  if ((value->value == PLUS || value->value == MINUS) && isSameVar(value->sons[0], var)) {
+    step_sign = (value->value == PLUS ? 1 : -1);
+    return value->sons[1];
+  }
+  return nullptr;
+}
+
+/*
+ * Identifies a variable slot across the program: globals have func_id -1.
+ * Parameters and locals of one function share the slot space of its frame,
+ * parameters first.
+ */
+struct VarKey {
+  int func_id;
+  int slot;
+
+  bool operator<(const VarKey& another) const {
+    return func_id < another.func_id || (func_id == another.func_id && slot < another.slot);
+  }
+
+  bool operator==(const VarKey& another) const {
+    return func_id == another.func_id && slot == another.slot;
+  }
+};
+
+VarKey getVarKey(const Tree& tree, const Node* var_node, int func_id) {
+  int slot = static_cast<int>(var_node->value);
+
+  if (var_node->type == VARIABLE || func_id == -1) {
+    return {-1, slot};
+  }
+  if (var_node->type == LOCAL_VARIABLE) {
+    return {func_id, tree.getParamCnt(func_id) + slot};
+  }
+  return {func_id, slot};
+}
+
+/*
+ * True when evaluating the expression neither changes state, nor does
+ * input or output, nor may stop the program: calls, assignments, scan,
+ * print and divisions by anything but a non-zero constant are not pure.
+ * With allow_traps divisions are let through.
+ */
+bool isPureExpression(const Node* root, bool allow_traps = false) {
+  std::vector<const Node*> stack{root};
+
+  while (!stack.empty()) {
+    const Node* node = stack.back();
+    stack.pop_back();
+
+    if (node == nullptr) {
+      continue;
+    }
+    if (isAssignOperator(node) || node->type == RETURN || node->type == VAR_INIT ||
+        node->type == USER_FUNCTION || node->type == LOGIC) {
+      return false;
+    }
+    if (node->type == STANDART_FUNCTION &&
+        (node->value == CALL || node->value == INPUT || node->value == OUTPUT)) {
+      return false;
+    }
+    if (!allow_traps && node->type == OPERATOR && node->value == DIVIDE &&
+        (node->sons[1]->type != NUMBER || node->sons[1]->value == 0.0)) {
+      return false;
+    }
+    for (const Node* son: node->sons) {
+      stack.push_back(son);
+    }
+  }
+  return true;
+}
+
+/*
+ * True when the tree contains a call of a user function.
+ */
+bool hasCalls(const Node* root) {
+  std::vector<const Node*> stack{root};
+
+  while (!stack.empty()) {
+    const Node* node = stack.back();
+    stack.pop_back();
+
+    if (node == nullptr) {
+      continue;
+    }
+    if (node->type == STANDART_FUNCTION && node->value == CALL) {
+      return true;
+    }
+    for (const Node* son: node->sons) {
+      stack.push_back(son);
+    }
+  }
+  return false;
+}
+
+/*
+ * True when both trees have the same shape, types and values.
+ */
+bool isSameTree(const Node* first, const Node* second) {
+  std::vector<std::pair<const Node*, const Node*>> stack{{first, second}};
+
+  while (!stack.empty()) {
+    const Node* node_a = stack.back().first;
+    const Node* node_b = stack.back().second;
+    stack.pop_back();
+
+    if (node_a == nullptr || node_b == nullptr) {
+      if (node_a != node_b) {
+        return false;
+      }
+      continue;
+    }
+    if (!(*node_a == *node_b) || node_a->sons.size() != node_b->sons.size()) {
+      return false;
+    }
+    for (size_t son_id = 0; son_id < node_a->sons.size(); ++son_id) {
+      stack.push_back({node_a->sons[son_id], node_b->sons[son_id]});
+    }
+  }
+  return true;
+}
+
+/*
+ * Resolves an if or while on a constant condition: an if is replaced by the
+ * block that runs, a while on false disappears (nullptr). Any other node is
+ * returned as it is.
+ */
+Node* resolveConstantLogic(Node* node) {
+  if (node->type != LOGIC || (node->value != IF && node->value != WHILE)) {
+    return node;
+  }
+
+  Node* condition = node->sons[0]->sons[0];
+  if (condition->type != NUMBER) {
+    return node;
+  }
+  if (node->value == WHILE) {
+    return condition->value == 0.0 ? nullptr : node;
+  }
+  if (condition->value != 0.0) {
+    return node->sons[1];
+  }
+  if (node->sons.size() < 3) {
+    return nullptr;
+  }
+
+  Node* else_node = node->sons[2];
+  else_node->value = CONDITION_MET;
+  return else_node;
+}
+
+/*
+ * Collects every variable that is written anywhere after its VAR_INIT
+ * entry: targets of assignments and of scan.
+ */
+class AssignedVarsFinder : public TreeVisitor {
+ private:
+  std::set<VarKey> assigned_;
+
+ protected:
+  bool preVisit(Node* node, int func_id) {
+    if (isAssignOperator(node) || (node->type == STANDART_FUNCTION && node->value == INPUT)) {
+      assigned_.insert(getVarKey(tree_, node->sons[0], func_id));
+    }
+    return true;
+  }
+
+ public:
+  explicit AssignedVarsFinder(const Tree& tree): TreeVisitor(tree) {}
+
+  const std::set<VarKey>& getAssigned() const {
+    return assigned_;
+  }
+};
+
+/*
+ * Counts the writes of every variable.
+ */
+class AssignCountFinder : public TreeVisitor {
+ private:
+  std::map<VarKey, size_t> counts_;
+
+ protected:
+  bool preVisit(Node* node, int func_id) {
+    if (isAssignOperator(node) || (node->type == STANDART_FUNCTION && node->value == INPUT)) {
+      ++counts_[getVarKey(tree_, node->sons[0], func_id)];
+    }
+    return true;
+  }
+
+ public:
+  explicit AssignCountFinder(const Tree& tree): TreeVisitor(tree) {}
+
+  size_t getCount(const VarKey& key) const {
+    auto count = counts_.find(key);
+    return count == counts_.end() ? 0 : count->second;
+  }
+};
+
+/*
+ * Like AssignedVarsFinder, but a call counts as a write of every global.
+ */
+class ModifiedVarsFinder : public AssignedVarsFinder {
+ private:
+  bool has_calls_{false};
+
+ protected:
+  bool preVisit(Node* node, int func_id) {
+    if (node->type == STANDART_FUNCTION && node->value == CALL) {
+      has_calls_ = true;
+    }
+    return AssignedVarsFinder::preVisit(node, func_id);
+  }
+
+ public:
+  explicit ModifiedVarsFinder(const Tree& tree): AssignedVarsFinder(tree) {}
+
+  bool isModified(const VarKey& key) const {
+    return getAssigned().count(key) != 0 || (key.func_id == -1 && has_calls_);
+  }
+};
+
+/*
+ * A while loop of a function with the block whose statement it is.
+ */
+struct LoopSite {
+  Node* loop;
+  Node* block;
+  int func_id;
+};
+
+/*
+ * Collects the while loops of functions, outer loops first.
+ */
+class LoopFinder : public TreeVisitor {
+ private:
+  std::vector<LoopSite> sites_;
+
+ protected:
+  bool preVisit(Node* node, int func_id) {
+    if (node->type == LOGIC && node->value == WHILE && func_id != -1) {
+      sites_.push_back({node, getAncestor(), func_id});
+    }
+    return true;
+  }
+
+ public:
+  explicit LoopFinder(const Tree& tree): TreeVisitor(tree) {}
+
+  const std::vector<LoopSite>& getSites() const {
+    return sites_;
+  }
+};
+
+/*
+ * Gives every function node the id the function has after
+ * Tree::compactFunctions and drops the nodes of dropped functions.
+ */
+class FuncRenumberer : public TreeRewriter {
+ private:
+  const std::vector<int>& new_ids_;
+
+ protected:
+  Node* rewrite(Node* node, int /* func_id */) {
+    if (node->type != USER_FUNCTION) {
+      return node;
+    }
+    if (new_ids_[static_cast<int>(node->value)] == -1) {
+      return nullptr;
+    }
+    node->value = new_ids_[static_cast<int>(node->value)];
+    return node;
+  }
+
+ public:
+  FuncRenumberer(Tree& tree, const std::vector<int>& new_ids): TreeRewriter(tree), new_ids_(new_ids) {}
+};
+
+/*
+ * Collects the functions called from every function, -1 standing for
+ * the initialisers of globals.
+ */
+class CallGraphFinder : public TreeVisitor {
+ private:
+  std::vector<std::set<int>> callees_;
+
+ protected:
+  bool preVisit(Node* node, int func_id) {
+    if (node->type == STANDART_FUNCTION && node->value == CALL) {
+      callees_[func_id + 1].insert(static_cast<int>(node->sons[0]->value));
+    }
+    return true;
+  }
+
+ public:
+  explicit CallGraphFinder(const Tree& tree): TreeVisitor(tree), callees_(tree.getFuncCnt() + 1) {}
+
+  std::vector<bool> findReachable() const {
+    std::vector<bool> reachable(callees_.size() - 1, false);
+    std::vector<int> stack{-1, tree_.getMainId()};
+
+    reachable[tree_.getMainId()] = true;
+    while (!stack.empty()) {
+      int func_id = stack.back();
+      stack.pop_back();
+
+      for (int callee: callees_[func_id + 1]) {
+        if (!reachable[callee]) {
+          reachable[callee] = true;
+          stack.push_back(callee);
+        }
+      }
+    }
+    return reachable;
+  }
+
+  /*
+   * True when the function can call itself, directly or through others.
+   */
+  bool isRecursive(int func_id) const {
+    std::vector<bool> visited(callees_.size() - 1, false);
+    std::vector<int> stack(callees_[func_id + 1].begin(), callees_[func_id + 1].end());
+
+    while (!stack.empty()) {
+      int callee = stack.back();
+      stack.pop_back();
+
+      if (callee == func_id) {
+        return true;
+      }
+      if (!visited[callee]) {
+        visited[callee] = true;
+        stack.insert(stack.end(), callees_[callee + 1].begin(), callees_[callee + 1].end());
+      }
+    }
+    return false;
+  }
+};
+
+/*
+ * Functions whose result depends on their arguments alone and that change
+ * nothing else: they neither read nor write globals, do no input or
+ * output and only call functions of the same kind. Every function starts
+ * pure and loses it together with its callers until nothing changes, so
+ * recursion by itself keeps a function pure.
+ */
+class PurityFinder : public TreeVisitor {
+ private:
+  std::vector<bool> locally_pure_;
+  std::vector<std::set<int>> callees_;
+
+ protected:
+  bool preVisit(Node* node, int func_id) {
+    if (func_id == -1) {
+      return true;
+    }
+    if (node->type == VARIABLE ||
+        (node->type == STANDART_FUNCTION && (node->value == INPUT || node->value == OUTPUT))) {
+      locally_pure_[func_id] = false;
+    }
+    if (node->type == STANDART_FUNCTION && node->value == CALL) {
+      callees_[func_id].insert(static_cast<int>(node->sons[0]->value));
+    }
+    return true;
+  }
+
+ public:
+  explicit PurityFinder(const Tree& tree):
+    TreeVisitor(tree), locally_pure_(tree.getFuncCnt(), true), callees_(tree.getFuncCnt()) {}
+
+  std::vector<bool> findPure() const {
+    std::vector<bool> pure = locally_pure_;
+    bool changed = true;
+
+    pure[tree_.getMainId()] = false;
+    while (changed) {
+      changed = false;
+      for (size_t func_id = 0; func_id < pure.size(); ++func_id) {
+        for (int callee: callees_[func_id]) {
+          if (pure[func_id] && !pure[callee]) {
+            pure[func_id] = false;
+            changed = true;
+          }
+        }
+      }
+    }
+    return pure;
+  }
+};
+
+/*
+ * Pure functions worth a lookup of their results: ones that loop or call
+ * functions other than by a tail call, and return a value on every way
+ * out. Memoized functions lose their tail calls, and a chain of tail calls
+ * would only grow the call stack and the table.
+ */
+std::vector<bool> findMemoizable(const Tree& tree) {
+  PurityFinder purity(tree);
+  purity.walk(tree.getRoot());
+  std::vector<bool> memoizable = purity.findPure();
+
+  for (int func_id = 0; func_id < static_cast<int>(memoizable.size()); ++func_id) {
+    const Node* func_node = tree.getFuncNode(func_id);
+    if (!memoizable[func_id] || func_node == nullptr || func_node->sons.empty() ||
+        func_node->sons.back()->type != RETURN) {
+      memoizable[func_id] = false;
+      continue;
+    }
+
+    bool does_work = false;
+    std::vector<const Node*> stack{func_node};
+    while (!stack.empty()) {
+      const Node* node = stack.back();
+      stack.pop_back();
+
+      if (node == nullptr) {
+        continue;
+      }
+      if (node->type == RETURN && node->sons.size() != 1) {
+        memoizable[func_id] = false;
+      }
+      if (node->type == RETURN && node->sons.size() == 1 && node->sons[0]->type == STANDART_FUNCTION &&
+          node->sons[0]->value == CALL) {
+        stack.insert(stack.end(), node->sons[0]->sons.begin(), node->sons[0]->sons.end());
+        continue;
+      }
+      does_work = does_work || (node->type == STANDART_FUNCTION && node->value == CALL) ||
+        (node->type == LOGIC && node->value == WHILE);
+      stack.insert(stack.end(), node->sons.begin(), node->sons.end());
+    }
+    memoizable[func_id] = memoizable[func_id] && does_work;
+  }
+  return memoizable;
+}
+
+/*
+ * Copies a tree node by node.
+ */
+Node* copyTree(Tree& tree, const Node* root) {
+  Node* root_copy = tree.newNode(root->type, root->value);
+  std::vector<std::pair<const Node*, Node*>> stack{{root, root_copy}};
+
+  while (!stack.empty()) {
+    const Node* node = stack.back().first;
+    Node* node_copy = stack.back().second;
+    stack.pop_back();
+
+    for (const Node* son: node->sons) {
+      Node* son_copy = (son == nullptr ? nullptr : tree.newNode(son->type, son->value));
+
+      node_copy->sons.push_back(son_copy);
+      if (son != nullptr) {
+        stack.push_back({son, son_copy});
+      }
+    }
+  }
+  return root_copy;
+}
+
+#endif //DED_PROG_LANG_TREE_ANALYSIS_H
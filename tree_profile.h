@@ -0,0 +1,174 @@
+//
+// Created by mike on 01.01.19.
+//
+
+#ifndef DED_PROG_LANG_TREE_PROFILE_H
+#define DED_PROG_LANG_TREE_PROFILE_H
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "exception.h"
+#include "profile.h"
+#include "tree.h"
+#include "tree_visitor.h"
+
+struct BranchCounts {
+  size_t then_cnt;
+  size_t else_cnt;
+};
+
+struct LoopCounts {
+  size_t entry_cnt;
+  size_t iteration_cnt;
+};
+
+/*
+ * A profile of the program compiled by the tree backend without passes,
+ * laid over the tree of a new compilation of the same code before any
+ * pass changes it. That backend numbers ifs and whiles in the order of a
+ * walk over the tree and marks where their conditions, then branches and
+ * loops start, and names functions by id, so the counts of those labels
+ * tell how often each branch ran, how many times each loop was entered
+ * and iterated and how many times each function was called. Nodes are
+ * looked up by address: copies passes make have no counts.
+ */
+class TreeProfile {
+ private:
+  static const size_t HOT_RATIO = 10;
+
+  class ControlFinder : public TreeVisitor {
+   private:
+    std::vector<Node*> ifs_;
+    std::vector<Node*> loops_;
+
+    bool preVisit(Node* node, int /* func_id */) {
+      if (node->type == LOGIC && node->value == IF) {
+        ifs_.push_back(node);
+      } else if (node->type == LOGIC && node->value == WHILE) {
+        loops_.push_back(node);
+      }
+      return true;
+    }
+
+   public:
+    explicit ControlFinder(const Tree& tree): TreeVisitor(tree) {}
+
+    const std::vector<Node*>& getIfs() const {
+      return ifs_;
+    }
+
+    const std::vector<Node*>& getLoops() const {
+      return loops_;
+    }
+  };
+
+  std::map<const Node*, BranchCounts> branches_;
+  std::map<const Node*, LoopCounts> loops_;
+  std::map<std::string, size_t> calls_;
+  size_t max_call_cnt_{0};
+  size_t max_iteration_cnt_{0};
+
+  static size_t getCount(const ExecutionProfile& profile, const std::string& label) {
+    if (!profile.hasLabel(label)) {
+      throw IncorrectArgumentException("the profile does not match the program, no label " + label,
+                                       __PRETTY_FUNCTION__);
+    }
+    return profile.getCount(label);
+  }
+
+  static void checkNoLabel(const ExecutionProfile& profile, const std::string& label) {
+    if (profile.hasLabel(label)) {
+      throw IncorrectArgumentException("the profile does not match the program, extra label " + label,
+                                       __PRETTY_FUNCTION__);
+    }
+  }
+
+ public:
+  TreeProfile(const Tree& tree, const ExecutionProfile& profile) {
+    ControlFinder finder(tree);
+    finder.walk(tree.getRoot());
+
+    for (size_t if_id = 0; if_id < finder.getIfs().size(); ++if_id) {
+      size_t cond_cnt = getCount(profile, "if_cond_" + std::to_string(if_id));
+      size_t then_cnt = getCount(profile, "if_then_" + std::to_string(if_id));
+
+      branches_[finder.getIfs()[if_id]] = {then_cnt, cond_cnt > then_cnt ? cond_cnt - then_cnt : 0};
+    }
+    checkNoLabel(profile, "if_cond_" + std::to_string(finder.getIfs().size()));
+
+    for (size_t loop_id = 0; loop_id < finder.getLoops().size(); ++loop_id) {
+      size_t entry_cnt = getCount(profile, "while_entry_" + std::to_string(loop_id));
+      size_t iteration_cnt = getCount(profile, "while_begin_" + std::to_string(loop_id));
+
+      loops_[finder.getLoops()[loop_id]] = {entry_cnt, iteration_cnt};
+      max_iteration_cnt_ = std::max(max_iteration_cnt_, iteration_cnt);
+    }
+    checkNoLabel(profile, "while_entry_" + std::to_string(finder.getLoops().size()));
+
+    for (int func_id = 0; func_id < static_cast<int>(tree.getFuncCnt()); ++func_id) {
+      if (func_id == tree.getMainId()) {
+        continue;
+      }
+      size_t call_cnt = getCount(profile, "func_" + std::to_string(func_id));
+
+      calls_[tree.getFuncName(func_id).str()] = call_cnt;
+      max_call_cnt_ = std::max(max_call_cnt_, call_cnt);
+    }
+    checkNoLabel(profile, "func_" + std::to_string(tree.getFuncCnt()));
+  }
+
+  const BranchCounts* findBranch(const Node* node) const {
+    auto found = branches_.find(node);
+
+    return found == branches_.end() ? nullptr : &found->second;
+  }
+
+  const LoopCounts* findLoop(const Node* node) const {
+    auto found = loops_.find(node);
+
+    return found == loops_.end() ? nullptr : &found->second;
+  }
+
+  void swapBranches(const Node* node) {
+    auto found = branches_.find(node);
+
+    if (found != branches_.end()) {
+      std::swap(found->second.then_cnt, found->second.else_cnt);
+    }
+  }
+
+  /*
+   * Functions and loops the run never reached are cold, those reached at
+   * least a HOT_RATIO-th as often as the busiest one are hot.
+   */
+  bool isColdFunction(const std::string& name) const {
+    auto found = calls_.find(name);
+
+    return found != calls_.end() && found->second == 0;
+  }
+
+  bool isHotFunction(const std::string& name) const {
+    auto found = calls_.find(name);
+
+    return found != calls_.end() && found->second != 0 && found->second * HOT_RATIO >= max_call_cnt_;
+  }
+
+  bool isColdLoop(const Node* node) const {
+    const LoopCounts* counts = findLoop(node);
+
+    return counts != nullptr && counts->entry_cnt == 0;
+  }
+
+  bool isHotLoop(const Node* node) const {
+    const LoopCounts* counts = findLoop(node);
+
+    return counts != nullptr && counts->iteration_cnt != 0 &&
+      counts->iteration_cnt * HOT_RATIO >= max_iteration_cnt_;
+  }
+};
+
+#endif //DED_PROG_LANG_TREE_PROFILE_H
@@ -0,0 +1,205 @@
+//
+// Created by mike on 23.12.18.
+//
+
+#ifndef DED_PROG_LANG_TREE_VISITOR_H
+#define DED_PROG_LANG_TREE_VISITOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "tree.h"
+
+/*
+ * Returns the function the sons of a node belong to: the sons of a
+ * function definition or of main live in its frame, the rest inherit the
+ * function of their father.
+ */
+int getSonFuncId(const Tree& tree, const Node* node, int func_id) {
+  if (node->type == USER_FUNCTION && !node->sons.empty()) {
+    return static_cast<int>(node->value);
+  }
+  if (node->type == MAIN) {
+    return tree.getMainId();
+  }
+  return func_id;
+}
+
+/*
+ * Read-only walk over a tree without recursion. preVisit is called before
+ * the sons of a node and may return false to skip them, postVisit after
+ * them. func_id is the function the node belongs to, -1 for globals.
+ */
+class TreeVisitor {
+ private:
+  struct VisitFrame {
+    Node* node;
+    int func_id;
+    size_t next_son;
+  };
+
+  std::vector<VisitFrame> frames_;
+
+ protected:
+  const Tree& tree_;
+
+  virtual bool preVisit(Node* /* node */, int /* func_id */) {
+    return true;
+  }
+
+  virtual void postVisit(Node* /* node */, int /* func_id */) {}
+
+  /*
+   * Ancestor of the node being visited: 1 is its father.
+   */
+  Node* getAncestor(size_t up = 1) const {
+    if (up >= frames_.size()) {
+      return nullptr;
+    }
+    return frames_[frames_.size() - 1 - up].node;
+  }
+
+ public:
+  explicit TreeVisitor(const Tree& tree): tree_(tree) {}
+
+  virtual ~TreeVisitor() {}
+
+  void walk(Node* root, int func_id = -1) {
+    if (root == nullptr) {
+      return;
+    }
+    frames_.clear();
+    frames_.push_back({root, func_id, 0});
+    if (!preVisit(root, func_id)) {
+      frames_.back().next_son = root->sons.size();
+    }
+
+    while (!frames_.empty()) {
+      VisitFrame& frame = frames_.back();
+
+      if (frame.next_son == frame.node->sons.size()) {
+        Node* node = frame.node;
+        int node_func_id = frame.func_id;
+
+        postVisit(node, node_func_id);
+        frames_.pop_back();
+        continue;
+      }
+
+      Node* son = frame.node->sons[frame.next_son++];
+      if (son == nullptr) {
+        continue;
+      }
+
+      int son_func_id = getSonFuncId(tree_, frame.node, frame.func_id);
+      frames_.push_back({son, son_func_id, 0});
+      if (!preVisit(son, son_func_id)) {
+        frames_.back().next_son = son->sons.size();
+      }
+    }
+  }
+};
+
+/*
+ * Post-order rewriting walk. rewrite is called after the sons of a node are
+ * rewritten and returns the node that takes its place: the node itself, a
+ * new one, or nullptr to drop it from the sons of its father.
+ */
+class TreeRewriter {
+ private:
+  struct RewriteFrame {
+    Node* node;
+    int func_id;
+    size_t next_son;
+    bool dropped_sons;
+  };
+
+  size_t rewrite_cnt_{0};
+
+ protected:
+  Tree& tree_;
+
+  virtual Node* rewrite(Node* node, int func_id) = 0;
+
+  /*
+   * Counts changes made in place, which do not replace the node.
+   */
+  void noteChanges(size_t change_cnt = 1) {
+    rewrite_cnt_ += change_cnt;
+  }
+
+ public:
+  explicit TreeRewriter(Tree& tree): tree_(tree) {}
+
+  virtual ~TreeRewriter() {}
+
+  size_t getRewriteCnt() const {
+    return rewrite_cnt_;
+  }
+
+  Node* walk(Node* root, int func_id = -1) {
+    if (root == nullptr) {
+      return nullptr;
+    }
+    std::vector<RewriteFrame> frames{{root, func_id, 0, false}};
+    Node* result = root;
+
+    while (!frames.empty()) {
+      RewriteFrame& frame = frames.back();
+
+      if (frame.next_son < frame.node->sons.size()) {
+        Node* son = frame.node->sons[frame.next_son++];
+
+        if (son != nullptr) {
+          frames.push_back({son, getSonFuncId(tree_, frame.node, frame.func_id), 0, false});
+        }
+        continue;
+      }
+
+      Node* node = frame.node;
+      if (frame.dropped_sons) {
+        node->sons.erase(std::remove(node->sons.begin(), node->sons.end(), nullptr), node->sons.end());
+      }
+
+      Node* new_node = rewrite(node, frame.func_id);
+      frames.pop_back();
+      if (new_node != node) {
+        ++rewrite_cnt_;
+      }
+      if (frames.empty()) {
+        result = new_node;
+        break;
+      }
+
+      RewriteFrame& father = frames.back();
+      father.node->sons[father.next_son - 1] = new_node;
+      if (new_node == nullptr) {
+        father.dropped_sons = true;
+      }
+    }
+    return result;
+  }
+};
+
+/*
+ * Number of nodes under root, root included.
+ */
+size_t countNodes(const Tree& tree, Node* root) {
+  struct NodeCounter : public TreeVisitor {
+    size_t node_cnt{0};
+
+    explicit NodeCounter(const Tree& tree): TreeVisitor(tree) {}
+
+    bool preVisit(Node* /* node */, int /* func_id */) {
+      ++node_cnt;
+      return true;
+    }
+  };
+
+  NodeCounter counter(tree);
+  counter.walk(root);
+  return counter.node_cnt;
+}
+
+#endif //DED_PROG_LANG_TREE_VISITOR_H
@@ -0,0 +1,105 @@
+//
+// Created by mike on 23.12.18.
+//
+
+#ifndef DED_PROG_LANG_VERIFY_PASS_H
+#define DED_PROG_LANG_VERIFY_PASS_H
+
+#include <string>
+
+#include "exception.h"
+#include "pass_manager.h"
+#include "tree.h"
+#include "tree_visitor.h"
+
+/*
+ * Checks the shape of the tree the back end relies on: son counts of
+ * operators, logic blocks and calls, and variable slots inside their frames.
+ * Meant to run between other passes while debugging them.
+ */
+class VerifyPass : public Pass {
+ private:
+  struct Verifier : public TreeVisitor {
+    explicit Verifier(const Tree& tree): TreeVisitor(tree) {}
+
+    void check(bool condition, const Node* node, const std::string& message) const {
+      if (!condition) {
+        throw IncorrectArgumentException("broken tree at node " + std::to_string(node->type) + " " +
+                                           std::to_string(node->value) + ": " + message, __PRETTY_FUNCTION__);
+      }
+    }
+
+    void checkSlot(const Node* node, int slot_cnt) const {
+      check(node->value >= 0 && node->value < slot_cnt, node, "slot out of the frame");
+    }
+
+    bool preVisit(Node* node, int func_id) {
+      for (const Node* son: node->sons) {
+        check(son != nullptr, node, "empty son");
+      }
+
+      size_t son_cnt = node->sons.size();
+      switch (node->type) {
+        case ROOT:
+          check(son_cnt == 3, node, "root needs globals, functions and main");
+          break;
+        case VARIABLE:
+          checkSlot(node, tree_.getGlobalCnt());
+          break;
+        case LOCAL_VARIABLE:
+          check(func_id != -1, node, "local variable outside of a function");
+          checkSlot(node, tree_.getVarCnt(func_id));
+          break;
+        case PARAM:
+          check(func_id != -1, node, "parameter outside of a function");
+          checkSlot(node, tree_.getParamCnt(func_id));
+          break;
+        case OPERATOR:
+          if (node->value == BOOL_NOT) {
+            check(son_cnt == 1, node, "! takes one operand");
+          } else if (node->value == MINUS) {
+            check(son_cnt == 1 || son_cnt == 2, node, "- takes one or two operands");
+          } else {
+            check(son_cnt == 2, node, "binary operator takes two operands");
+          }
+          if (node->value == EQUAL || node->value >= PLUS_EQUAL) {
+            NodeType target = node->sons[0]->type;
+
+            check(target == VARIABLE || target == LOCAL_VARIABLE || target == PARAM, node,
+                  "assignment to not a variable");
+          }
+          break;
+        case LOGIC:
+          if (node->value == IF) {
+            check(son_cnt == 2 || son_cnt == 3, node, "if needs a condition, a block and maybe else");
+          } else if (node->value == WHILE) {
+            check(son_cnt == 2, node, "while needs a condition and a block");
+          }
+          break;
+        case STANDART_FUNCTION:
+          if (node->value == CALL) {
+            check(son_cnt >= 1 && node->sons[0]->type == USER_FUNCTION, node, "call without a function");
+            check(static_cast<int>(son_cnt) - 1 == tree_.getParamCnt(node->sons[0]->value), node,
+                  "wrong argument count");
+          } else {
+            check(son_cnt == 1, node, "standart function takes one argument");
+          }
+          break;
+        case RETURN:
+          check(son_cnt <= 1, node, "return takes at most one value");
+          break;
+        default:
+          break;
+      }
+      return true;
+    }
+  };
+
+ public:
+  size_t run(Tree& tree) {
+    Verifier(tree).walk(tree.getRoot());
+    return 0;
+  }
+};
+
+#endif //DED_PROG_LANG_VERIFY_PASS_H
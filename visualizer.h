@@ -10,6 +10,8 @@
 #include <cstring>
 #include <string>
 #include <vector>
+#include "common_classes.h"
+#include "flat_tree.h"
 #include "tree.h"
 
 struct VisualizerException : public std::exception {
@@ -29,216 +31,42 @@ std::ostream& operator<<(std::ostream& os, const VisualizerException& exception)
   return os;
 }
 
-struct VisFuncBlock {
-  std::vector<std::string> params;
-  std::vector<std::string> variables;
-};
-
 class Visualizer {
  private:
-  const static size_t MAX_BUF_SIZE = 4096;
-
-  char buf_[MAX_BUF_SIZE];
-  size_t buf_size_;
-  char* buf_ptr_;
-  Tree tree_;
-  FILE* tree_file_;
-
-  void skipSpaceChars() {
-    while (!done() && std::isspace(*buf_ptr_)) {
-      ++buf_ptr_;
-    }
-  }
-
-  std::vector<std::string> variables_;
-  std::vector<std::string> funcs_;
-  std::vector<VisFuncBlock> func_blocks_;
+  MappedFile tree_map_;
+  FlatTree flat_;
   size_t node_cnt_ = 0;
 
  public:
-  Visualizer(FILE* input) {
-    buf_size_ = fread((void*)buf_, sizeof(char), MAX_BUF_SIZE - 1, input);
-    buf_ptr_ = buf_;
-    //std::cout << "size of code buffer: " << buf_size_ << '\n';
-  }
-
-  bool done() const {
-    return buf_ptr_ == buf_ + buf_size_;
-  }
-
-  std::string parseInt() {
-    std::string result = "";
-
-    skipSpaceChars();
-    if (*buf_ptr_ == '-') {
-      result.push_back('-');
-      ++buf_ptr_;
-    }
-    while (!done() && std::isdigit(*buf_ptr_)) {
-      result.push_back(*buf_ptr_);
-      ++buf_ptr_;
-    }
-    if (result == "-") {
-      result = "";
-      --buf_ptr_;
-    }
-    skipSpaceChars();
-    return result;
-  }
-
-  std::string parseDouble() {
-    std::string result = parseInt();
-
-    if (done() || *buf_ptr_ != '.' || result == "") {
-      return result;
-    }
-    result.push_back('.');
-    ++buf_ptr_;
-    while (!done() && std::isdigit(*buf_ptr_)) {
-      result.push_back(*buf_ptr_);
-      ++buf_ptr_;
-    }
-    skipSpaceChars();
-    return result;
-  }
-
-  bool parseString(const std::string& str) {
-    size_t char_id = 0;
-    char* was_ptr = buf_ptr_;
-
-    skipSpaceChars();
-    while (!done() && char_id < str.size()) {
-      if (str[char_id] != *buf_ptr_) {
-        break;
-      }
-      ++char_id;
-      ++buf_ptr_;
-    }
-    if (char_id < str.size()) {
-      buf_ptr_ = was_ptr;
-      return false;
-    }
-    skipSpaceChars();
-
-    return true;
-  }
-
-  std::string parseName() {
-    std::string result = "";
-
-    skipSpaceChars();
-    while (!done() && !std::isspace(*buf_ptr_) && *buf_ptr_ != ']') {
-      result.push_back(*buf_ptr_);
-      ++buf_ptr_;
-    }
-    skipSpaceChars();
-
-    return result;
-  }
-
-  Node* parseNode() {
-    try {
-      //std::cout << "begin\n";
-      if (!parseString("[")) {
-        throw VisualizerException(std::string("[ was expected but not ") + *buf_ptr_,
-                                  __PRETTY_FUNCTION__);
-      }
-
-      NodeType node_type = static_cast<NodeType>(atoi(parseInt().c_str()));
-      double node_value = atof(parseDouble().c_str());
-      Node* result_node = Tree::allocator_.init_alloc(Node{node_type, node_value});
-
-      //std::cout << node_type << ' ' << node_value << '\n';
-
-      while (!done() && *buf_ptr_ == '[') {
-        Node* son_node = parseNode();
-        result_node->sons.push_back(son_node);
-      }
-      ////std::cout << buf_ + buf_size_ - buf_ptr_ << '\n';
-
-      if (!parseString("]")) {
-        throw VisualizerException(std::string("] was expected but not ") + *buf_ptr_,
-                                  __PRETTY_FUNCTION__);
-      }
-      //std::cout << "end\n";
-      return result_node;
-    } catch (VisualizerException& exc) {
-      throw exc;
-    }
-  }
+  Visualizer(const char* tree_filename): tree_map_(tree_filename) {}
 
   void makeTree() {
     try {
-      if (!parseString("VARS")) {
-        throw VisualizerException("where is VARS?", __PRETTY_FUNCTION__);
-      }
-      size_t var_cnt = atoi(parseInt().c_str());
-
-      for (size_t var_id = 0; var_id < var_cnt; ++var_id) {
-        variables_.push_back(parseName());
+      if (tree_map_.getData() == nullptr) {
+        throw VisualizerException("tree file is missing or empty", __PRETTY_FUNCTION__);
       }
-
-      if (!parseString("FUNCS")) {
-        throw VisualizerException("where is FUNCS?", __PRETTY_FUNCTION__);
-      }
-      size_t func_cnt = atoi(parseInt().c_str());
-     // std::cerr << "func_cnt " << func_cnt << '\n';
-
-      for (size_t func_id = 0; func_id < func_cnt; ++func_id) {
-        std::string func_name = parseName();
-        if (func_name.empty()) {
-          throw VisualizerException("function name is empty", __PRETTY_FUNCTION__);
-        }
-        std::cerr << "function " << func_name << '\n';
-
-        func_name.erase(func_name.size() - 1, 1);
-        funcs_.push_back(func_name);
-        func_blocks_.push_back(VisFuncBlock());
-
-        if (!parseString("PARAMS")) {
-          std::cerr << *buf_ptr_ << '\n';
-          throw VisualizerException("where is PARAMS?", __PRETTY_FUNCTION__);
-        }
-        size_t param_cnt = atoi(parseInt().c_str());
-        std::cerr << "param cnt " << param_cnt << '\n';
-        for (size_t param_id = 0; param_id < param_cnt; ++param_id) {
-          std::string param_name = parseName();
-
-          func_blocks_[func_id].params.push_back(param_name);
-          std::cerr << "param " << param_name << '\n';
-        }
-
-        if (!parseString("NEWVAR")) {
-          std::cerr << *buf_ptr_ << '\n';
-          throw VisualizerException("where is NEWVAR?", __PRETTY_FUNCTION__);
-        }
-        size_t var_cnt = atoi(parseInt().c_str());
-        std::cerr << "var cnt " << var_cnt << '\n';
-        for (size_t var_id = 0; var_id < var_cnt; ++var_id) {
-          std::string param_name = parseName();
-
-          func_blocks_[func_id].variables.push_back(param_name);
-          std::cerr << "var " << param_name << '\n';
-        }
-
-      }
-      tree_.setRoot(parseNode());
-      //std::cout << "root was parsed\n";
+      flat_.load(tree_map_.getData(), tree_map_.getSize());
+      std::cerr << "tree file: " << flat_.getNodeCnt() << " nodes, " << flat_.getFuncCnt() << " functions\n";
     } catch (VisualizerException& exc) {
       std::cerr << exc;
+    } catch (IncorrectTreeFileException& exc) {
+      std::cerr << exc;
     }
   }
 
-  size_t showRec(Node* node, FILE* file, int func_id) {
-    size_t cur_num = node_cnt_++;
+  /*
+   * Prints the label of a node and returns the function which its sons
+   * belong to.
+   */
+  int showNodeLabel(uint32_t node_id, FILE* file, int func_id, size_t cur_num) {
     fprintf(file, "node%zu [label=%c", cur_num, static_cast<char>(34));
-    double value = node->value;
-    int int_value = static_cast<int>(node->value);
+    double value = flat_.getValue(node_id);
+    int int_value = static_cast<int>(value);
 
-    std::cerr << node->type << ' ' << node->value << '\n';
+    std::cerr << flat_.getType(node_id) << ' ' << value << '\n';
     std::cerr << func_id << '\n';
 
-    switch (node->type) {
+    switch (flat_.getType(node_id)) {
       case ROOT:
         fprintf(file, "root");
         break;
@@ -246,7 +74,7 @@ class Visualizer {
         fprintf(file, "funcs");
         break;
       case USER_FUNCTION:
-        fprintf(file, "%s", funcs_[int_value].c_str());
+        fprintf(file, "%s", flat_.getFuncName(int_value));
         if (func_id == -1) {
           func_id = int_value;
         }
@@ -259,18 +87,14 @@ class Visualizer {
         }
         break;
       case VARIABLE:
-        if (func_id == -1) {
-          fprintf(file, "%s", variables_[int_value].c_str());
-        } else {
-          fprintf(file, "%s", func_blocks_[func_id].variables[int_value].c_str());
-        }
+        fprintf(file, "%s", flat_.getGlobalName(int_value));
         break;
       case LOCAL_VARIABLE:
-        fprintf(file, "%s", func_blocks_[func_id].variables[int_value].c_str());
+        fprintf(file, "%s", flat_.getVarName(func_id, int_value));
         break;
       case OPERATOR:
       {
-        int operator_type = static_cast<int>(node->value);
+        int operator_type = int_value;
 
         switch (operator_type) {
           case EQUAL:
@@ -335,7 +159,7 @@ class Visualizer {
       }
       case LOGIC:
       {
-        int logic_type = static_cast<int>(node->value);
+        int logic_type = int_value;
 
         switch (logic_type) {
           case IF:
@@ -357,12 +181,12 @@ class Visualizer {
         break;
       }
       case MAIN:
-        func_id = funcs_.size() - 1;
+        func_id = flat_.getMainId();
         fprintf(file, "main");
         break;
       case STANDART_FUNCTION:
       {
-        int func_type = static_cast<int>(node->value);
+        int func_type = int_value;
 
         switch (func_type) {
           case INPUT:
@@ -392,33 +216,55 @@ class Visualizer {
         fprintf(file, "return");
         break;
       case PARAM:
-        fprintf(file, "%s", func_blocks_[func_id].params[int_value].c_str());
+        fprintf(file, "%s", flat_.getParamName(func_id, int_value));
         break;
 
       default:
         break;
     }
     fprintf(file, "%c];", static_cast<char>(34));
+    return func_id;
+  }
+
+  struct ShowFrame {
+    uint32_t node_id;
+    int func_id;
+    size_t num;
+    size_t next_son;
+  };
 
-    if (node->type == STANDART_FUNCTION && node->value == CALL) {
-      int cur_func_id = node->sons[0]->value;
+  size_t showRec(uint32_t root, FILE* file, int root_func_id) {
+    size_t root_num = node_cnt_++;
+    std::vector<ShowFrame> frames;
 
-      size_t first_son_num = showRec(node->sons[0], file, cur_func_id);
-      fprintf(file, "  node%zu->node%zu;\n", cur_num, first_son_num);
+    frames.push_back({root, showNodeLabel(root, file, root_func_id, root_num), root_num, 0});
 
-      for (size_t son_id = 1; son_id < node->sons.size(); ++son_id) {
-        size_t son_num = showRec(node->sons[son_id], file, func_id);
+    while (!frames.empty()) {
+      ShowFrame& frame = frames.back();
 
-        fprintf(file, "  node%zu->node%zu;\n", cur_num, son_num);
+      if (frame.next_son == flat_.getSonCnt(frame.node_id)) {
+        size_t son_num = frame.num;
+
+        frames.pop_back();
+        if (!frames.empty()) {
+          fprintf(file, "  node%zu->node%zu;\n", frames.back().num, son_num);
+        }
+        continue;
       }
-      return cur_num;
-    }
-    for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-      size_t son_num = showRec(node->sons[son_id], file, func_id);
 
-      fprintf(file, "  node%zu->node%zu;\n", cur_num, son_num);
+      uint32_t son = flat_.getSon(frame.node_id, frame.next_son);
+      int son_func_id = frame.func_id;
+
+      if (flat_.getType(frame.node_id) == STANDART_FUNCTION && flat_.getPayload(frame.node_id) == CALL &&
+          frame.next_son == 0) {
+        son_func_id = flat_.getPayload(son);
+      }
+      ++frame.next_son;
+
+      size_t son_num = node_cnt_++;
+      frames.push_back({son, showNodeLabel(son, file, son_func_id, son_num), son_num, 0});
     }
-    return cur_num;
+    return root_num;
   }
 
   void printLevel(int level, FILE* file) {
@@ -432,278 +278,306 @@ class Visualizer {
         || lang_oper == MULTIPLY_EQUAL || lang_oper == DIVIDE_EQUAL;
   }
 
-  void translateRec(Node* node, FILE* file, int func_id, int level) {
-    size_t cur_num = node_cnt_++;
-    double value = node->value;
-    int int_value = static_cast<int>(node->value);
+  /*
+   * Translation keeps pending work on a stack like the code generator in
+   * code_generator.h: a task is either a node to expand or a ready piece of
+   * text.
+   */
+  struct TranslateTask {
+    uint32_t node_id;
+    int func_id;
+    int level;
+    std::string text;
+  };
+
+  class TranslateTaskList {
+   private:
+    std::vector<TranslateTask> tasks_;
+
+   public:
+    void visit(uint32_t node_id, int func_id, int level) {
+      if (node_id != FlatTree::NO_NODE) {
+        tasks_.push_back({node_id, func_id, level, ""});
+      }
+    }
+
+    void visitSons(const FlatTree& tree, uint32_t node_id, int func_id, int level, uint32_t first_son = 0) {
+      for (uint32_t son_pos = first_son; son_pos < tree.getSonCnt(node_id); ++son_pos) {
+        visit(tree.getSon(node_id, son_pos), func_id, level);
+      }
+    }
+
+    void emit(const std::string& text) {
+      tasks_.push_back({FlatTree::NO_NODE, 0, 0, text});
+    }
+
+    void emitLevel(int level) {
+      emit(std::string(2 * level, ' '));
+    }
+
+    void moveTo(std::vector<TranslateTask>& stack) {
+      for (auto iter = tasks_.rbegin(); iter != tasks_.rend(); ++iter) {
+        stack.push_back(std::move(*iter));
+      }
+      tasks_.clear();
+    }
+  };
+
+  std::string numberText(double value) const {
+    char text[64];
+    int int_value = static_cast<int>(value);
+
+    if (value != int_value) {
+      snprintf(text, sizeof(text), "%.6f", value);
+    } else {
+      snprintf(text, sizeof(text), "%d", int_value);
+    }
+    return text;
+  }
+
+  std::string operatorText(int operator_type, size_t son_cnt) const {
+    switch (operator_type) {
+      case EQUAL:
+        return " = ";
+      case PLUS:
+        return " + ";
+      case MINUS:
+        return son_cnt == 2 ? " - " : "-";
+      case MULTIPLY:
+        return " * ";
+      case DIVIDE:
+        return " / ";
+      case POWER:
+        return " ^ ";
+      case BOOL_EQUAL:
+        return " == ";
+      case BOOL_NOT_EQUAL:
+        return " != ";
+      case BOOL_LOWER:
+        return " < ";
+      case BOOL_GREATER:
+        return " > ";
+      case BOOL_NOT_LOWER:
+        return " >= ";
+      case BOOL_NOT_GREATER:
+        return " <= ";
+      case BOOL_NOT:
+        return "!";
+      case BOOL_OR:
+        return " || ";
+      case BOOL_AND:
+        return " && ";
+      case PLUS_EQUAL:
+        return " += ";
+      case MINUS_EQUAL:
+        return " -= ";
+      case MULTIPLY_EQUAL:
+        return " *= ";
+      case DIVIDE_EQUAL:
+        return " /= ";
+      default:
+        return "";
+    }
+  }
+
+  void translateLogicBlock(const std::string& header, uint32_t cond_id, uint32_t block_id,
+                           TranslateTaskList& tasks, int func_id, int level) {
+    tasks.emitLevel(level);
+    tasks.emit(header);
+    if (cond_id != FlatTree::NO_NODE) {
+      tasks.emit(" (");
+      tasks.visit(cond_id, func_id, level);
+      tasks.emit(")");
+    }
+    tasks.emit("\n");
+    tasks.emitLevel(level);
+    tasks.emit("lol\n");
+    tasks.visit(block_id, func_id, level + 1);
+    tasks.emitLevel(level);
+    tasks.emit("kek\n\n");
+  }
+
+  void expandTranslateNode(uint32_t node_id, TranslateTaskList& tasks, int func_id, int level) {
+    int int_value = flat_.getPayload(node_id);
+    uint32_t son_cnt = flat_.getSonCnt(node_id);
 
-    std::cerr << "translate " << node->type << ' ' << node->value << '\n';
+    std::cerr << "translate " << flat_.getType(node_id) << ' ' << flat_.getValue(node_id) << '\n';
     std::cerr << "translate " << func_id << '\n';
 
-    switch (node->type) {
+    switch (flat_.getType(node_id)) {
       case ROOT:
-        break;
       case FUNCS:
-        break;
+        tasks.visitSons(flat_, node_id, func_id, level);
+        return;
       case USER_FUNCTION:
-        fprintf(file, "func %s(", funcs_[int_value].c_str());
-        func_id = int_value;
-        for (size_t param_id = 0; param_id < func_blocks_[int_value].params.size(); ++param_id) {
-          fprintf(file, "%s", func_blocks_[int_value].params[param_id].c_str());
-          if (param_id + 1 != func_blocks_[int_value].params.size()) {
-            fprintf(file, ", ");
+      {
+        std::string header = std::string("func ") + flat_.getFuncName(int_value) + "(";
+
+        for (size_t param_id = 0; param_id < flat_.getParamCnt(int_value); ++param_id) {
+          header += flat_.getParamName(int_value, param_id);
+          if (param_id + 1 != flat_.getParamCnt(int_value)) {
+            header += ", ";
           }
         }
-        fprintf(file, ")\n");
-        fprintf(file, "lol\n");
-        for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-          translateRec(node->sons[son_id], file, func_id, level + 1);
-        }
-        fprintf(file, "kek\n\n");
+        tasks.emit(header + ")\n");
+        tasks.emit("lol\n");
+        tasks.visitSons(flat_, node_id, int_value, level + 1);
+        tasks.emit("kek\n\n");
         return;
+      }
       case NUMBER:
-        if (value != int_value) {
-          fprintf(file, "%.6f", value);
-        } else {
-          fprintf(file, "%d", int_value);
-        }
-        break;
+        tasks.emit(numberText(flat_.getValue(node_id)));
+        return;
       case VARIABLE:
-        if (func_id == -1) {
-          fprintf(file, "%s", variables_[int_value].c_str());
-        } else {
-          fprintf(file, "%s", func_blocks_[func_id].variables[int_value].c_str());
-        }
-        break;
+        tasks.emit(flat_.getGlobalName(int_value));
+        return;
       case LOCAL_VARIABLE:
-        fprintf(file, "%s", func_blocks_[func_id].variables[int_value].c_str());
-        break;
+        tasks.emit(flat_.getVarName(func_id, int_value));
+        return;
       case OPERATOR:
       {
-        int operator_type = static_cast<int>(node->value);
-
-        if (isAssign(operator_type)) {
-          printLevel(level, file);
-          translateRec(node->sons[0], file, func_id, level);
-        } else if (node->sons.size() == 2) {
-          fprintf(file, "(");
-          translateRec(node->sons[0], file, func_id, level);
-          fprintf(file, ")");
+        if (isAssign(int_value)) {
+          tasks.emitLevel(level);
+          tasks.visit(flat_.getSon(node_id, 0), func_id, level);
+        } else if (son_cnt == 2) {
+          tasks.emit("(");
+          tasks.visit(flat_.getSon(node_id, 0), func_id, level);
+          tasks.emit(")");
         }
-
-        switch (operator_type) {
-          case EQUAL:
-            fprintf(file, " = ");
-            break;
-          case PLUS:
-            fprintf(file, " + ");
-            break;
-          case MINUS:
-            if (node->sons.size() == 2) {
-              fprintf(file, " - ");
-            } else {
-              fprintf(file, "-");
-            }
-            break;
-          case MULTIPLY:
-            fprintf(file, " * ");
-            break;
-          case DIVIDE:
-            fprintf(file, " / ");
-            break;
-          case POWER:
-            fprintf(file, " ^ ");
-            break;
-          case BOOL_EQUAL:
-            fprintf(file, " == ");
-            break;
-          case BOOL_NOT_EQUAL:
-            fprintf(file, " != ");
-            break;
-          case BOOL_LOWER:
-            fprintf(file, " < ");
-            break;
-          case BOOL_GREATER:
-            fprintf(file, " > ");
-            break;
-          case BOOL_NOT_LOWER:
-            fprintf(file, " >= ");
-            break;
-          case BOOL_NOT_GREATER:
-            fprintf(file, " <= ");
-            break;
-          case BOOL_NOT:
-            fprintf(file, "!");
-            break;
-          case BOOL_OR:
-            fprintf(file, " || ");
-            break;
-          case BOOL_AND:
-            fprintf(file, " && ");
-            break;
-          case PLUS_EQUAL:
-            fprintf(file, " += ");
-            break;
-          case MINUS_EQUAL:
-            fprintf(file, " -= ");
-            break;
-          case MULTIPLY_EQUAL:
-            fprintf(file, " *= ");
-            break;
-          case DIVIDE_EQUAL:
-            fprintf(file, " /= ");
-            break;
-        }
-        if (node->sons.size() == 2) {
-          translateRec(node->sons[1], file, func_id, level);
-        } else {
-          translateRec(node->sons[0], file, func_id, level);
-        }
-        if (isAssign(operator_type)) {
-          fprintf(file, ";\n");
+        tasks.emit(operatorText(int_value, son_cnt));
+        tasks.visit(flat_.getLastSon(node_id), func_id, level);
+        if (isAssign(int_value)) {
+          tasks.emit(";\n");
         }
         return;
       }
       case LOGIC:
       {
-        int logic_type = static_cast<int>(node->value);
-
-        switch (logic_type) {
+        switch (int_value) {
           case IF:
-            printLevel(level, file);
-            fprintf(file, "if (");
-            translateRec(node->sons[0], file, func_id, level);
-            fprintf(file, ")\n");
-            printLevel(level, file);
-            fprintf(file, "lol\n");
-            translateRec(node->sons[1], file, func_id, level + 1);
-            printLevel(level, file);
-            fprintf(file, "kek\n\n");
+            translateLogicBlock("if", flat_.getSon(node_id, 0), flat_.getSon(node_id, 1), tasks, func_id, level);
+            if (son_cnt > 2) {
+              tasks.visit(flat_.getSon(node_id, 2), func_id, level);
+            }
             return;
           case ELSE:
-            printLevel(level, file);
-            fprintf(file, "else\n");
-            printLevel(level, file);
-            fprintf(file, "lol\n");
-            translateRec(node->sons[1], file, func_id, level + 1);
-            printLevel(level, file);
-            fprintf(file, "kek\n\n");
+            tasks.emitLevel(level);
+            tasks.emit("else\n");
+            tasks.emitLevel(level);
+            tasks.emit("lol\n");
+            tasks.visitSons(flat_, node_id, func_id, level + 1);
+            tasks.emitLevel(level);
+            tasks.emit("kek\n\n");
             return;
           case WHILE:
-            printLevel(level, file);
-            fprintf(file, "while (");
-            translateRec(node->sons[0], file, func_id, level);
-            fprintf(file, ")\n");
-            printLevel(level, file);
-            fprintf(file, "lol\n");
-            translateRec(node->sons[1], file, func_id, level + 1);
-            printLevel(level, file);
-            fprintf(file, "kek\n\n");
+            translateLogicBlock("while", flat_.getSon(node_id, 0), flat_.getSon(node_id, 1), tasks, func_id, level);
             return;
           case CONDITION:
-            translateRec(node->sons[0], file, func_id, level);
-            return;
           case CONDITION_MET:
-            for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-              translateRec(node->sons[son_id], file, func_id, level);
-            }
+            tasks.visitSons(flat_, node_id, func_id, level);
             return;
         }
-       return;
+        return;
       }
       case MAIN:
-        func_id = funcs_.size() - 1;
-        fprintf(file, "main()");
-        fprintf(file, "\nlol\n");
-        for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-          translateRec(node->sons[son_id], file, func_id, level + 1);
-        }
-        fprintf(file, "\nkek\n");
+        func_id = flat_.getMainId();
+        tasks.emit("main()");
+        tasks.emit("\nlol\n");
+        tasks.visitSons(flat_, node_id, func_id, level + 1);
+        tasks.emit("\nkek\n");
         return;
       case STANDART_FUNCTION:
       {
-        int func_type = static_cast<int>(node->value);
-
-        switch (func_type) {
+        switch (int_value) {
           case INPUT:
-            printLevel(level, file);
-            fprintf(file, "scan(");
+            tasks.emitLevel(level);
+            tasks.emit("scan(");
             break;
           case OUTPUT:
-            printLevel(level, file);
-            fprintf(file, "print(");
+            tasks.emitLevel(level);
+            tasks.emit("print(");
             break;
           case SIN:
-            fprintf(file, "sin(");
+            tasks.emit("sin(");
             break;
           case COS:
-            fprintf(file, "cos(");
+            tasks.emit("cos(");
             break;
           case SQ_ROOT:
-            fprintf(file, "sqrt(");
+            tasks.emit("sqrt(");
             break;
           case CALL:
           {
-            int cur_func_id = node->sons[0]->value;
+            int cur_func_id = flat_.getPayload(flat_.getSon(node_id, 0));
             std::cerr << "call function " << cur_func_id << '\n';
 
-            fprintf(file, "%s(", funcs_[cur_func_id].c_str());
-            //func_id = int_value;
-            for (size_t param_id = 1; param_id < node->sons.size(); ++param_id) {
-              translateRec(node->sons[param_id], file, func_id, level);
-              if (param_id + 1 != node->sons.size()) {
-                fprintf(file, ", ");
+            tasks.emit(std::string(flat_.getFuncName(cur_func_id)) + "(");
+            for (uint32_t param_id = 1; param_id < son_cnt; ++param_id) {
+              tasks.visit(flat_.getSon(node_id, param_id), func_id, level);
+              if (param_id + 1 != son_cnt) {
+                tasks.emit(", ");
               }
             }
-            fprintf(file, ")");
-
+            tasks.emit(")");
             return;
           }
         }
-        translateRec(node->sons[0], file, func_id, level);
-        fprintf(file, ")");
-        if (func_type == INPUT || func_type == OUTPUT) {
-          fprintf(file, ";\n");
+        tasks.visit(flat_.getSon(node_id, 0), func_id, level);
+        tasks.emit(")");
+        if (int_value == INPUT || int_value == OUTPUT) {
+          tasks.emit(";\n");
         }
         return;
       }
       case VAR_INIT:
-        if (func_id == -1) {
-          for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-            printLevel(level, file);
-            fprintf(file, "float %s = ", variables_[son_id].c_str());
-            translateRec(node->sons[son_id], file, func_id, level);
-            fprintf(file, ";\n");
-          }
-        } else {
-          printLevel(level, file);
-          for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-            fprintf(file, "float %s = ", func_blocks_[func_id].variables[son_id].c_str());
-            translateRec(node->sons[son_id], file, func_id, level);
-            fprintf(file, ";\n");
+        for (uint32_t son_pos = 0; son_pos < son_cnt; ++son_pos) {
+          tasks.emitLevel(level);
+          if (func_id == -1) {
+            tasks.emit(std::string("float ") + flat_.getGlobalName(son_pos) + " = ");
+          } else {
+            tasks.emit(std::string("float ") + flat_.getVarName(func_id, son_pos) + " = ");
           }
+          tasks.visit(flat_.getSon(node_id, son_pos), func_id, level);
+          tasks.emit(";\n");
         }
         return;
       case RETURN:
-        printLevel(level, file);
-        fprintf(file, "return");
-        if (node->sons.size() == 1) {
-          fprintf(file, " ");
-          translateRec(node->sons[0], file, func_id, level);
+        tasks.emitLevel(level);
+        tasks.emit("return");
+        if (son_cnt == 1) {
+          tasks.emit(" ");
+          tasks.visit(flat_.getSon(node_id, 0), func_id, level);
         }
-        fprintf(file, ";\n");
+        tasks.emit(";\n");
         return;
       case PARAM:
-        fprintf(file, "%s", func_blocks_[func_id].params[int_value].c_str());
-        break;
+        tasks.emit(flat_.getParamName(func_id, int_value));
+        return;
 
       default:
-        break;
+        tasks.visitSons(flat_, node_id, func_id, level);
+        return;
     }
-    for (size_t son_id = 0; son_id < node->sons.size(); ++son_id) {
-      translateRec(node->sons[son_id], file, func_id, level);
+  }
+
+  void translateRec(uint32_t root, FILE* file, int root_func_id, int root_level) {
+    std::vector<TranslateTask> stack;
+    TranslateTaskList tasks;
+
+    tasks.visit(root, root_func_id, root_level);
+    tasks.moveTo(stack);
+
+    while (!stack.empty()) {
+      TranslateTask task = std::move(stack.back());
+      stack.pop_back();
+
+      if (task.node_id == FlatTree::NO_NODE) {
+        fputs(task.text.c_str(), file);
+        continue;
+      }
+      expandTranslateNode(task.node_id, tasks, task.func_id, task.level);
+      tasks.moveTo(stack);
     }
-    return;
   }
 
   void show(const std::string& tree_filename) {
@@ -712,7 +586,9 @@ class Visualizer {
 
     fprintf(file, "digraph G {\n");
     fprintf(file, "  node [style=filled];\n");
-    showRec(tree_.getRoot(), file, -1);
+    if (!flat_.empty()) {
+      showRec(flat_.getRoot(), file, -1);
+    }
     fprintf(file, "}");
     tree_file.release();
 
@@ -723,7 +599,7 @@ class Visualizer {
   void translate(const std::string& code_filename) {
     SmartFile smart_code_file(code_filename.c_str(), "w");
     FILE* code_file = smart_code_file.getFile();
-    translateRec(tree_.getRoot(), code_file, -1, 0);
+    translateRec(flat_.getRoot(), code_file, -1, 0);
   }
 };
 